@@ -126,6 +126,16 @@ typedef struct {
     ODE_BIND_ARRAY_GETTER(getEntry, entries, n);
 } ODE_StringList;
 
+/// A reference to an immutable array of scalars (does not hold or change ownership)
+typedef struct {
+    /// Pointer to the first scalar
+    const ODE_Scalar *entries;
+    /// Number of entries
+    int n;
+    /// Get single entry
+    ODE_BIND_ARRAY_GETTER(getEntry, entries, n);
+} ODE_ScalarList;
+
 /// Destroys the ODE_String object, freeing its allocated memory
 ODE_Result ODE_API ode_destroyString(ODE_String string);
 
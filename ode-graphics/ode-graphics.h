@@ -4,9 +4,12 @@
 #include "ode/graphics/Mesh.h"
 #include "ode/graphics/Shader.h"
 #include "ode/graphics/ShaderProgram.h"
+#include "ode/graphics/ProgramBinaryCache.h"
 #include "ode/graphics/Texture1D.h"
 #include "ode/graphics/Texture2D.h"
+#include "ode/graphics/TextureReadback.h"
 #include "ode/graphics/Uniform.h"
+#include "ode/graphics/GLStateCache.h"
 #include "ode/graphics/FrameBuffer.h"
 #include "ode/graphics/RenderBuffer.h"
 #include "ode/graphics/GraphicsContext.h"
@@ -2,6 +2,7 @@
 #include "FrameBuffer.h"
 
 #include <ode/utils.h>
+#include "GLStateCache.h"
 
 #ifdef ODE_GRAPHICS_PEDANTIC
     #define PEDANTIC_ONLY(...) __VA_ARGS__
@@ -28,6 +29,8 @@ void FrameBuffer::blit(FrameBuffer *dst, const FrameBuffer *src, const Rectangle
         glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dst->handle);
         glBlitFramebuffer(srcArea.a.x, srcArea.a.y, srcArea.b.x, srcArea.b.y, dstArea.a.x, dstArea.a.y, dstArea.b.x, dstArea.b.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
         PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        // Separate read and draw framebuffer bindings are not shadowed
+        GLStateCache::invalidate();
         //LOG_ACTION(FBO_BLIT, source, srcArea.w*srcArea.h, "FBO -> FBO");
     }
 }
@@ -36,20 +39,20 @@ void FrameBuffer::blit(FrameBuffer *dst, const FrameBuffer *src, const Rectangle
 void FrameBuffer::blit(Texture2D *dst, const FrameBuffer *src, const Rectangle<int> &dstArea, const Rectangle<int> &srcArea) {
     ODE_ASSERT(dstArea.dimensions() == srcArea.dimensions());
     if (dstArea.a.x < dstArea.b.x && dstArea.a.y < dstArea.b.y) {
-        glBindFramebuffer(GL_FRAMEBUFFER, src->handle);
-        glBindTexture(GL_TEXTURE_2D, dst->handle);
+        GLStateCache::bindFramebuffer(src->handle);
+        GLStateCache::bindTexture(dst->handle);
         if (dstArea.a == Vector2i() && dstArea.b == dst->dimensions())
             glCopyTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, srcArea.a.x, srcArea.a.y, dstArea.b.x, dstArea.b.y, 0);
         else
             glCopyTexSubImage2D(GL_TEXTURE_2D, 0, dstArea.a.x, dstArea.a.y, srcArea.a.x, srcArea.a.y, dstArea.b.x-dstArea.a.x, dstArea.b.y-dstArea.a.y);
-        PEDANTIC_ONLY(glBindTexture(GL_TEXTURE_2D, 0));
-        PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        PEDANTIC_ONLY(GLStateCache::bindTexture(0));
+        PEDANTIC_ONLY(GLStateCache::bindFramebuffer(0));
         //LOG_ACTION(FBO_BLIT, source, srcArea.w*srcArea.h, "FBO -> texture");
     }
 }
 
 void FrameBuffer::bindScreen() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache::bindFramebuffer(0);
 }
 
 FrameBuffer::FrameBuffer() : handle(0) {
@@ -63,6 +66,7 @@ FrameBuffer::FrameBuffer(FrameBuffer &&orig) : handle(orig.handle) {
 
 FrameBuffer::~FrameBuffer() {
     if (handle) {
+        GLStateCache::framebufferDeleted(handle);
         glDeleteFramebuffers(1, &handle);
         //LOG_OWN_ACTION(FBO_DELETION, 1, "");
     }
@@ -71,6 +75,7 @@ FrameBuffer::~FrameBuffer() {
 FrameBuffer &FrameBuffer::operator=(FrameBuffer &&orig) {
     if (this != &orig) {
         if (handle) {
+            GLStateCache::framebufferDeleted(handle);
             glDeleteFramebuffers(1, &handle);
             //LOG_OWN_ACTION(FBO_DELETION, 1, "");
         }
@@ -85,35 +90,35 @@ FrameBuffer::operator bool() const {
 }
 
 void FrameBuffer::setOutput(Texture2D *texture) {
-    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    GLStateCache::bindFramebuffer(handle);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->handle, 0);
-    PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    PEDANTIC_ONLY(GLStateCache::bindFramebuffer(0));
 }
 
 void FrameBuffer::setOutput(RenderBuffer *renderBuffer) {
-    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    GLStateCache::bindFramebuffer(handle);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderBuffer->handle);
-    PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    PEDANTIC_ONLY(GLStateCache::bindFramebuffer(0));
 }
 
 void FrameBuffer::unsetOutput(Texture2D *texture) {
-    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    GLStateCache::bindFramebuffer(handle);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
-    PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    PEDANTIC_ONLY(GLStateCache::bindFramebuffer(0));
 }
 
 void FrameBuffer::unsetOutput(RenderBuffer *renderBuffer) {
-    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    GLStateCache::bindFramebuffer(handle);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, 0);
-    PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    PEDANTIC_ONLY(GLStateCache::bindFramebuffer(0));
 }
 
 void FrameBuffer::bind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    GLStateCache::bindFramebuffer(handle);
 }
 
 void FrameBuffer::unbind() {
-    PEDANTIC_ONLY(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+    PEDANTIC_ONLY(GLStateCache::bindFramebuffer(0));
 }
 
 }
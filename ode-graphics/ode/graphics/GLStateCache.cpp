@@ -0,0 +1,146 @@
+
+#include "GLStateCache.h"
+
+namespace ode {
+
+// Texture bindings of units beyond this count are not shadowed
+static constexpr int SHADOWED_TEXTURE_UNITS = 16;
+// Never generated by OpenGL, denotes that the binding is unknown
+static constexpr GLuint UNKNOWN_HANDLE = ~GLuint(0);
+
+namespace {
+
+struct ShadowedState {
+    GLuint framebuffer;
+    GLuint program;
+    int activeTextureUnit;
+    GLuint textures[SHADOWED_TEXTURE_UNITS];
+    bool viewportKnown;
+    int viewport[4];
+    bool clearColorKnown;
+    float clearColor[4];
+
+    ShadowedState() : framebuffer(UNKNOWN_HANDLE), program(UNKNOWN_HANDLE), activeTextureUnit(-1), viewportKnown(false), viewport(), clearColorKnown(false), clearColor() {
+        for (GLuint &texture : textures)
+            texture = UNKNOWN_HANDLE;
+    }
+};
+
+}
+
+static ShadowedState state;
+static GLStateCache::Statistics stats = { };
+
+void GLStateCache::invalidate() {
+    state = ShadowedState();
+}
+
+void GLStateCache::bindFramebuffer(GLuint handle) {
+    if (state.framebuffer == handle) {
+        ++stats.skippedCalls;
+        return;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    state.framebuffer = handle;
+    ++stats.issuedCalls;
+}
+
+void GLStateCache::useProgram(GLuint handle) {
+    if (state.program == handle) {
+        ++stats.skippedCalls;
+        return;
+    }
+    glUseProgram(handle);
+    state.program = handle;
+    ++stats.issuedCalls;
+}
+
+void GLStateCache::activeTexture(int unit) {
+    if (state.activeTextureUnit == unit) {
+        ++stats.skippedCalls;
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0+unit);
+    state.activeTextureUnit = unit;
+    ++stats.issuedCalls;
+}
+
+void GLStateCache::bindTexture(int unit, GLuint handle) {
+    activeTexture(unit);
+    bindTexture(handle);
+}
+
+void GLStateCache::bindTexture(GLuint handle) {
+    int unit = state.activeTextureUnit;
+    if (unit >= 0 && unit < SHADOWED_TEXTURE_UNITS && state.textures[unit] == handle) {
+        ++stats.skippedCalls;
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, handle);
+    ++stats.issuedCalls;
+    if (unit >= 0 && unit < SHADOWED_TEXTURE_UNITS)
+        state.textures[unit] = handle;
+    else if (unit < 0) {
+        // The modified unit is unknown
+        for (GLuint &texture : state.textures)
+            texture = UNKNOWN_HANDLE;
+    }
+}
+
+void GLStateCache::viewport(int x, int y, int width, int height) {
+    if (state.viewportKnown && state.viewport[0] == x && state.viewport[1] == y && state.viewport[2] == width && state.viewport[3] == height) {
+        ++stats.skippedCalls;
+        return;
+    }
+    glViewport(x, y, width, height);
+    state.viewportKnown = true;
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+    ++stats.issuedCalls;
+}
+
+void GLStateCache::clearColor(float r, float g, float b, float a) {
+    if (state.clearColorKnown && state.clearColor[0] == r && state.clearColor[1] == g && state.clearColor[2] == b && state.clearColor[3] == a) {
+        ++stats.skippedCalls;
+        return;
+    }
+    glClearColor(r, g, b, a);
+    state.clearColorKnown = true;
+    state.clearColor[0] = r;
+    state.clearColor[1] = g;
+    state.clearColor[2] = b;
+    state.clearColor[3] = a;
+    ++stats.issuedCalls;
+}
+
+void GLStateCache::framebufferDeleted(GLuint handle) {
+    // Deleting the bound framebuffer reverts the binding to zero
+    if (state.framebuffer == handle)
+        state.framebuffer = 0;
+}
+
+void GLStateCache::programDeleted(GLuint handle) {
+    // In case it is still in use
+    if (state.program == handle || state.program == UNKNOWN_HANDLE)
+        useProgram(0);
+}
+
+void GLStateCache::textureDeleted(GLuint handle) {
+    // Deleting a bound texture reverts the bindings to zero
+    for (GLuint &texture : state.textures) {
+        if (texture == handle)
+            texture = 0;
+    }
+}
+
+const GLStateCache::Statistics &GLStateCache::statistics() {
+    return stats;
+}
+
+void GLStateCache::resetStatistics() {
+    stats = Statistics();
+}
+
+}
@@ -0,0 +1,45 @@
+
+#pragma once
+
+#include "gl.h"
+
+namespace ode {
+
+/// Shadows the OpenGL state most frequently changed by ODE (framebuffer, shader program, texture bindings, viewport and clear color)
+/// and skips calls which would not change it. The shadowed state belongs to the current context,
+/// so it must be invalidated when the current context changes or when code outside ode-graphics modifies the state directly
+class GLStateCache {
+
+public:
+    /// Numbers of state changing calls since the last resetStatistics call
+    struct Statistics {
+        /// Calls passed on to OpenGL
+        int issuedCalls;
+        /// Redundant calls which were skipped
+        int skippedCalls;
+    };
+
+    /// Forgets the shadowed state - the next call of each kind is always issued
+    static void invalidate();
+
+    static void bindFramebuffer(GLuint handle);
+    static void useProgram(GLuint handle);
+    static void activeTexture(int unit);
+    /// Binds a 2D texture to a texture unit (and makes it the active unit)
+    static void bindTexture(int unit, GLuint handle);
+    /// Binds a 2D texture to the active texture unit, for modification
+    static void bindTexture(GLuint handle);
+    static void viewport(int x, int y, int width, int height);
+    static void clearColor(float r, float g, float b, float a);
+
+    /// Must be called when an object is deleted, as OpenGL removes its bindings and may reuse its name
+    static void framebufferDeleted(GLuint handle);
+    static void programDeleted(GLuint handle);
+    static void textureDeleted(GLuint handle);
+
+    static const Statistics &statistics();
+    static void resetStatistics();
+
+};
+
+}
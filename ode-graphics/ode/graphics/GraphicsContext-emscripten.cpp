@@ -6,6 +6,7 @@
 #include <emscripten/html5.h>
 #include "gl.h"
 #include "gl-state-check.h"
+#include "GLStateCache.h"
 
 namespace ode {
 
@@ -58,6 +59,8 @@ void GraphicsContext::initialize(const char *target, const Vector2i &dimensions,
     if (data->handle <= 0)
         return;
     emscripten_webgl_make_context_current(data->handle);
+    // State shadowed for the previous context is not valid in the new one
+    GLStateCache::invalidate();
 
     glDisable(GL_DEPTH_TEST);
     glDepthMask(GL_FALSE);
@@ -105,7 +108,7 @@ Vector2i GraphicsContext::dimensions() const {
 void GraphicsContext::swapOutputFramebuffer() { }
 
 void GraphicsContext::bindOutputFramebuffer() {
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    GLStateCache::bindFramebuffer(0);
 }
 
 void GraphicsContext::spoofOutputFramebuffer(FrameBuffer *) { }
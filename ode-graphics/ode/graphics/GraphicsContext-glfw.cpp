@@ -6,6 +6,7 @@
 #include <cstdio>
 #include "gl.h"
 #include "gl-state-check.h"
+#include "GLStateCache.h"
 #include <GLFW/glfw3.h>
 #include <ode/utils.h>
 #include "FrameBuffer.h"
@@ -162,6 +163,8 @@ void GraphicsContext::initialize(const char *title, const Vector2i &dimensions,
     if (!(data->window = glfwCreateWindow(dimensions.x, dimensions.y, title, nullptr, nullptr)))
         return;
     glfwMakeContextCurrent(data->window);
+    // State shadowed for the previous context is not valid in the new one
+    GLStateCache::invalidate();
 
     if (glewInit() != GLEW_OK)
         return;
@@ -232,7 +235,7 @@ void GraphicsContext::swapOutputFramebuffer() {
 }
 
 void GraphicsContext::bindOutputFramebuffer() {
-    glBindFramebuffer(GL_FRAMEBUFFER, data->screenFBO);
+    GLStateCache::bindFramebuffer(data->screenFBO);
 }
 
 void GraphicsContext::spoofOutputFramebuffer(FrameBuffer *fb) {
@@ -0,0 +1,136 @@
+
+#include "ProgramBinaryCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <ode/filesystem/file-io.h>
+
+namespace ode {
+
+typedef unsigned long long ProgramHash;
+
+// 64-bit FNV-1a hash
+static void hashAppend(ProgramHash &hash, const char *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= ProgramHash((unsigned char) data[i]);
+        hash *= 0x100000001b3ull;
+    }
+}
+
+static void hashAppend(ProgramHash &hash, const std::string &str) {
+    // The terminating null character separates consecutive strings
+    hashAppend(hash, str.c_str(), str.size()+1);
+}
+
+bool ProgramBinaryCache::isSupported() {
+#ifdef __EMSCRIPTEN__
+    return false;
+#else
+    if (!(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+        return false;
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    ODE_CHECK_GL_ERROR();
+    return formatCount > 0;
+#endif
+}
+
+ProgramBinaryCache::ProgramBinaryCache(const FilePath &directory) : directory(directory), supported(-1) { }
+
+bool ProgramBinaryCache::available() {
+    if (supported < 0) {
+        supported = isSupported();
+        if (supported) {
+            for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+                if (const GLubyte *str = glGetString(name))
+                    driverId += reinterpret_cast<const char *>(str);
+                driverId.push_back('\n');
+            }
+        }
+    }
+    return supported > 0;
+}
+
+std::string ProgramBinaryCache::programKey(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const char *const *attribOrder) {
+    if (!available())
+        return std::string();
+    ProgramHash hash = 0xcbf29ce484222325ull;
+    hashAppend(hash, driverId);
+    hashAppend(hash, vertexShaderSource);
+    hashAppend(hash, fragmentShaderSource);
+    if (attribOrder) {
+        for (; *attribOrder; ++attribOrder)
+            hashAppend(hash, *attribOrder, strlen(*attribOrder)+1);
+    }
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", hash);
+    return key;
+}
+
+FilePath ProgramBinaryCache::binaryPath(const std::string &key) const {
+    return directory+("/"+key+".bin");
+}
+
+bool ProgramBinaryCache::load(GLuint program, const std::string &key) {
+#ifndef __EMSCRIPTEN__
+    if (!(available() && !key.empty()))
+        return false;
+    std::vector<byte> data;
+    if (!(readFile(binaryPath(key), data) && data.size() > sizeof(GLenum)))
+        return false;
+    GLenum format;
+    memcpy(&format, data.data(), sizeof(GLenum));
+    glProgramBinary(program, format, data.data()+sizeof(GLenum), GLsizei(data.size()-sizeof(GLenum)));
+    // Fails if the driver rejects the binary, for example after an update
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    ODE_CHECK_GL_ERROR();
+    return status == GL_TRUE;
+#else
+    return false;
+#endif
+}
+
+void ProgramBinaryCache::prepareLink(GLuint program) {
+#ifndef __EMSCRIPTEN__
+    if (available()) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        ODE_CHECK_GL_ERROR();
+    }
+#endif
+}
+
+bool ProgramBinaryCache::store(GLuint program, const std::string &key) {
+#ifndef __EMSCRIPTEN__
+    if (!(available() && !key.empty()))
+        return false;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return false;
+    std::vector<byte> data(sizeof(GLenum)+length);
+    GLenum format = 0;
+    GLsizei actualLength = 0;
+    glGetProgramBinary(program, length, &actualLength, &format, data.data()+sizeof(GLenum));
+    ODE_CHECK_GL_ERROR();
+    if (actualLength <= 0)
+        return false;
+    memcpy(data.data(), &format, sizeof(GLenum));
+    data.resize(sizeof(GLenum)+actualLength);
+    // Written under a temporary name first, so that other processes never load an incomplete binary
+    FilePath path = binaryPath(key);
+    FilePath tempPath = path+".tmp";
+    if (!writeFile(tempPath, data))
+        return false;
+    if (rename(((const std::string &) tempPath).c_str(), ((const std::string &) path).c_str())) {
+        remove(((const std::string &) tempPath).c_str());
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,40 @@
+
+#pragma once
+
+#include <string>
+#include <ode/filesystem/FilePath.h>
+#include "gl.h"
+
+namespace ode {
+
+/// Persists binaries of linked shader programs in a directory, so that they do not have to be recompiled in subsequent runs.
+/// Binaries are identified by the OpenGL driver and the source code of the program
+class ProgramBinaryCache {
+
+public:
+    /// Returns true if the OpenGL implementation of the current context can retrieve and load program binaries
+    static bool isSupported();
+
+    /// The directory must already exist
+    explicit ProgramBinaryCache(const FilePath &directory);
+    /// Returns the key which identifies the binary of a program with the given sources in the current driver
+    std::string programKey(const std::string &vertexShaderSource, const std::string &fragmentShaderSource, const char *const *attribOrder);
+    /// Loads the binary identified by key into program - returns false if it is not cached or no longer valid
+    bool load(GLuint program, const std::string &key);
+    /// Must be called before linking a program which is to be stored
+    void prepareLink(GLuint program);
+    /// Stores the binary of a successfully linked program under key
+    bool store(GLuint program, const std::string &key);
+
+private:
+    FilePath directory;
+    /// Identifies the driver - empty until first needed, as it requires a current context
+    std::string driverId;
+    int supported;
+
+    bool available();
+    FilePath binaryPath(const std::string &key) const;
+
+};
+
+}
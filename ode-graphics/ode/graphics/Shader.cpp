@@ -1,9 +1,11 @@
 
 #include "Shader.h"
 
+#include "ShaderProgram.h"
+
 namespace ode {
 
-Shader::Shader(const char *label) : handle(0), ready(false), label(label) { }
+Shader::Shader(const char *label) : handle(0), ready(false), compiled(false), label(label) { }
 
 Shader::~Shader() {
     if (handle) {
@@ -15,6 +17,21 @@ Shader::~Shader() {
 bool Shader::initialize(const GLchar *const *sources, const GLint *lengths, size_t count) {
     if (ready)
         return false;
+    source.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (lengths && lengths[i] >= 0)
+            source.append(sources[i], lengths[i]);
+        else
+            source.append(sources[i]);
+    }
+    if (ShaderProgram::getBinaryCache())
+        return ready = true;
+    return ready = compile();
+}
+
+bool Shader::compile() const {
+    if (compiled)
+        return true;
     if (!handle)
         handle = glCreateShader(shaderType());
     if (!handle)
@@ -27,7 +44,9 @@ bool Shader::initialize(const GLchar *const *sources, const GLint *lengths, size
     }
 #endif
 
-    glShaderSource(handle, (GLsizei) count, const_cast<const GLchar **>(sources), lengths);
+    const GLchar *sourceString = source.c_str();
+    GLint sourceLength = (GLint) source.size();
+    glShaderSource(handle, 1, &sourceString, &sourceLength);
     glCompileShader(handle);
     ODE_CHECK_GL_ERROR();
 
@@ -51,14 +70,9 @@ bool Shader::initialize(const GLchar *const *sources, const GLint *lengths, size
         #endif
         return false;
     }
-#ifdef ODE_DEBUG
-    int totalSrcLen = 0;
-    for (size_t i = 0; i < count; ++i)
-        totalSrcLen += lengths[i];
-    //LOG_OWN_ACTION(SHADER_COMPILATION, totalSrcLen, "");
-#endif
+    //LOG_OWN_ACTION(SHADER_COMPILATION, int(source.size()), "");
     ODE_CHECK_GL_ERROR();
-    return ready = true;
+    return compiled = true;
 }
 
 Shader::operator bool() const {
@@ -69,6 +83,10 @@ const char *Shader::getLog() const {
     return log.c_str();
 }
 
+const std::string &Shader::getSource() const {
+    return source;
+}
+
 VertexShader::VertexShader(const char *label) : Shader(label) { }
 
 FragmentShader::FragmentShader(const char *label) : Shader(label) { }
@@ -33,18 +33,26 @@ public:
     Shader(const Shader &) = delete;
     virtual ~Shader();
     Shader &operator=(const Shader &) = delete;
+    /// If a program binary cache is active, compilation is deferred until a program which uses the shader is not found in the cache
     bool initialize(const GLchar *const *sources, const GLint *lengths, size_t count);
     explicit operator bool() const;
     const char *getLog() const;
+    /// Returns the complete source code of the shader
+    const std::string &getSource() const;
 
 protected:
     virtual GLenum shaderType() const = 0;
 
 private:
-    GLuint handle;
+    // Compilation may be deferred until the shader is used by a program
+    mutable GLuint handle;
     bool ready;
+    mutable bool compiled;
     const char *label;
-    std::string log;
+    std::string source;
+    mutable std::string log;
+
+    bool compile() const;
 
 };
 
@@ -1,13 +1,26 @@
 
 #include "ShaderProgram.h"
 
+#include "ProgramBinaryCache.h"
+#include "GLStateCache.h"
+
 namespace ode {
 
+ProgramBinaryCache *ShaderProgram::binaryCache = nullptr;
+
+void ShaderProgram::setBinaryCache(ProgramBinaryCache *cache) {
+    binaryCache = cache;
+}
+
+ProgramBinaryCache *ShaderProgram::getBinaryCache() {
+    return binaryCache;
+}
+
 ShaderProgram::ShaderProgram() : handle(0), ready(false) { }
 
 ShaderProgram::~ShaderProgram() {
     if (handle) {
-        glUseProgram(0); // in case it is still bound
+        GLStateCache::programDeleted(handle);
         glDeleteProgram(handle);
         ODE_CHECK_GL_ERROR();
     }
@@ -21,12 +34,23 @@ bool ShaderProgram::initialize(const VertexShader *vertexShader, const FragmentS
         handle = glCreateProgram();
     if (!handle)
         return false;
+    std::string binaryKey;
+    if (binaryCache) {
+        binaryKey = binaryCache->programKey(vertexShader->getSource(), fragmentShader->getSource(), attribOrder);
+        if (binaryCache->load(handle, binaryKey))
+            return ready = true;
+    }
+    // Compilation of shaders may have been deferred in anticipation of a cached binary
+    if (!(vertexShader->compile() && fragmentShader->compile()))
+        return false;
     glAttachShader(handle, vertexShader->handle);
     glAttachShader(handle, fragmentShader->handle);
     if (attribOrder) {
         for (GLuint i = 0; *attribOrder; ++i, ++attribOrder)
             glBindAttribLocation(handle, i, *attribOrder);
     }
+    if (binaryCache)
+        binaryCache->prepareLink(handle);
     glLinkProgram(handle);
     ODE_CHECK_GL_ERROR();
     GLint status = GL_FALSE;
@@ -49,6 +73,8 @@ bool ShaderProgram::initialize(const VertexShader *vertexShader, const FragmentS
     glDetachShader(handle, fragmentShader->handle);
     //LOG_OWN_ACTION(SHADER_LINKAGE, 1, "");
     ODE_CHECK_GL_ERROR();
+    if (ready && binaryCache)
+        binaryCache->store(handle, binaryKey);
     return ready;
 }
 
@@ -68,7 +94,7 @@ const char *ShaderProgram::getLog() const {
 }
 
 void ShaderProgram::bind() const {
-    glUseProgram(handle);
+    GLStateCache::useProgram(handle);
     ODE_CHECK_GL_ERROR();
 }
 
@@ -8,10 +8,16 @@
 
 namespace ode {
 
+class ProgramBinaryCache;
+
 /// Represents an OpenGL shader program
 class ShaderProgram {
 
 public:
+    /// Sets the cache from which subsequently initialized programs are loaded and to which they are stored (null to disable)
+    static void setBinaryCache(ProgramBinaryCache *cache);
+    static ProgramBinaryCache *getBinaryCache();
+
     ShaderProgram();
     ShaderProgram(const ShaderProgram &) = delete;
     ~ShaderProgram();
@@ -28,6 +34,8 @@ public:
     void bind() const;
 
 private:
+    static ProgramBinaryCache *binaryCache;
+
     GLuint handle;
     bool ready;
     std::string log;
@@ -2,6 +2,7 @@
 #include "Texture1D.h"
 
 #include "GraphicsContext.h"
+#include "GLStateCache.h"
 
 namespace ode {
 
@@ -55,7 +56,7 @@ bool Texture1D::initialize(const void *pixels, int width, PixelFormat format) {
 }
 
 void Texture1D::bind(int slot) const {
-    glActiveTexture(GL_TEXTURE0+slot);
+    GLStateCache::activeTexture(slot);
     glBindTexture(GL_TEXTURE_1D, handle);
     ODE_CHECK_GL_ERROR();
 }
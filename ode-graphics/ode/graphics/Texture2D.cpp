@@ -3,6 +3,7 @@
 
 #include "GraphicsContext.h"
 #include "FrameBuffer.h"
+#include "GLStateCache.h"
 
 #ifndef GL_ALPHA32F
 #define GL_ALPHA32F GL_ALPHA32F_ARB
@@ -117,12 +118,12 @@ GLint convertFilterMode(FilterMode mode) {
 Texture2D::Texture2D(FilterMode filter, bool wrap) : handle(0), fmt(), hasMipmaps(false), memorySize(0) {
     glGenTextures(1, &handle);
     ++DEBUG_TEXTURES_CREATED;
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(handle);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter == FilterMode::NEAREST ? GL_NEAREST : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter == FilterMode::NEAREST ? GL_NEAREST : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::bindTexture(0);
     ODE_CHECK_GL_ERROR();
     //LOG_OWN_ACTION(TEXTURE_CREATION, 2, "");
 }
@@ -139,6 +140,7 @@ Texture2D::Texture2D(Texture2D &&orig) : handle(orig.handle), dims(orig.dims), f
 
 Texture2D::~Texture2D() {
     if (handle) {
+        GLStateCache::textureDeleted(handle);
         glDeleteTextures(1, &handle);
         ODE_CHECK_GL_ERROR();
         //MemoryWatch::instance().registerChange(-(long long) memorySize_, true);
@@ -149,6 +151,7 @@ Texture2D::~Texture2D() {
 Texture2D &Texture2D::operator=(Texture2D &&orig) {
     if (this != &orig) {
         if (handle) {
+            GLStateCache::textureDeleted(handle);
             glDeleteTextures(1, &handle);
             ODE_CHECK_GL_ERROR();
             //MemoryWatch::instance().registerChange(-(long long) memorySize_, true);
@@ -174,7 +177,7 @@ bool Texture2D::initialize(PixelFormat format, const void *pixels, const Vector2
     GLenum pixelFormat = GL_INVALID_INDEX;
     GLenum pixelType = GL_INVALID_INDEX;
     convertPixelFormat(format, internalFormat, pixelFormat, pixelType);
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(handle);
     glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, dimensions.x, dimensions.y, 0, pixelFormat, pixelType, pixels);
     ODE_CHECK_GL_ERROR();
     size_t newMemSize = pixelSize(format)*dimensions.x*dimensions.y;
@@ -203,7 +206,7 @@ bool Texture2D::put(const Vector2i &position, const BitmapConstRef &bitmap) {
     GLenum pixelFormat = GL_INVALID_INDEX;
     GLenum pixelType = GL_INVALID_INDEX;
     convertPixelFormat(bitmap.format, internalFormat, pixelFormat, pixelType);
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(handle);
     glTexSubImage2D(GL_TEXTURE_2D, 0, position.x, position.y, bitmap.dimensions.x, bitmap.dimensions.y, pixelFormat, pixelType, bitmap.pixels);
     ODE_CHECK_GL_ERROR();
     return true;
@@ -214,14 +217,12 @@ Texture2D::operator bool() const {
 }
 
 void Texture2D::bind(int unit) const {
-    glActiveTexture(GL_TEXTURE0+unit);
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(unit, handle);
     ODE_CHECK_GL_ERROR();
 }
 
 void Texture2D::unbind(int unit) const {
-    glActiveTexture(GL_TEXTURE0+unit);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLStateCache::bindTexture(unit, 0);
     ODE_CHECK_GL_ERROR();
 }
 
@@ -245,13 +246,13 @@ Bitmap Texture2D::download() const {
         return Bitmap();
     glFinish();
     #ifndef ODE_WEBGL_COMPATIBILITY
-        glBindTexture(GL_TEXTURE_2D, handle);
+        GLStateCache::bindTexture(handle);
         glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void *) bitmap);
     #else
         FrameBuffer fb;
         fb.setOutput(const_cast<Texture2D *>(this));
         fb.bind(); // !!! what if something is already bound and needs to be restored???
-        glViewport(0, 0, dims.x, dims.y);
+        GLStateCache::viewport(0, 0, dims.x, dims.y);
         glReadPixels(0, 0, dims.x, dims.y, GL_RGBA, GL_UNSIGNED_BYTE, (void *) bitmap);
         fb.unbind();
         fb.unsetOutput(const_cast<Texture2D*>(this));
@@ -261,6 +262,36 @@ Bitmap Texture2D::download() const {
     return bitmap;
 }
 
+bool Texture2D::download(const SparseBitmapRef &bitmap) const {
+    ODE_ASSERT(handle);
+    const ptrdiff_t rowSize = ptrdiff_t(pixelSize(fmt)*dims.x);
+    if (!(bitmap.pixels && bitmap.dimensions == dims && (fmt == PixelFormat::RGBA || fmt == PixelFormat::PREMULTIPLIED_RGBA) && pixelSize(bitmap.format) == pixelSize(fmt) && bitmap.stride >= rowSize && bitmap.stride%pixelSize(fmt) == 0))
+        return false;
+    #ifndef ODE_GL_ENABLE_PACK_ROW_LENGTH
+        if (bitmap.stride != rowSize) {
+            Bitmap pixels = download();
+            if (!pixels)
+                return false;
+            copyPixels(bitmap, SparseBitmapConstRef(bitmap.format, pixels.pixels(), dims, rowSize));
+            return true;
+        }
+    #endif
+    FrameBuffer fb;
+    fb.setOutput(const_cast<Texture2D *>(this));
+    fb.bind();
+    #ifdef ODE_GL_ENABLE_PACK_ROW_LENGTH
+        glPixelStorei(GL_PACK_ROW_LENGTH, GLint(bitmap.stride/pixelSize(fmt)));
+    #endif
+    glReadPixels(0, 0, dims.x, dims.y, GL_RGBA, GL_UNSIGNED_BYTE, bitmap.pixels);
+    #ifdef ODE_GL_ENABLE_PACK_ROW_LENGTH
+        glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    #endif
+    fb.unbind();
+    fb.unsetOutput(const_cast<Texture2D *>(this));
+    ODE_CHECK_GL_ERROR();
+    return true;
+}
+
 void Texture2D::generateMipmaps(FilterMode filter, bool wrap) {
     if (hasMipmaps)
         return;
@@ -270,7 +301,7 @@ void Texture2D::generateMipmaps(FilterMode filter, bool wrap) {
         return;
     }
 #endif
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(handle);
     glGenerateMipmap(GL_TEXTURE_2D);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, convertFilterMode(filter));
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap ? GL_REPEAT : GL_CLAMP_TO_EDGE);
@@ -288,7 +319,7 @@ void Texture2D::generateMipmaps(FilterMode filter, bool wrap) {
 void Texture2D::setFilterMode(FilterMode filter) {
     if (!hasMipmaps && filter >= FilterMode::BILINEAR)
         return; // log this as warning?
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(handle);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter == FilterMode::NEAREST ? GL_NEAREST : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, convertFilterMode(filter));
     ODE_CHECK_GL_ERROR();
@@ -296,7 +327,7 @@ void Texture2D::setFilterMode(FilterMode filter) {
 
 #ifdef __EMSCRIPTEN__
 void Texture2D::prepareExternalUpload() {
-    glBindTexture(GL_TEXTURE_2D, handle);
+    GLStateCache::bindTexture(handle);
     ODE_CHECK_GL_ERROR();
 }
 
@@ -6,6 +6,7 @@
 #include <ode/graphics/FilterMode.h>
 #include <ode/graphics/Bitmap.h>
 #include <ode/graphics/BitmapConstRef.h>
+#include <ode/graphics/SparseBitmapRef.h>
 #include "gl.h"
 
 namespace ode {
@@ -43,6 +44,9 @@ public:
     PixelFormat format() const;
     /// Transfers the zero-th mipmap level of the texture to a bitmap in physical memory
     Bitmap download() const;
+    /// Transfers the zero-th mipmap level of the texture directly into existing memory - bitmap's dimensions must match
+    /// and its format must have the same layout as the texture's (RGBA or PREMULTIPLIED_RGBA)
+    bool download(const SparseBitmapRef &bitmap) const;
     /// Automatically generates all mipmap levels for the texture
     void generateMipmaps(FilterMode filter = FilterMode::BILINEAR, bool wrap = false);
     /// Changes the texture's filtering mode
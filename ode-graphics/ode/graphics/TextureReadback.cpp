@@ -0,0 +1,155 @@
+
+#include "TextureReadback.h"
+
+#include <cstring>
+#include "GLStateCache.h"
+
+namespace ode {
+
+TextureReadback::TextureReadback() : buffer(0), capacity(0), fence(nullptr), fmt(PixelFormat::EMPTY) { }
+
+TextureReadback::TextureReadback(TextureReadback &&orig) : framebuffer((FrameBuffer &&) orig.framebuffer), buffer(orig.buffer), capacity(orig.capacity), fence(orig.fence), fmt(orig.fmt), dims(orig.dims), result((Bitmap &&) orig.result) {
+    orig.buffer = 0;
+    orig.capacity = 0;
+    orig.fence = nullptr;
+    orig.fmt = PixelFormat::EMPTY;
+}
+
+TextureReadback::~TextureReadback() {
+    releaseFence();
+    #ifdef ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+        if (buffer)
+            glDeleteBuffers(1, &buffer);
+    #endif
+}
+
+TextureReadback &TextureReadback::operator=(TextureReadback &&orig) {
+    if (this != &orig) {
+        releaseFence();
+        #ifdef ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+            if (buffer)
+                glDeleteBuffers(1, &buffer);
+        #endif
+        framebuffer = (FrameBuffer &&) orig.framebuffer;
+        buffer = orig.buffer;
+        capacity = orig.capacity;
+        fence = orig.fence;
+        fmt = orig.fmt;
+        dims = orig.dims;
+        result = (Bitmap &&) orig.result;
+        orig.buffer = 0;
+        orig.capacity = 0;
+        orig.fence = nullptr;
+        orig.fmt = PixelFormat::EMPTY;
+    }
+    return *this;
+}
+
+void TextureReadback::releaseFence() {
+    #ifdef ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    #endif
+}
+
+bool TextureReadback::start(const Texture2D &texture) {
+    return start(texture, texture.format());
+}
+
+bool TextureReadback::start(const Texture2D &texture, PixelFormat format) {
+    releaseFence();
+    result.clear();
+    fmt = PixelFormat::EMPTY;
+    if (!(texture && (texture.format() == PixelFormat::RGBA || texture.format() == PixelFormat::PREMULTIPLIED_RGBA) && pixelSize(format) == pixelSize(texture.format())))
+        return false;
+    dims = texture.dimensions();
+    #ifdef ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+        size_t size = pixelSize(format)*dims.x*dims.y;
+        if (!buffer)
+            glGenBuffers(1, &buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        if (size > capacity) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+            capacity = size;
+        }
+        framebuffer.setOutput(const_cast<Texture2D *>(&texture));
+        framebuffer.bind();
+        // With a pixel pack buffer bound, the pixels are written into the buffer and the call returns without waiting for the GPU
+        glReadPixels(0, 0, dims.x, dims.y, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        framebuffer.unsetOutput(const_cast<Texture2D *>(&texture));
+        framebuffer.unbind();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        // Makes sure that the fence is eventually signaled even if nothing else flushes the command queue
+        glFlush();
+        ODE_CHECK_GL_ERROR();
+        if (!fence)
+            return false;
+    #else
+        result = texture.download();
+        if (!result)
+            return false;
+        result.reinterpret(format);
+    #endif
+    fmt = format;
+    return true;
+}
+
+bool TextureReadback::pending() const {
+    return fmt != PixelFormat::EMPTY;
+}
+
+bool TextureReadback::ready() const {
+    #ifdef ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+        if (fence) {
+            GLint status = GL_UNSIGNALED;
+            glGetSynciv(fence, GL_SYNC_STATUS, 1, nullptr, &status);
+            ODE_CHECK_GL_ERROR();
+            return status == GL_SIGNALED;
+        }
+    #endif
+    return pending();
+}
+
+Bitmap TextureReadback::finish() {
+    if (!pending())
+        return Bitmap();
+    PixelFormat format = fmt;
+    fmt = PixelFormat::EMPTY;
+    #ifdef ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+        if (!fence)
+            return Bitmap();
+        #ifndef __EMSCRIPTEN__
+            // WebGL does not allow waiting on the client side - glGetBufferSubData blocks instead
+            GLenum waitResult;
+            while ((waitResult = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000)) == GL_TIMEOUT_EXPIRED);
+            if (waitResult == GL_WAIT_FAILED) {
+                releaseFence();
+                return Bitmap();
+            }
+        #endif
+        releaseFence();
+        Bitmap bitmap(format, dims);
+        if (!bitmap)
+            return Bitmap();
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        #ifdef __EMSCRIPTEN__
+            glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, bitmap.size(), bitmap.pixels());
+        #else
+            if (const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bitmap.size(), GL_MAP_READ_BIT)) {
+                memcpy(bitmap.pixels(), pixels, bitmap.size());
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            } else
+                bitmap.clear();
+        #endif
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        ODE_CHECK_GL_ERROR();
+        return bitmap;
+    #else
+        return (Bitmap &&) result;
+    #endif
+}
+
+}
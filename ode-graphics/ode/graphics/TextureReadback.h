@@ -0,0 +1,49 @@
+
+#pragma once
+
+#include <ode/math/Vector2.h>
+#include <ode/graphics/pixel-format.h>
+#include <ode/graphics/Bitmap.h>
+#include "gl.h"
+#include "Texture2D.h"
+#include "FrameBuffer.h"
+
+namespace ode {
+
+/// Transfers the contents of a texture to physical memory asynchronously through a pixel pack buffer, so that the GPU does not have to be stalled.
+/// The buffer is kept between transfers and reused if large enough. Without pixel pack buffer support (WebGL 1), the transfer is synchronous
+class TextureReadback {
+
+public:
+    TextureReadback();
+    TextureReadback(const TextureReadback &) = delete;
+    TextureReadback(TextureReadback &&orig);
+    ~TextureReadback();
+    TextureReadback &operator=(const TextureReadback &) = delete;
+    TextureReadback &operator=(TextureReadback &&orig);
+    /// Initiates the transfer of the texture's zero-th mipmap level (RGBA or PREMULTIPLIED_RGBA), abandoning any previous transfer
+    bool start(const Texture2D &texture);
+    /// Same as above but the transferred pixels are interpreted as format, which must have the same layout as the texture's format
+    bool start(const Texture2D &texture, PixelFormat format);
+    /// Returns true if a transfer has been started and its result not yet retrieved
+    bool pending() const;
+    /// Returns true if the transfer has completed, so that finish will not block
+    bool ready() const;
+    /// Waits for the transfer to complete and returns the transferred pixels
+    Bitmap finish();
+
+private:
+    FrameBuffer framebuffer;
+    GLuint buffer;
+    size_t capacity;
+    GLsync fence;
+    PixelFormat fmt;
+    Vector2i dims;
+    /// The result of a synchronous transfer
+    Bitmap result;
+
+    void releaseFence();
+
+};
+
+}
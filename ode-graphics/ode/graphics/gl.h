@@ -33,6 +33,11 @@
     #define glBindSampler (static_cast<void (*)(int, decltype(nullptr))>(nullptr))
 #endif
 
+#if !defined(ODE_WEBGL_COMPATIBILITY) || defined(ODE_USE_WEBGL2)
+    #define ODE_GL_ENABLE_PIXEL_PACK_BUFFERS
+    #define ODE_GL_ENABLE_PACK_ROW_LENGTH
+#endif
+
 #else // ODE_GRAPHICS_NO_CONTEXT
 
 #include <cstdint>
@@ -1,6 +1,9 @@
 
 #include "effect-margin.h"
 
+#include <cmath>
+#include <algorithm>
+
 namespace ode {
 
 UntransformedMargin effectMargin(const octopus::Effect &effect) {
@@ -51,4 +54,27 @@ UntransformedMargin effectMargin(const octopus::Effect &effect) {
     return UntransformedMargin();
 }
 
+double effectReach(const octopus::Effect &effect) {
+    switch (effect.type) {
+        case octopus::Effect::Type::INNER_SHADOW:
+            if (effect.shadow.has_value())
+                return fabs(effect.shadow->blur)+fabs(effect.shadow->choke)+std::max(fabs(effect.shadow->offset.x), fabs(effect.shadow->offset.y));
+            break;
+        case octopus::Effect::Type::INNER_GLOW:
+            if (effect.glow.has_value())
+                return fabs(effect.glow->blur)+fabs(effect.glow->choke);
+            break;
+        case octopus::Effect::Type::STROKE:
+            if (effect.stroke.has_value())
+                return fabs(effect.stroke->thickness);
+            break;
+        default:
+            {
+                UntransformedMargin margin = effectMargin(effect);
+                return std::max(std::max(fabs(margin.a.x), fabs(margin.a.y)), std::max(fabs(margin.b.x), fabs(margin.b.y)));
+            }
+    }
+    return 0;
+}
+
 }
@@ -12,4 +12,7 @@ constexpr double GAUSSIAN_BLUR_RANGE_FACTOR = 2.88563491242675714738760664632461
 /// Computes the graphical margin of a given effect relative to the layer's bounds
 UntransformedMargin effectMargin(const octopus::Effect &effect);
 
+/// Computes the maximum distance from a pixel of the effect's result to the parts of its basis which may affect it
+double effectReach(const octopus::Effect &effect);
+
 }
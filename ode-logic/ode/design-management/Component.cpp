@@ -2,9 +2,11 @@
 #include "Component.h"
 
 #include <cstring>
+#include <atomic>
 #include <octopus/parser.h>
 #include "../core/planar-intersections.h"
 #include "../core/octopus-type-conversions.h"
+#include "../core/effect-margin.h"
 #include "../render-assembly/assembly.h"
 #include "../render-assembly/graph-transform.h"
 #include "../animation/animate.h"
@@ -12,6 +14,11 @@
 
 namespace ode {
 
+// Number of modifications whose affected area is remembered for getDamage
+static constexpr size_t MAX_DAMAGE_HISTORY = 64;
+
+static std::atomic<unsigned long long> componentUniqueIdCounter(0);
+
 // TODO MOVE?
 static void listLayerMissingFonts(std::set<std::string> &names, const octopus::Layer &layer) {
     switch (layer.type) {
@@ -56,14 +63,15 @@ Result<ComponentPtr, DesignError> Component::create(const octopus::Component &co
     return DesignError::OCTOPUS_UNAVAILABLE;
 }
 
-Component::Component() { }
+Component::Component() : uid(++componentUniqueIdCounter) { }
 
-Component::Component(const std::string &id) : id(id) { }
+Component::Component(const std::string &id) : uid(++componentUniqueIdCounter), id(id) { }
 
 DesignError Component::initialize(const octopus::Octopus &octopus) {
     if (this->octopus.content.has_value())
         return DesignError::ALREADY_INITIALIZED;
     this->octopus = octopus;
+    recordUnknownDamage();
     return DesignError::OK;
 }
 
@@ -72,11 +80,13 @@ DesignError Component::initialize(octopus::Octopus &&octopus) {
         return DesignError::ALREADY_INITIALIZED;
     id = octopus.id;
     this->octopus = (octopus::Octopus &&) octopus;
+    recordUnknownDamage();
     return DesignError::OK;
 }
 
 DesignError Component::setFontBase(const FontBasePtr &fontBase) {
     this->fontBase = fontBase;
+    recordUnknownDamage();
     return DesignError::OK;
 }
 
@@ -142,6 +152,7 @@ DesignError Component::setAnimation(const DocumentAnimation &animation) {
             result = DesignError::LAYER_NOT_FOUND;
     }
     ++rev;
+    recordUnknownDamage();
     return result;
 }
 
@@ -184,6 +195,10 @@ DesignError Component::addLayer(const std::string &parent, const std::string &be
             }
             ++rev;
             buildComplete = false;
+            // The new layer's area is only known after rebuild
+            recordDamage(UnscaledBounds::unspecified, layer.id);
+            // The ID may have belonged to a removed layer
+            recordContentChange(layer);
             return DesignError::OK;
         }
     }
@@ -202,6 +217,7 @@ DesignError Component::removeLayer(const std::string &id) {
                 return layer.id == id;
             });
             if (layerInParentIt != layers->end()) {
+                UnscaledBounds previousBounds = layerDamageBounds(id);
                 layers->erase(layerInParentIt);
                 std::vector<std::string> instancesToErase;
                 for (const std::pair<const std::string, ode::LayerInstance> &instance : instances) {
@@ -214,6 +230,7 @@ DesignError Component::removeLayer(const std::string &id) {
                 }
                 ++rev;
                 buildComplete = false;
+                recordDamage(previousBounds, std::string());
                 return DesignError::OK;
             }
         }
@@ -226,6 +243,7 @@ DesignError Component::modifyLayer(const std::string &id, const octopus::LayerCh
         return error;
     if (LayerInstance *instance = findInstance(id)) {
         octopus::Layer &layer = **instance;
+        UnscaledBounds previousBounds = layerDamageBounds(id);
         if (Result<ChangeLevel, DesignError> result = applyLayerChange(layer, layerChange)) {
             switch (result.value()) {
                 case ChangeLevel::HIERARCHY:
@@ -247,6 +265,8 @@ DesignError Component::modifyLayer(const std::string &id, const octopus::LayerCh
             if (layer.type == octopus::Layer::Type::TEXT) {
                 instance->initializeText(fontBase.get());
             }
+            recordDamage(previousBounds, id);
+            contentSerials[id] = damageCounter;
             return DesignError::OK;
         } else
             return result.error();
@@ -261,6 +281,7 @@ DesignError Component::transformLayer(const std::string &id, octopus::Fill::Posi
         return error;
     if (LayerInstance *instance = findInstance(id)) {
         octopus::Layer &layer = *(octopus::Layer *) *instance;
+        UnscaledBounds previousBounds = layerDamageBounds(id);
         TransformationMatrix layerTranformation = fromOctopusTransform(layer.transform);
         switch (basis) {
             case octopus::Fill::Positioning::Origin::LAYER:
@@ -284,6 +305,7 @@ DesignError Component::transformLayer(const std::string &id, octopus::Fill::Posi
         toOctopusTransform(layer.transform, layerTranformation);
         instance->invalidateBounds();
         buildComplete = false;
+        recordDamage(previousBounds, id);
         return DesignError::OK;
     }
     return DesignError::LAYER_NOT_FOUND;
@@ -384,6 +406,33 @@ std::string Component::identifyLayer(const Vector2d &position, double radius) {
     return std::string();
 }
 
+bool Component::getDamage(int sinceSerial, UnscaledBounds &damage) {
+    if (sinceSerial < unknownDamageSerial || requireBuild())
+        return false;
+    // Effects based on the background may spread the damage of any layer to the layers above it
+    for (const std::pair<const std::string, LayerInstance> &instance : instances) {
+        for (const octopus::Effect &effect : instance.second->effects) {
+            if (effect.basis == octopus::EffectBasis::BACKGROUND)
+                return false;
+        }
+    }
+    damage = UnscaledBounds::unspecified;
+    for (const DamageRecord &record : damageHistory) {
+        if (record.serial > sinceSerial) {
+            damage |= record.previousBounds;
+            if (!record.layerId.empty())
+                damage |= layerDamageBounds(record.layerId);
+        }
+    }
+    damage = damage.canonical();
+    return true;
+}
+
+int Component::layerContentSerial(const std::string &id) const {
+    std::map<std::string, int>::const_iterator it = contentSerials.find(id);
+    return it != contentSerials.end() ? it->second : unknownContentSerial;
+}
+
 void Component::listMissingFonts(std::set<std::string> &names) const {
     if (octopus.content.has_value())
         listLayerMissingFonts(names, *octopus.content);
@@ -507,6 +556,51 @@ bool Component::isInstanceInSubtree(const std::string &subtreeId, const std::str
     return false;
 }
 
+UnscaledBounds Component::layerDamageBounds(const std::string &id) {
+    UnscaledBounds bounds = UnscaledBounds::unspecified;
+    for (const std::pair<const std::string, LayerInstance> &instance : instances) {
+        if (UnscaledBounds instanceBounds = instance.second.bounds().bounds) {
+            if (isInstanceInSubtree(id, instance.first)) {
+                // Effects of the layer and its ancestors may spread its content further
+                double reach = 0;
+                for (const LayerInstance *layer = &instance.second; layer; layer = findInstance(layer->getParentId())) {
+                    for (const octopus::Effect &effect : (*layer)->effects)
+                        reach += layer->featureScale()*effectReach(effect);
+                }
+                bounds |= instanceBounds+UnscaledMargin(reach);
+            }
+        }
+    }
+    return bounds;
+}
+
+void Component::recordDamage(const UnscaledBounds &previousBounds, const std::string &layerId) {
+    DamageRecord record;
+    record.serial = ++damageCounter;
+    record.previousBounds = previousBounds;
+    record.layerId = layerId;
+    damageHistory.push_back((DamageRecord &&) record);
+    if (damageHistory.size() > MAX_DAMAGE_HISTORY) {
+        unknownDamageSerial = damageHistory.front().serial;
+        damageHistory.pop_front();
+    }
+}
+
+void Component::recordUnknownDamage() {
+    unknownDamageSerial = ++damageCounter;
+    damageHistory.clear();
+    unknownContentSerial = damageCounter;
+    contentSerials.clear();
+}
+
+void Component::recordContentChange(const octopus::Layer &layer) {
+    contentSerials[layer.id] = damageCounter;
+    if (layer.layers.has_value()) {
+        for (const octopus::Layer &child : layer.layers.value())
+            recordContentChange(child);
+    }
+}
+
 RendexSubtree Component::assembleLayer(const LayerInstance &instance, const nonstd::optional<octopus::MaskBasis> &maskBasis) {
     int flags = assemblyFlags(instance);
     switch (instance->type) {
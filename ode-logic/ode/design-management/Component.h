@@ -3,6 +3,7 @@
 
 #include <string>
 #include <set>
+#include <deque>
 #include <map>
 #include <memory>
 #include <nonstd/optional.hpp>
@@ -42,8 +43,14 @@ public:
     Component &operator=(Component &&orig) = default;
 
     inline const std::string &getId() const { return id; }
+    /// Returns a number which identifies this component object - unlike its address, it is never reused by another component
+    inline unsigned long long uniqueId() const { return uid; }
     /// Returns the revision number which increments after each modification
     inline int revision() const { return rev; }
+    /// Returns the number of modifications which may have changed the component's appearance, see getDamage
+    inline int damageSerial() const { return damageCounter; }
+    /// Returns the damage serial of the last modification of the layer's own content (excluding its transformation and child layers)
+    int layerContentSerial(const std::string &id) const;
 
     DesignError initialize(const octopus::Octopus &octopus);
     DesignError initialize(octopus::Octopus &&octopus);
@@ -92,6 +99,9 @@ public:
     Result<LayerAnimation::Keyframe, DesignError> getAnimationValue(int index, double time) const;
     /// Attempts to find a layer by its position within the component - returns the tompost if multiple
     std::string identifyLayer(const Vector2d &position, double radius);
+    /// Outputs a conservative estimate of the area (including effect margins) whose appearance may have changed since damageSerial() returned sinceSerial.
+    /// Returns false if the area is unknown and the whole component must be considered changed
+    bool getDamage(int sinceSerial, UnscaledBounds &damage);
 
     /// Adds component's missing fonts to the set of names
     void listMissingFonts(std::set<std::string> &names) const;
@@ -103,6 +113,7 @@ public:
 
 private:
 
+    unsigned long long uid;
     std::string id;
     std::string name;
     Vector2d position;
@@ -118,11 +129,32 @@ private:
     // TODO remove when animations are indexed by id
     DocumentAnimation allAnimations;
 
+    /// A modification of a layer - the area it covered before and the layer whose current area is also affected
+    struct DamageRecord {
+        int serial;
+        UnscaledBounds previousBounds;
+        std::string layerId;
+    };
+    /// Number of modifications which may have changed the component's appearance
+    int damageCounter = 0;
+    /// The affected area of modifications up to this serial number is unknown
+    int unknownDamageSerial = 0;
+    std::deque<DamageRecord> damageHistory;
+    /// Damage serials of the last content modification of individual layers, layers not present were last modified at unknownContentSerial
+    std::map<std::string, int> contentSerials;
+    int unknownContentSerial = 0;
+
     static int assemblyFlags(const LayerInstance &instance);
 
     LayerInstance *findInstance(const std::string &id);
 
     bool isInstanceInSubtree(const std::string &subtreeId, const std::string &instanceId);
+    /// Returns the area affected by the appearance of the layer and its descendants, including effects of ancestors
+    UnscaledBounds layerDamageBounds(const std::string &id);
+    void recordDamage(const UnscaledBounds &previousBounds, const std::string &layerId);
+    void recordUnknownDamage();
+    /// Marks the content of layer and its descendants as modified by the last damage record
+    void recordContentChange(const octopus::Layer &layer);
 
     DesignError requireBuild();
     DesignError rebuild();
@@ -70,6 +70,10 @@ int Design::ComponentAccessor::revision() const {
     return component->revision();
 }
 
+int Design::ComponentAccessor::damageSerial() const {
+    return component->damageSerial();
+}
+
 Result<octopus::Octopus, DesignError> Design::ComponentAccessor::buildOctopus() const {
     return component->buildOctopus();
 }
@@ -94,6 +98,10 @@ std::string Design::ComponentAccessor::identifyLayer(const Vector2d &position, d
     return component->identifyLayer(position, radius);
 }
 
+bool Design::ComponentAccessor::getDamage(int sinceSerial, UnscaledBounds &damage) {
+    return component->getDamage(sinceSerial, damage);
+}
+
 void Design::ComponentAccessor::listMissingFonts(std::set<std::string> &names) const {
     return component->listMissingFonts(names);
 }
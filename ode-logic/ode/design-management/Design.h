@@ -43,6 +43,7 @@ public:
 
         const std::string &getId() const;
         int revision() const;
+        int damageSerial() const;
         const octopus::Octopus &getOctopus() const;
         const Vector2d &getPositon() const;
         Result<const octopus::Layer *, DesignError> getLayerOctopus(const std::string &id);
@@ -52,6 +53,7 @@ public:
         Result<LayerMetrics, DesignError> getLayerMetrics(const std::string &id);
         Result<LayerAnimation::Keyframe, DesignError> getAnimationValue(int index, double time) const;
         std::string identifyLayer(const Vector2d &position, double radius);
+        bool getDamage(int sinceSerial, UnscaledBounds &damage);
         // Additional Layer stuff here
         void listMissingFonts(std::set<std::string> &names) const;
 
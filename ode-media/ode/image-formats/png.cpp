@@ -244,6 +244,87 @@ bool writePng(SparseBitmapConstRef bitmap, std::vector<byte> &pngData) {
     return true;
 }
 
+struct PngWriter::Internal {
+    FilePtr file;
+    png_structp png;
+    png_infop info;
+    PixelFormat format;
+    Vector2i dimensions;
+    int rowsWritten;
+
+    inline Internal() : png(nullptr), info(nullptr), format(PixelFormat::EMPTY), rowsWritten(0) { }
+    Internal(const Internal &) = delete;
+    inline ~Internal() {
+        if (png)
+            png_destroy_write_struct(&png, &info);
+    }
+};
+
+PngWriter::PngWriter() = default;
+
+PngWriter::~PngWriter() = default;
+
+bool PngWriter::open(const FilePath &path, PixelFormat format, const Vector2i &dimensions) {
+    internal.reset();
+    if (!(dimensions.x > 0 && dimensions.y > 0))
+        return false;
+    ODE_ASSERT(format == PixelFormat::R || format == PixelFormat::RGB || format == PixelFormat::RGBA);
+    if (!(format == PixelFormat::R || format == PixelFormat::RGB || format == PixelFormat::RGBA))
+        return false;
+    std::unique_ptr<Internal> state(new Internal);
+    state->file = openFile(path, true);
+    if (!state->file)
+        return false;
+    state->png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, pngError, pngWarning);
+    if (!state->png)
+        return false;
+    state->info = png_create_info_struct(state->png);
+    if (!state->info)
+        return false;
+    // Error handling (archaic longjump model)
+    if (setjmp(png_jmpbuf(state->png)))
+        return false;
+    png_init_io(state->png, state->file);
+    int colorType = format == PixelFormat::RGBA ? PNG_COLOR_TYPE_RGB_ALPHA : format == PixelFormat::RGB ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_GRAY;
+    png_set_IHDR(state->png, state->info, dimensions.x, dimensions.y, 8, colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(state->png, state->info);
+    state->format = format;
+    state->dimensions = dimensions;
+    internal = (std::unique_ptr<Internal> &&) state;
+    return true;
+}
+
+bool PngWriter::writeRows(SparseBitmapConstRef rows) {
+    if (!internal)
+        return false;
+    if (!(rows.format == internal->format && rows.width() == internal->dimensions.x && internal->rowsWritten+rows.height() <= internal->dimensions.y)) {
+        internal.reset();
+        return false;
+    }
+    if (setjmp(png_jmpbuf(internal->png))) {
+        internal.reset();
+        return false;
+    }
+    for (int y = 0; y < rows.height(); ++y)
+        png_write_row(internal->png, static_cast<png_const_bytep>(rows(0, y)));
+    internal->rowsWritten += rows.height();
+    return true;
+}
+
+bool PngWriter::close() {
+    if (!internal)
+        return false;
+    bool complete = internal->rowsWritten == internal->dimensions.y;
+    if (complete) {
+        if (setjmp(png_jmpbuf(internal->png)))
+            complete = false;
+        else
+            png_write_end(internal->png, NULL);
+    }
+    internal.reset();
+    return complete;
+}
+
 }
 
 #endif
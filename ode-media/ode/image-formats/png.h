@@ -4,6 +4,7 @@
 #ifdef ODE_MEDIA_PNG_SUPPORT
 
 #include <cstdio>
+#include <memory>
 #include <ode-essentials.h>
 
 namespace ode {
@@ -20,6 +21,27 @@ bool savePng(const FilePath &path, SparseBitmapConstRef bitmap);
 /// Encode bitmap data as PNG and write into memory buffer
 bool writePng(SparseBitmapConstRef bitmap, std::vector<byte> &pngData);
 
+/// Writes a PNG file progressively, a batch of rows at a time, so that the whole image never has to be held in memory
+class PngWriter {
+
+public:
+    PngWriter();
+    PngWriter(const PngWriter &) = delete;
+    ~PngWriter();
+    PngWriter &operator=(const PngWriter &) = delete;
+    /// Creates the file and writes its header - format must be R, RGB, or RGBA
+    bool open(const FilePath &path, PixelFormat format, const Vector2i &dimensions);
+    /// Appends the next rows of the image, which must match the format and width passed to open
+    bool writeRows(SparseBitmapConstRef rows);
+    /// Completes the file - fails if not all rows have been written
+    bool close();
+
+private:
+    struct Internal;
+    std::unique_ptr<Internal> internal;
+
+};
+
 }
 
 #endif
@@ -4,11 +4,13 @@
 #ifdef ODE_RASTERIZER_TEXTURE_SUPPORT
 #include <ode/graphics/gl.h>
 #include <ode/graphics/gl-state-check.h>
+#include <ode/graphics/GLStateCache.h>
 #endif
 
 #include <vector>
 
 #include <skia/core/SkPath.h>
+#include <skia/core/SkRRect.h>
 #include <skia/core/SkPathEffect.h>
 #include <skia/core/SkColorSpace.h>
 #include <skia/core/SkSurface.h>
@@ -300,6 +302,33 @@ Rectangle<double> Rasterizer::getBounds(Shape *shape, int strokeIndex, const Mat
     return bounds;
 }
 
+bool Rasterizer::getRoundedRectangle(Shape *shape, const Matrix3x2d &transformation, Rectangle<double> &rectangle, double &cornerRadius) {
+    ODE_ASSERT(shape);
+    SkMatrix matrix = makeMatrix(transformation);
+    if (shape->bodyPath.isInverseFillType() || !matrix.rectStaysRect())
+        return false;
+    SkRect rect;
+    SkRRect rrect;
+    if (shape->bodyPath.isRect(&rect))
+        rrect.setRect(rect);
+    else if (!shape->bodyPath.isRRect(&rrect))
+        return false;
+    SkRRect transformedRRect;
+    if (!rrect.transform(matrix, &transformedRRect) || transformedRRect.isEmpty())
+        return false;
+    // Oval and simple rounded rectangles have identical radii in all corners, only circular corners are supported
+    if (!(transformedRRect.isRect() || transformedRRect.isOval() || transformedRRect.isSimple()))
+        return false;
+    SkVector radii = transformedRRect.getSimpleRadii();
+    if (radii.fX != radii.fY)
+        return false;
+    rect = transformedRRect.rect();
+    rectangle.a = Vector2d(double(rect.fLeft), double(rect.fTop));
+    rectangle.b = Vector2d(double(rect.fRight), double(rect.fBottom));
+    cornerRadius = double(radii.fX);
+    return true;
+}
+
 #ifdef ODE_RASTERIZER_TEXTURE_SUPPORT
 GrDirectContext * Rasterizer::Internal::getGraphicsContext() {
     if (!graphicsContext)
@@ -348,8 +377,12 @@ bool Rasterizer::rasterize(Shape *shape, int strokeIndex, const Matrix3x2d &tran
     #ifdef ODE_RASTERIZER_TEXTURE_SUPPORT
         ODE_ASSERT(shape && dstTexture.handle && dstTexture.format != PixelFormat::EMPTY && dstTexture.dimensions.x > 0 && dstTexture.dimensions.y > 0);
         // TODO support other pixel types?
-        ODE_ASSERT(dstTexture.format == PixelFormat::RGBA || dstTexture.format == PixelFormat::PREMULTIPLIED_RGBA);
-        if (!(pixelChannels(dstTexture.format) == 4 && pixelHasAlpha(dstTexture.format) && !isPixelFloat(dstTexture.format)))
+        ODE_ASSERT(dstTexture.format == PixelFormat::RGBA || dstTexture.format == PixelFormat::PREMULTIPLIED_RGBA || dstTexture.format == PixelFormat::R);
+        if (isPixelFloat(dstTexture.format))
+            return false;
+        // Coverage only is rasterized into single-channel textures
+        bool alphaOnly = pixelChannels(dstTexture.format) == 1;
+        if (!(alphaOnly || (pixelChannels(dstTexture.format) == 4 && pixelHasAlpha(dstTexture.format))))
             return false;
         if (GrDirectContext *context = data->getGraphicsContext()) {
             bool result = false;
@@ -361,15 +394,18 @@ bool Rasterizer::rasterize(Shape *shape, int strokeIndex, const Matrix3x2d &tran
                 GrGLTextureInfo textureInfo = { };
                 textureInfo.fTarget = GL_TEXTURE_2D;
                 textureInfo.fID = dstTexture.handle;
-                textureInfo.fFormat = GL_RGBA8;
+                textureInfo.fFormat = alphaOnly ? GL_R8 : GL_RGBA8;
                 GrBackendTexture backendTexture(dstTexture.dimensions.x, dstTexture.dimensions.y, GrMipMapped::kNo, textureInfo);
-                sk_sp<SkSurface> surface = SkSurface::MakeFromBackendTexture(context, backendTexture, GrSurfaceOrigin::kTopLeft_GrSurfaceOrigin, 0, SkColorType::kRGBA_8888_SkColorType, SkColorSpace::MakeSRGBLinear(), nullptr);
-                surface->getCanvas()->clear(SkColor(0));
-                result = data->rasterize(shape, strokeIndex, transformation, surface.get());
-                auto texture = surface->getBackendTexture(SkSurface::kFlushRead_BackendHandleAccess);
+                sk_sp<SkSurface> surface = SkSurface::MakeFromBackendTexture(context, backendTexture, GrSurfaceOrigin::kTopLeft_GrSurfaceOrigin, 0, alphaOnly ? SkColorType::kAlpha_8_SkColorType : SkColorType::kRGBA_8888_SkColorType, alphaOnly ? nullptr : SkColorSpace::MakeSRGBLinear(), nullptr);
+                if (surface) {
+                    surface->getCanvas()->clear(SkColor(0));
+                    result = data->rasterize(shape, strokeIndex, transformation, surface.get());
+                    auto texture = surface->getBackendTexture(SkSurface::kFlushRead_BackendHandleAccess);
+                }
                 //surface->flushAndSubmit(); // not needed?
             }
             // Restore ODE's OpenGL state
+            GLStateCache::invalidate();
             glDisable(GL_BLEND);
             glDisable(GL_SCISSOR_TEST);
             glDisable(GL_STENCIL_TEST);
@@ -50,9 +50,11 @@ public:
 
     /// Returns the graphical bounds of the shape
     static Rectangle<double> getBounds(Shape *shape, int strokeIndex, const Matrix3x2d &transformation);
+    /// If the transformed body of the shape is an axis-aligned rectangle with uniformly rounded (circular) corners, outputs it and returns true
+    static bool getRoundedRectangle(Shape *shape, const Matrix3x2d &transformation, Rectangle<double> &rectangle, double &cornerRadius);
     /// Rasterizes the shape (or its stroke) into a bitmap
     bool rasterize(Shape *shape, int strokeIndex, const Matrix3x2d &transformation, const BitmapRef &dstBitmap);
-    /// Rasterizes the shape (or its stroke) into a texture (the texture must be initialized)
+    /// Rasterizes the shape (or its stroke) into a texture (the texture must be initialized) - into the red channel if it is single-channel
     bool rasterize(Shape *shape, int strokeIndex, const Matrix3x2d &transformation, const TextureDescriptor &dstTexture);
 
 private:
@@ -14,8 +14,9 @@ TextureFrameBuffer::~TextureFrameBuffer() {
         parent->relinquish((TextureFrameBuffer &&) *this);
 }
 
-bool TextureFrameBuffer::initialize(const Vector2i &dimensions) {
-    if (!Texture2D::initialize(PixelFormat::PREMULTIPLIED_RGBA, dimensions))
+bool TextureFrameBuffer::initialize(const Vector2i &dimensions, PixelFormat format) {
+    ODE_ASSERT(format == PixelFormat::PREMULTIPLIED_RGBA || format == PixelFormat::R || format == PixelFormat::RGBA);
+    if (!Texture2D::initialize(format, dimensions))
         return false;
     frameBuffer.setOutput(this);
     return true;
@@ -19,8 +19,8 @@ public:
     TextureFrameBuffer(TextureFrameBuffer &&orig, TextureFrameBufferManager *parent);
     virtual ~TextureFrameBuffer();
     TextureFrameBuffer &operator=(const TextureFrameBuffer &) = delete;
-    /// Initializes the framebuffer with the specified image dimensions
-    bool initialize(const Vector2i &dimensions);
+    /// Initializes the framebuffer with the specified image dimensions and pixel format (PREMULTIPLIED_RGBA, single-channel R, or RGBA for raw data)
+    bool initialize(const Vector2i &dimensions, PixelFormat format = PixelFormat::PREMULTIPLIED_RGBA);
     /// Binds as texture to the specified texture unit
     void bind(int unit) const;
     /// Binds as the output rendering framebuffer
@@ -1,36 +1,98 @@
 
 #include "TextureFrameBufferManager.h"
 
+#include <algorithm>
+
 namespace ode {
 
-bool TextureFrameBufferManager::DimsCmp::operator()(const Vector2i &a, const Vector2i &b) const {
-    return a.y < b.y || (a.y == b.y && a.x < b.x);
+bool TextureFrameBufferManager::StockKeyCmp::operator()(const StockKey &a, const StockKey &b) const {
+    if (a.first != b.first)
+        return a.first < b.first;
+    return a.second.y < b.second.y || (a.second.y == b.second.y && a.second.x < b.second.x);
+}
+
+PixelFormat TextureFrameBufferManager::alphaOnlyFormat() {
+    #ifdef ODE_WEBGL_COMPATIBILITY
+        // Single-channel textures are stored as luminance, which is not color-renderable
+        return PixelFormat::PREMULTIPLIED_RGBA;
+    #else
+        return PixelFormat::R;
+    #endif
+}
+
+PixelFormat TextureFrameBufferManager::rawDataFormat() {
+    return PixelFormat::RGBA;
 }
 
-TextureFrameBufferPtr TextureFrameBufferManager::acquire(PixelBounds &bounds) {
+TextureFrameBufferPtr TextureFrameBufferManager::acquire(PixelBounds &bounds, PixelFormat format) {
     Vector2i dimensions = bounds.dimensions();
     dimensions.x = (dimensions.x+0xff)&~0xff;
     dimensions.y = (dimensions.y+0xff)&~0xff;
     bounds.b = bounds.a+dimensions;
-    return acquireExact(bounds);
+    return acquireExact(bounds, format);
 }
 
-TextureFrameBufferPtr TextureFrameBufferManager::acquireExact(const PixelBounds &bounds) {
-    std::map<Vector2i, std::vector<TextureFrameBuffer>, DimsCmp>::iterator it = stock.find(bounds.dimensions());
+TextureFrameBufferPtr TextureFrameBufferManager::acquireExact(const PixelBounds &bounds, PixelFormat format) {
+    std::map<StockKey, std::vector<TextureFrameBuffer>, StockKeyCmp>::iterator it = stock.find(StockKey(format, bounds.dimensions()));
     if (it == stock.end() || it->second.empty()) {
+        enforceBudget(framebufferMemory(format, bounds.dimensions()));
         TextureFrameBufferPtr result(new TextureFrameBuffer(this));
-        if (!result->initialize(bounds.dimensions()))
+        if (!result->initialize(bounds.dimensions(), format))
             return nullptr;
         return result;
     } else {
         TextureFrameBufferPtr result(new TextureFrameBuffer((TextureFrameBuffer &&) it->second.back(), this));
         it->second.pop_back();
+        stockMemory -= framebufferMemory(format, bounds.dimensions());
         return result;
     }
 }
 
 void TextureFrameBufferManager::relinquish(TextureFrameBuffer &&obj) {
-    stock[obj.dimensions()].emplace_back((TextureFrameBuffer &&) obj, nullptr);
+    stockMemory += framebufferMemory(obj.format(), obj.dimensions());
+    stock[StockKey(obj.format(), obj.dimensions())].emplace_back((TextureFrameBuffer &&) obj, nullptr);
+}
+
+void TextureFrameBufferManager::clear() {
+    stock.clear();
+    stockMemory = 0;
+}
+
+void TextureFrameBufferManager::setMemoryBudget(size_t bytes) {
+    memoryBudget = bytes;
+    enforceBudget(0);
+}
+
+void TextureFrameBufferManager::addRetainer(Retainer *retainer) {
+    ODE_ASSERT(retainer);
+    retainers.push_back(retainer);
+}
+
+void TextureFrameBufferManager::removeRetainer(Retainer *retainer) {
+    retainers.erase(std::remove(retainers.begin(), retainers.end(), retainer), retainers.end());
+}
+
+size_t TextureFrameBufferManager::framebufferMemory(PixelFormat format, const Vector2i &dimensions) {
+    return pixelSize(format)*size_t(dimensions.x)*size_t(dimensions.y);
+}
+
+void TextureFrameBufferManager::enforceBudget(size_t additionalMemory) {
+    while (true) {
+        size_t memory = stockMemory+additionalMemory;
+        for (const Retainer *retainer : retainers)
+            memory += retainer->retainedMemory();
+        if (memory <= memoryBudget)
+            return;
+        // Pooled framebuffers are released first, retained ones are evicted (which returns them to the pool) only when the pool is empty
+        if (stockMemory) {
+            std::map<StockKey, std::vector<TextureFrameBuffer>, StockKeyCmp>::iterator it = stock.begin();
+            while (it->second.empty())
+                ++it;
+            stockMemory -= framebufferMemory(it->first.first, it->first.second);
+            it->second.pop_back();
+        } else if (!std::any_of(retainers.begin(), retainers.end(), [](Retainer *retainer) { return retainer->evict(); }))
+            return;
+    }
 }
 
 }
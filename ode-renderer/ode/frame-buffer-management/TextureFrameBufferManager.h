@@ -1,8 +1,10 @@
 
 #pragma once
 
+#include <cstddef>
 #include <vector>
 #include <map>
+#include <utility>
 #include <ode-essentials.h>
 #include <ode/core/bounds.h>
 #include "TextureFrameBuffer.h"
@@ -13,20 +15,53 @@ namespace ode {
 class TextureFrameBufferManager {
 
 public:
+    /// Default limit of the memory occupied by pooled and retained framebuffers (in bytes)
+    static constexpr size_t DEFAULT_MEMORY_BUDGET = size_t(256)<<20;
+
+    /// A cache which retains framebuffers across renders - its framebuffers count towards the manager's memory budget and are evicted when it is exceeded
+    class Retainer {
+    public:
+        virtual ~Retainer() = default;
+        /// Returns the memory occupied by retained framebuffers (in bytes)
+        virtual size_t retainedMemory() const = 0;
+        /// Releases the least recently used retained framebuffer - returns false if there was none
+        virtual bool evict() = 0;
+    };
+
+    /// Pixel format for framebuffers which only hold coverage (alpha) - single-channel where it is renderable, otherwise PREMULTIPLIED_RGBA
+    static PixelFormat alphaOnlyFormat();
+    /// Pixel format for framebuffers which hold raw data other than color in four 8-bit channels - RGBA, which is never interpreted as premultiplied
+    static PixelFormat rawDataFormat();
+
     /// Provides a texture framebuffer with the specified or larger bounds
-    TextureFrameBufferPtr acquire(PixelBounds &bounds);
+    TextureFrameBufferPtr acquire(PixelBounds &bounds, PixelFormat format = PixelFormat::PREMULTIPLIED_RGBA);
     /// Provides a texture framebuffer with exactly the specified bounds
-    TextureFrameBufferPtr acquireExact(const PixelBounds &bounds);
+    TextureFrameBufferPtr acquireExact(const PixelBounds &bounds, PixelFormat format = PixelFormat::PREMULTIPLIED_RGBA);
     /// Returns the texture framebuffer to the manager
     void relinquish(TextureFrameBuffer &&obj);
+    /// Releases all pooled framebuffers
+    void clear();
+    void setMemoryBudget(size_t bytes);
+    /// Registers a retainer, which must be removed before it is destroyed
+    void addRetainer(Retainer *retainer);
+    void removeRetainer(Retainer *retainer);
 
 private:
-    class DimsCmp {
+    typedef std::pair<PixelFormat, Vector2i> StockKey;
+
+    class StockKeyCmp {
     public:
-        bool operator()(const Vector2i &a, const Vector2i &b) const;
+        bool operator()(const StockKey &a, const StockKey &b) const;
     };
 
-    std::map<Vector2i, std::vector<TextureFrameBuffer>, DimsCmp> stock;
+    std::map<StockKey, std::vector<TextureFrameBuffer>, StockKeyCmp> stock;
+    size_t stockMemory = 0;
+    size_t memoryBudget = DEFAULT_MEMORY_BUDGET;
+    std::vector<Retainer *> retainers;
+
+    static size_t framebufferMemory(PixelFormat format, const Vector2i &dimensions);
+    /// Releases pooled and then retained framebuffers until there is room for additionalMemory within the budget
+    void enforceBudget(size_t additionalMemory);
 
 };
 
@@ -12,9 +12,12 @@ BitmapPtr BitmapImage::asBitmap() const {
 TexturePtr BitmapImage::asTexture() const {
     if (!bitmap)
         return nullptr;
-    TexturePtr texture(new Texture2D);
-    if (!texture->initialize(*bitmap))
-        return nullptr;
+    if (!texture) {
+        TexturePtr newTexture(new Texture2D);
+        if (!newTexture->initialize(*bitmap))
+            return nullptr;
+        texture = (TexturePtr &&) newTexture;
+    }
     return texture;
 }
 
@@ -22,4 +25,12 @@ Vector2i BitmapImage::dimensions() const {
     return bitmap ? bitmap->dimensions() : Vector2i();
 }
 
+bool BitmapImage::bitmapResident() const {
+    return true;
+}
+
+bool BitmapImage::textureResident() const {
+    return texture != nullptr;
+}
+
 }
@@ -8,7 +8,8 @@
 
 namespace ode {
 
-/// An image stored as a bitmap in physical memory
+/// An image stored as a bitmap in physical memory. Its texture is uploaded on first use and kept along with the bitmap,
+/// which must therefore not be modified after the image is first used as a texture
 class BitmapImage : public Image {
 
 public:
@@ -16,9 +17,12 @@ public:
     virtual BitmapPtr asBitmap() const override;
     virtual TexturePtr asTexture() const override;
     virtual Vector2i dimensions() const override;
+    virtual bool bitmapResident() const override;
+    virtual bool textureResident() const override;
 
 private:
     BitmapPtr bitmap;
+    mutable TexturePtr texture;
 
 };
 
@@ -25,4 +25,10 @@ ImagePtr Image::fromTexture(const TexturePtr &texture, TransparencyMode transpar
     return ImagePtr(new TextureImage(texture, transparencyMode, borderMode));
 }
 
+ImagePtr Image::fromAlphaTexture(const TexturePtr &texture, BorderMode borderMode) {
+    if (!texture)
+        return nullptr;
+    return ImagePtr(new TextureImage(texture, pixelChannels(texture->format()) == 1 ? RED_IS_ALPHA : PREMULTIPLIED, borderMode));
+}
+
 }
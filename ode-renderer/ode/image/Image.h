@@ -43,6 +43,8 @@ public:
     static ImagePtr fromBitmap(Bitmap &&bitmap, TransparencyMode transparencyMode, BorderMode borderMode = NO_BORDER);
     /// Constructs an Image from a texture
     static ImagePtr fromTexture(const TexturePtr &texture, TransparencyMode transparencyMode, BorderMode borderMode = NO_BORDER);
+    /// Constructs an alpha only Image from a texture whose channels all hold the alpha value - single-channel textures are RED_IS_ALPHA, others PREMULTIPLIED (white)
+    static ImagePtr fromAlphaTexture(const TexturePtr &texture, BorderMode borderMode = NO_BORDER);
 
     Image(const Image &) = delete;
     virtual ~Image() = default;
@@ -53,6 +55,10 @@ public:
     virtual TexturePtr asTexture() const = 0;
     /// Returns the image's dimensions
     virtual Vector2i dimensions() const = 0;
+    /// Returns true if the image's pixels reside in physical memory, so that asBitmap does not require a transfer
+    virtual bool bitmapResident() const = 0;
+    /// Returns true if the image's pixels reside in video memory, so that asTexture does not require a transfer
+    virtual bool textureResident() const = 0;
     /// Returns the image's transparency mode
     constexpr TransparencyMode transparencyMode() const { return tMode; }
     /// Returns the image's border mode
@@ -17,4 +17,12 @@ Vector2i TextureImage::dimensions() const {
     return texture ? texture->dimensions() : Vector2i();
 }
 
+bool TextureImage::bitmapResident() const {
+    return false;
+}
+
+bool TextureImage::textureResident() const {
+    return true;
+}
+
 }
@@ -16,6 +16,8 @@ public:
     virtual BitmapPtr asBitmap() const override;
     virtual TexturePtr asTexture() const override;
     virtual Vector2i dimensions() const override;
+    virtual bool bitmapResident() const override;
+    virtual bool textureResident() const override;
 
 private:
     TexturePtr texture;
@@ -0,0 +1,203 @@
+
+#include "CompositingChain.h"
+
+namespace ode {
+
+static int operandCount(const Rendexpr *expr) {
+    switch (expr->type) {
+        case BlendExpression::TYPE:
+        case BlendIgnoreAlphaExpression::TYPE:
+        case MaskExpression::TYPE:
+        case MixExpression::TYPE:
+            return 2;
+        case MixMaskExpression::TYPE:
+            return 3;
+        case MultiplyAlphaExpression::TYPE:
+            return 1;
+    }
+    return 0;
+}
+
+bool CompositingChain::isFusible(const Rendexpr *expr) {
+    return expr && operandCount(expr) > 0;
+}
+
+bool CompositingChain::build(const Rendexpr *root, const Exclusion &exclusion) {
+    nodeList.clear();
+    inputList.clear();
+    sig.clear();
+    blend = false;
+    chainBlendMode = octopus::BlendMode::NORMAL;
+    this->exclusion = exclusion ? &exclusion : nullptr;
+    if (!canInline(root, 0)) {
+        this->exclusion = nullptr;
+        return false;
+    }
+    addNode(root, 0, true);
+    this->exclusion = nullptr;
+    if (int(nodeList.size()-inputList.size()) < 2)
+        return false;
+
+    // Signature
+    if (blend)
+        sig = std::to_string(int(chainBlendMode))+":";
+    for (const Node &node : nodeList) {
+        switch (node.operation) {
+            case INPUT:
+                sig.push_back('i');
+                break;
+            case BLEND:
+                sig.push_back('b');
+                break;
+            case BLEND_IGNORE_ALPHA:
+                sig.push_back('B');
+                break;
+            case MASK:
+                sig.push_back('m');
+                break;
+            case MIX_MASK:
+                sig.push_back('M');
+                break;
+            case MIX:
+                sig.push_back('x');
+                break;
+            case MULTIPLY_ALPHA:
+                sig.push_back('a');
+                break;
+        }
+        if (node.operation != INPUT) {
+            for (int i = 0, n = node.operation == MULTIPLY_ALPHA ? 1 : node.operation == MIX_MASK ? 3 : 2; i < n; ++i) {
+                sig += i ? "," : "(";
+                sig += std::to_string(node.operands[i]);
+            }
+            sig.push_back(')');
+        }
+        sig.push_back(';');
+    }
+    return true;
+}
+
+const std::vector<CompositingChain::Node> &CompositingChain::nodes() const {
+    return nodeList;
+}
+
+const std::vector<const Rendexpr *> &CompositingChain::inputs() const {
+    return inputList;
+}
+
+const std::string &CompositingChain::signature() const {
+    return sig;
+}
+
+bool CompositingChain::hasBlend() const {
+    return blend;
+}
+
+octopus::BlendMode CompositingChain::blendMode() const {
+    return chainBlendMode;
+}
+
+bool CompositingChain::canInline(const Rendexpr *expr, int reservedInputs) const {
+    if (!isFusible(expr) || (exclusion && (*exclusion)(expr)))
+        return false;
+    // Each operand requires at least one input - the remaining operands of ancestors are already reserved
+    if (int(inputList.size())+reservedInputs+operandCount(expr) > MAX_INPUTS)
+        return false;
+    if (expr->type == BlendExpression::TYPE || expr->type == BlendIgnoreAlphaExpression::TYPE) {
+        octopus::BlendMode mode = expr->type == BlendExpression::TYPE ? static_cast<const BlendExpression *>(expr)->blendMode : static_cast<const BlendIgnoreAlphaExpression *>(expr)->blendMode;
+        // Blend functions of different modes cannot be combined in a single shader program
+        if (mode == octopus::BlendMode::PASS_THROUGH || (blend && mode != chainBlendMode))
+            return false;
+    }
+    return true;
+}
+
+int CompositingChain::addNode(const Rendexpr *expr, int reservedInputs, bool root) {
+    // Shared subexpressions are evaluated (and cached) separately
+    if (!(root || (expr->refs <= 1 && canInline(expr, reservedInputs))))
+        return addInput(expr);
+
+    Node node = { };
+    const Rendexpr *operands[3] = { };
+    int n = operandCount(expr);
+    switch (expr->type) {
+        case BlendExpression::TYPE:
+            {
+                const BlendExpression *blendExpr = static_cast<const BlendExpression *>(expr);
+                node.operation = BLEND;
+                node.blendMode = blendExpr->blendMode;
+                operands[0] = blendExpr->dst.get();
+                operands[1] = blendExpr->src.get();
+                break;
+            }
+        case BlendIgnoreAlphaExpression::TYPE:
+            {
+                const BlendIgnoreAlphaExpression *blendExpr = static_cast<const BlendIgnoreAlphaExpression *>(expr);
+                node.operation = BLEND_IGNORE_ALPHA;
+                node.blendMode = blendExpr->blendMode;
+                node.parameter = 1;
+                operands[0] = blendExpr->dst.get();
+                operands[1] = blendExpr->src.get();
+                break;
+            }
+        case MaskExpression::TYPE:
+            {
+                const MaskExpression *maskExpr = static_cast<const MaskExpression *>(expr);
+                node.operation = MASK;
+                node.channelMatrix = maskExpr->channelMatrix;
+                operands[0] = maskExpr->image.get();
+                operands[1] = maskExpr->mask.get();
+                break;
+            }
+        case MixMaskExpression::TYPE:
+            {
+                const MixMaskExpression *mixMaskExpr = static_cast<const MixMaskExpression *>(expr);
+                node.operation = MIX_MASK;
+                node.channelMatrix = mixMaskExpr->channelMatrix;
+                operands[0] = mixMaskExpr->dst.get();
+                operands[1] = mixMaskExpr->src.get();
+                operands[2] = mixMaskExpr->mask.get();
+                break;
+            }
+        case MixExpression::TYPE:
+            {
+                const MixExpression *mixExpr = static_cast<const MixExpression *>(expr);
+                node.operation = MIX;
+                node.parameter = mixExpr->ratio;
+                operands[0] = mixExpr->a.get();
+                operands[1] = mixExpr->b.get();
+                break;
+            }
+        case MultiplyAlphaExpression::TYPE:
+            {
+                const MultiplyAlphaExpression *multiplyAlphaExpr = static_cast<const MultiplyAlphaExpression *>(expr);
+                node.operation = MULTIPLY_ALPHA;
+                node.parameter = multiplyAlphaExpr->multiplier;
+                operands[0] = multiplyAlphaExpr->image.get();
+                break;
+            }
+        default:
+            ODE_ASSERT(!"Not a fusible expression");
+            return addInput(expr);
+    }
+    if (node.operation == BLEND || node.operation == BLEND_IGNORE_ALPHA) {
+        blend = true;
+        chainBlendMode = node.blendMode;
+    }
+
+    for (int i = 0; i < n; ++i)
+        node.operands[i] = operands[i] ? addNode(operands[i], reservedInputs+n-1-i, false) : addInput(nullptr);
+    nodeList.push_back(node);
+    return int(nodeList.size()-1);
+}
+
+int CompositingChain::addInput(const Rendexpr *expr) {
+    Node node = { };
+    node.operation = INPUT;
+    node.operands[0] = int(inputList.size());
+    inputList.push_back(expr);
+    nodeList.push_back(node);
+    return int(nodeList.size()-1);
+}
+
+}
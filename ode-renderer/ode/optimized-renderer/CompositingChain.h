@@ -0,0 +1,71 @@
+
+#pragma once
+
+#include <string>
+#include <functional>
+#include <vector>
+#include <octopus/octopus.h>
+#include <ode-logic.h>
+
+namespace ode {
+
+/// A tree of per-pixel compositing operations (blend, mask, mix, alpha multiplication) which can be evaluated by a single fused shader pass
+class CompositingChain {
+
+public:
+    /// Maximum number of input images of a chain (each one occupies a texture unit)
+    static constexpr int MAX_INPUTS = 8;
+
+    enum Operation {
+        INPUT,
+        BLEND,
+        BLEND_IGNORE_ALPHA,
+        MASK,
+        MIX_MASK,
+        MIX,
+        MULTIPLY_ALPHA
+    };
+
+    struct Node {
+        Operation operation;
+        /// Indices of operand nodes, for INPUT nodes operands[0] is the index of the input image
+        int operands[3];
+        octopus::BlendMode blendMode;
+        ChannelMatrix channelMatrix;
+        /// Mix ratio or alpha multiplier, for BLEND_IGNORE_ALPHA the degree to which the source alpha is ignored
+        double parameter;
+    };
+
+    /// Identifies fusible operations which must nevertheless be evaluated separately
+    typedef std::function<bool(const Rendexpr *)> Exclusion;
+
+    /// Returns true if expression type is one of the operations that can be fused
+    static bool isFusible(const Rendexpr *expr);
+
+    /// Collects the chain of fusible operations rooted at root - returns false if there are less than two, excluded operations become inputs
+    bool build(const Rendexpr *root, const Exclusion &exclusion = Exclusion());
+    /// Operation nodes in post-order (root is last)
+    const std::vector<Node> &nodes() const;
+    /// Expressions that produce the input images of the chain (may contain null)
+    const std::vector<const Rendexpr *> &inputs() const;
+    /// Identifies the structure of the chain - chains with equal signatures are evaluated by the same shader program
+    const std::string &signature() const;
+    /// Returns true if the chain contains a blend operation - all blend operations of a chain share the same blend mode
+    bool hasBlend() const;
+    octopus::BlendMode blendMode() const;
+
+private:
+    std::vector<Node> nodeList;
+    std::vector<const Rendexpr *> inputList;
+    std::string sig;
+    bool blend = false;
+    octopus::BlendMode chainBlendMode = octopus::BlendMode::NORMAL;
+    const Exclusion *exclusion = nullptr;
+
+    bool canInline(const Rendexpr *expr, int reservedInputs) const;
+    int addNode(const Rendexpr *expr, int reservedInputs, bool root);
+    int addInput(const Rendexpr *expr);
+
+};
+
+}
@@ -0,0 +1,37 @@
+
+#include "EffectCache.h"
+
+#include <tuple>
+
+namespace ode {
+
+bool EffectCache::Key::operator<(const Key &other) const {
+    return (
+        std::tie(componentId, revision, layerId, contentSerial, effectIndex, scale, linearTransform[0], linearTransform[1], linearTransform[2], linearTransform[3], subpixelTranslation.x, subpixelTranslation.y, quality, detailThreshold) <
+        std::tie(other.componentId, other.revision, other.layerId, other.contentSerial, other.effectIndex, other.scale, other.linearTransform[0], other.linearTransform[1], other.linearTransform[2], other.linearTransform[3], other.subpixelTranslation.x, other.subpixelTranslation.y, other.quality, other.detailThreshold)
+    );
+}
+
+EffectCache::EffectCache(TextureFrameBufferManager &tfbManager) : results(tfbManager) { }
+
+PlacedImagePtr EffectCache::find(const Key &key, const Vector2d &translation) {
+    PlacedImagePtr result;
+    results.find(key, translation, result);
+    return result;
+}
+
+void EffectCache::store(const Key &key, const Vector2d &translation, const PlacedImagePtr &result) {
+    if (!result)
+        return;
+    // Only the most recent result of each layer effect is kept
+    results.eraseIf([&key](const Key &other) {
+        return other.componentId == key.componentId && other.layerId == key.layerId && other.effectIndex == key.effectIndex;
+    });
+    results.store(key, translation, result);
+}
+
+void EffectCache::clear() {
+    results.clear();
+}
+
+}
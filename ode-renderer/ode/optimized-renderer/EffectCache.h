@@ -0,0 +1,51 @@
+
+#pragma once
+
+#include <string>
+#include <ode-essentials.h>
+#include <ode-logic.h>
+#include "../image/Image.h"
+#include "../frame-buffer-management/TextureFrameBufferManager.h"
+#include "EffectRenderer.h"
+#include "RetainedResultCache.h"
+
+namespace ode {
+
+/// Retains results of layer effects across renders, so that effects of layers which are only moved or faded are not recomputed
+class EffectCache {
+
+public:
+    /// Identifies the content of an effect's basis and the effect's parameters
+    struct Key {
+        /// Unique identifier of the component - see Component::uniqueId
+        unsigned long long componentId;
+        /// Component revision - modifications of the composition or hierarchy invalidate the key
+        int revision;
+        std::string layerId;
+        /// Damage serial of the last modification of the layer's own content, which includes its shape and effects
+        int contentSerial;
+        int effectIndex;
+        double scale;
+        /// Linear part of the layer's transformation (including render scale)
+        double linearTransform[4];
+        /// Fractional part of the layer's translation - zero for effects whose result may be resampled at a subpixel offset
+        Vector2d subpixelTranslation;
+        EffectQuality quality;
+        /// The renderer's detail threshold, below which the layers of the effect's basis are approximated
+        double detailThreshold;
+
+        bool operator<(const Key &other) const;
+    };
+
+    explicit EffectCache(TextureFrameBufferManager &tfbManager);
+    /// Returns the result stored for key, moved by the difference between translation and the translation it was stored with, or null
+    PlacedImagePtr find(const Key &key, const Vector2d &translation);
+    void store(const Key &key, const Vector2d &translation, const PlacedImagePtr &result);
+    void clear();
+
+private:
+    RetainedResultCache<Key> results;
+
+};
+
+}
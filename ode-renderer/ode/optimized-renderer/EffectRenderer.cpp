@@ -1,12 +1,99 @@
 
 #include "EffectRenderer.h"
 
+#include <cmath>
 #include <algorithm>
 #include <ode/core/effect-margin.h>
 
 namespace ode {
 
-EffectRenderer::ShaderManager::ShaderManager() : shaderRes(EffectShader::prepare()) { }
+// Blurs whose standard deviation (in pixels) is at least twice this value are computed at reduced resolution, where it is no less than this value
+static constexpr double REDUCED_BLUR_MIN_SIGMA = 8;
+
+// Shader precision and the minimum reduced standard deviation of blurs of each quality level - lower quality trades accuracy for fewer samples and texels
+static constexpr int QUALITY_SHADER_PRECISION[] = { EFFECT_SHADER_PRECISION, EFFECT_SHADER_PRECISION/2, EFFECT_SHADER_PRECISION/4 };
+static constexpr double QUALITY_REDUCED_BLUR_MIN_SIGMA[] = { REDUCED_BLUR_MIN_SIGMA, REDUCED_BLUR_MIN_SIGMA/2, REDUCED_BLUR_MIN_SIGMA/4 };
+
+// Below this extent (in pixels), effects are not drawn in draft quality
+static constexpr double DRAFT_MIN_EFFECT_EXTENT = .5;
+
+static bool isBlurEffect(const octopus::Effect &effect) {
+    return effect.type == octopus::Effect::Type::GAUSSIAN_BLUR || effect.type == octopus::Effect::Type::BLUR || effect.type == octopus::Effect::Type::BOUNDED_BLUR;
+}
+
+static double shadowExtent(const octopus::Shadow &shadow) {
+    return std::max(std::max(fabs(shadow.offset.x), fabs(shadow.offset.y)), std::max(fabs(shadow.blur), fabs(shadow.choke)));
+}
+
+// Returns true if the effect's extent in pixels is too small to be noticeable in draft quality
+static bool isSubpixelEffect(const octopus::Effect &effect, double scale) {
+    double extent = DRAFT_MIN_EFFECT_EXTENT;
+    switch (effect.type) {
+        case octopus::Effect::Type::STROKE:
+            if (effect.stroke.has_value())
+                extent = effect.stroke->thickness;
+            break;
+        case octopus::Effect::Type::DROP_SHADOW:
+        case octopus::Effect::Type::INNER_SHADOW:
+            if (effect.shadow.has_value())
+                extent = shadowExtent(effect.shadow.value());
+            break;
+        case octopus::Effect::Type::OUTER_GLOW:
+        case octopus::Effect::Type::INNER_GLOW:
+            if (effect.glow.has_value())
+                extent = shadowExtent(effect.glow.value());
+            break;
+        case octopus::Effect::Type::GAUSSIAN_BLUR:
+        case octopus::Effect::Type::BLUR:
+        case octopus::Effect::Type::BOUNDED_BLUR:
+            if (effect.blur.has_value())
+                extent = fabs(effect.blur.value());
+            break;
+        default:
+            return false;
+    }
+    return scale*extent < DRAFT_MIN_EFFECT_EXTENT;
+}
+
+// Power of two by which the resolution of a blur with standard deviation sigma is reduced
+static int blurReduction(double sigma, double minSigma) {
+    int reduction = 1;
+    while (sigma >= 2*minSigma*reduction)
+        reduction *= 2;
+    return reduction;
+}
+
+// Variance (per axis, in squared pixels) added by the successive 2x2 box reductions and the final bilinear magnification.
+// It is subtracted from the blur's variance - since reduction is at most sigma/minSigma, it never exceeds 0.4 % of it in final quality.
+// Simulated on the CPU for one axis (reductions, exact Gaussian at the corrected sigma, magnification) against the exact full resolution Gaussian,
+// the maximum error for edges, lines and thin bars at every subpixel phase is below 0.6/255 for sigma from 16 to 300 in final quality
+static double resamplingVariance(int reduction) {
+    double reductionSq = double(reduction)*double(reduction);
+    return (reductionSq-1)/12+reductionSq/6;
+}
+
+EffectRenderer::ShaderManager::ShaderManager(int precision) : shaderRes(EffectShader::prepare()), shaderPrecision(precision) { }
+
+int EffectRenderer::ShaderManager::precision() const {
+    return shaderPrecision;
+}
+
+bool EffectRenderer::ShaderManager::warmUp() {
+    bool ok = true;
+    for (char channel : { '\0', 'a', 'r' })
+        ok &= getBoundedBlurShader(channel) != nullptr;
+    for (char channel : { '\0', 'r' })
+        ok &= getGaussianBlurShader(channel) != nullptr;
+    for (char channel : { 'a', 'r' }) {
+        ok &= getDistanceTransformShader(channel) != nullptr;
+        ok &= getJumpFloodSeedShader(channel) != nullptr;
+    }
+    ok &= getDistanceThresholdShader() != nullptr;
+    ok &= getJumpFloodStepShader() != nullptr;
+    ok &= getJumpFloodThresholdShader() != nullptr;
+    ok &= getRectangleShadowShader() != nullptr;
+    return ok;
+}
 
 BoundedBlurShader *EffectRenderer::ShaderManager::getBoundedBlurShader(char channel) {
     BoundedBlurShader *shader = nullptr;
@@ -23,14 +110,25 @@ BoundedBlurShader *EffectRenderer::ShaderManager::getBoundedBlurShader(char chan
         default:
             ODE_ASSERT(!"Shader for this channel is missing");
     }
-    if (shader && (shader->ready() || shader->initialize(shaderRes, channel, EFFECT_SHADER_PRECISION)))
+    if (shader && (shader->ready() || shader->initialize(shaderRes, channel, shaderPrecision)))
         return shader;
     return nullptr;
 }
 
-GaussianBlurShader *EffectRenderer::ShaderManager::getGaussianBlurShader() {
-    if (gaussianBlurShader.ready() || gaussianBlurShader.initialize(shaderRes, '\0', EFFECT_SHADER_PRECISION))
-        return &gaussianBlurShader;
+GaussianBlurShader *EffectRenderer::ShaderManager::getGaussianBlurShader(char channel) {
+    GaussianBlurShader *shader = nullptr;
+    switch (channel) {
+        case '\0':
+            shader = &gaussianBlurShaders[0];
+            break;
+        case 'r':
+            shader = &gaussianBlurShaders[1];
+            break;
+        default:
+            ODE_ASSERT(!"Shader for this channel is missing");
+    }
+    if (shader && (shader->ready() || shader->initialize(shaderRes, channel, shaderPrecision)))
+        return shader;
     return nullptr;
 }
 
@@ -46,20 +144,86 @@ DistanceTransformShader *EffectRenderer::ShaderManager::getDistanceTransformShad
         default:
             ODE_ASSERT(!"Shader for this channel is missing");
     }
-    if (shader && (shader->ready() || shader->initialize(shaderRes, channel, EFFECT_SHADER_PRECISION)))
+    if (shader && (shader->ready() || shader->initialize(shaderRes, channel, shaderPrecision)))
         return shader;
     return nullptr;
 }
 
 DistanceThresholdShader *EffectRenderer::ShaderManager::getDistanceThresholdShader() {
-    if (distanceThresholdShader.ready() || distanceThresholdShader.initialize(shaderRes, EFFECT_SHADER_PRECISION))
+    if (distanceThresholdShader.ready() || distanceThresholdShader.initialize(shaderRes, shaderPrecision))
         return &distanceThresholdShader;
     return nullptr;
 }
 
-EffectRenderer::EffectRenderer(GraphicsContext &gc, TextureFrameBufferManager &tfbManager, Mesh &billboard, BlitShader &blitShader) : gc(gc), tfbManager(tfbManager), billboard(billboard), blitShader(blitShader) { }
+JumpFloodSeedShader *EffectRenderer::ShaderManager::getJumpFloodSeedShader(char channel) {
+    JumpFloodSeedShader *shader = nullptr;
+    switch (channel) {
+        case 'a':
+            shader = &jumpFloodSeedShaders[0];
+            break;
+        case 'r':
+            shader = &jumpFloodSeedShaders[1];
+            break;
+        default:
+            ODE_ASSERT(!"Shader for this channel is missing");
+    }
+    if (shader && (shader->ready() || shader->initialize(shaderRes, channel)))
+        return shader;
+    return nullptr;
+}
+
+JumpFloodStepShader *EffectRenderer::ShaderManager::getJumpFloodStepShader() {
+    if (jumpFloodStepShader.ready() || jumpFloodStepShader.initialize(shaderRes))
+        return &jumpFloodStepShader;
+    return nullptr;
+}
+
+JumpFloodThresholdShader *EffectRenderer::ShaderManager::getJumpFloodThresholdShader() {
+    if (jumpFloodThresholdShader.ready() || jumpFloodThresholdShader.initialize(shaderRes))
+        return &jumpFloodThresholdShader;
+    return nullptr;
+}
+
+RectangleShadowShader *EffectRenderer::ShaderManager::getRectangleShadowShader() {
+    if (rectangleShadowShader.ready() || rectangleShadowShader.initialize(shaderRes, shaderPrecision))
+        return &rectangleShadowShader;
+    return nullptr;
+}
+
+EffectRenderer::EffectRenderer(GraphicsContext &gc, TextureFrameBufferManager &tfbManager, Mesh &billboard, BlitShader &blitShader, BlitShader &alphaBlitShader, int &savedDistanceFieldPasses) :
+    gc(gc),
+    shaderManagers {
+        ShaderManager(QUALITY_SHADER_PRECISION[int(EffectQuality::FINAL)]),
+        ShaderManager(QUALITY_SHADER_PRECISION[int(EffectQuality::DRAFT)]),
+        ShaderManager(QUALITY_SHADER_PRECISION[int(EffectQuality::PREVIEW)])
+    },
+    shaders(&shaderManagers[int(EffectQuality::FINAL)]),
+    quality(EffectQuality::FINAL),
+    tfbManager(tfbManager),
+    billboard(billboard),
+    blitShader(blitShader),
+    alphaBlitShader(alphaBlitShader),
+    savedDistanceFieldPasses(savedDistanceFieldPasses)
+{ }
+
+void EffectRenderer::setQuality(EffectQuality quality) {
+    if (quality != this->quality) {
+        this->quality = quality;
+        shaders = &shaderManagers[int(quality)];
+    }
+}
+
+EffectQuality EffectRenderer::getQuality() const {
+    return quality;
+}
+
+bool EffectRenderer::warmUp() {
+    return shaders->warmUp();
+}
 
 PlacedImagePtr EffectRenderer::drawEffect(const octopus::Effect &effect, const PlacedImagePtr &basis, double scale) {
+    if (quality != EffectQuality::FINAL && isSubpixelEffect(effect, scale))
+        return isBlurEffect(effect) ? basis : nullptr;
     switch (effect.type) {
         case octopus::Effect::Type::OVERLAY:
             ODE_ASSERT(!"Should be handled by caller");
@@ -94,6 +258,29 @@ PlacedImagePtr EffectRenderer::drawEffect(const octopus::Effect &effect, const P
     return nullptr;
 }
 
+PlacedImagePtr EffectRenderer::drawRectangleEffect(const octopus::Effect &effect, const PlacedImagePtr &basis, const ScaledBounds &rectangle, double cornerRadius, double scale) {
+    if (quality != EffectQuality::FINAL && isSubpixelEffect(effect, scale))
+        return isBlurEffect(effect) ? basis : nullptr;
+    PlacedImagePtr result;
+    switch (effect.type) {
+        case octopus::Effect::Type::DROP_SHADOW:
+        case octopus::Effect::Type::INNER_SHADOW:
+            if (effect.shadow.has_value())
+                result = drawRectangleShadow(effect.type, effect.shadow.value(), basis, rectangle, cornerRadius, scale);
+            break;
+        case octopus::Effect::Type::OUTER_GLOW:
+        case octopus::Effect::Type::INNER_GLOW:
+            if (effect.glow.has_value())
+                result = drawRectangleShadow(effect.type, effect.glow.value(), basis, rectangle, cornerRadius, scale);
+            break;
+        default:
+            break;
+    }
+    if (result)
+        return result;
+    return drawEffect(effect, basis, scale);
+}
+
 PlacedImagePtr EffectRenderer::drawStroke(const octopus::Stroke &stroke, const PlacedImagePtr &basis, double scale) {
     if (!(stroke.fill.type == octopus::Fill::Type::COLOR && stroke.fill.color.has_value()))
         return nullptr;
@@ -124,7 +311,8 @@ PlacedImagePtr EffectRenderer::drawStroke(const octopus::Stroke &stroke, const P
             upperThreshold = (float) thickness;
             break;
     }
-    return drawDistanceThreshold(minDistance, maxDistance, lowerThreshold, upperThreshold, fromOctopus(stroke.fill.color.value()), basis, basis.bounds()+ScaledMargin(margin));
+    Color color = fromOctopus(stroke.fill.color.value());
+    return drawDistanceThreshold(minDistance, maxDistance, lowerThreshold, upperThreshold, &color, basis, basis.bounds()+ScaledMargin(margin));
 }
 
 PlacedImagePtr EffectRenderer::drawShadow(octopus::Effect::Type type, const octopus::Shadow &shadow, PlacedImagePtr basis, double scale) {
@@ -139,9 +327,12 @@ PlacedImagePtr EffectRenderer::drawShadow(octopus::Effect::Type type, const octo
     double choke = scale*(inner ? -shadow.choke : shadow.choke);
     if (!radius) {
         if (choke) {
-            basis = drawChoke(choke, inner ? Color(1) : fromOctopus(shadow.color), basis);
-            if (!inner)
+            if (!inner) {
+                Color color = fromOctopus(shadow.color);
+                basis = drawChoke(choke, &color, basis);
                 return PlacedImagePtr(basis, basis.bounds()+outOffset);
+            }
+            basis = drawChoke(choke, nullptr, basis);
         }
 
         // Basis to shadow color
@@ -153,9 +344,9 @@ PlacedImagePtr EffectRenderer::drawShadow(octopus::Effect::Type type, const octo
         TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds);
         ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
         outTex->bind();
-        glViewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+        GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
         // Fill outTex with shadow color
-        glClearColor(
+        GLStateCache::clearColor(
             shadow.color.a*shadow.color.r,
             shadow.color.a*shadow.color.g,
             shadow.color.a*shadow.color.b,
@@ -164,7 +355,7 @@ PlacedImagePtr EffectRenderer::drawShadow(octopus::Effect::Type type, const octo
         glClear(GL_COLOR_BUFFER_BIT);
         glEnable(GL_BLEND);
         glBlendFunc(GL_ZERO, inner ? GL_ONE_MINUS_SRC_ALPHA : GL_SRC_ALPHA);
-        blitShader.bind(pixelBounds, actualBounds, basis.bounds()+inOffset);
+        (basis->transparencyMode() == Image::RED_IS_ALPHA ? alphaBlitShader : blitShader).bind(pixelBounds, actualBounds, basis.bounds()+inOffset);
         basisTex->bind(BlitShader::UNIT_IN);
         billboard.draw();
         glDisable(GL_BLEND);
@@ -173,55 +364,96 @@ PlacedImagePtr EffectRenderer::drawShadow(octopus::Effect::Type type, const octo
     }
 
     if (choke)
-        basis = drawChoke(choke, Color(1), basis);
-    BoundedBlurShader *blurShader = shaders.getBoundedBlurShader(basis->transparencyMode() == Image::RED_IS_ALPHA ? 'r' : 'a');
-    if (!blurShader)
+        basis = drawChoke(choke, nullptr, basis);
+    if (!basis)
+        return nullptr;
+    BoundedBlurShader *blurShader = shaders->getBoundedBlurShader(basis->transparencyMode() == Image::RED_IS_ALPHA ? 'r' : 'a');
+    // The intermediate blur is alpha only
+    BoundedBlurShader *alphaBlurShader = shaders->getBoundedBlurShader('r');
+    if (!(blurShader && alphaBlurShader))
         return nullptr;
 
-    TexturePtr basisTex = basis->asTexture();
-    if (!basisTex)
+    // In draft quality, large shadows are computed at reduced resolution like blurs
+    int reduction = quality == EffectQuality::FINAL ? 1 : blurReduction(radius/sqrt(6.), QUALITY_REDUCED_BLUR_MIN_SIGMA[int(quality)]);
+    double reducedRadius = radius;
+    PlacedImagePtr input = basis;
+    if (reduction > 1) {
+        reducedRadius = sqrt(radius*radius-6*resamplingVariance(reduction));
+        if (!(input = reduceResolution(basis, reduction)))
+            return nullptr;
+    }
+    TexturePtr inputTex = input->asTexture();
+    if (!inputTex)
         return nullptr;
     ScaledBounds bounds = inner ? inputBounds : basis.bounds()+ScaledMargin(radius);
     PixelBounds intermediatePixelBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr intermediateTex = tfbManager.acquire(intermediatePixelBounds);
+    TextureFrameBufferPtr intermediateTex = acquireReduced(intermediatePixelBounds, reduction, TextureFrameBufferManager::alphaOnlyFormat());
     intermediateTex->bind();
-    glViewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
-    blurShader->bind(intermediatePixelBounds, bounds, basis.bounds()+inOffset, false, radius, Color(1));
-    basisTex->bind(BoundedBlurShader::UNIT_BASIS);
+    blurShader->bind(intermediatePixelBounds, bounds, input.bounds()+inOffset, false, reducedRadius, Color(1));
+    inputTex->bind(BoundedBlurShader::UNIT_BASIS);
     billboard.draw();
     intermediateTex->unbind();
     ScaledBounds intermediateActualBounds(Vector2d(intermediatePixelBounds.a), Vector2d(intermediatePixelBounds.b)); // TODO proper conversion
 
     PixelBounds pixelBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds);
+    TextureFrameBufferPtr outTex = acquireReduced(pixelBounds, reduction, PixelFormat::PREMULTIPLIED_RGBA);
     outTex->bind();
-    glViewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
-    glClear(GL_COLOR_BUFFER_BIT);
-    blurShader->bind(pixelBounds, bounds, intermediateActualBounds, true, radius, inner ? Color(1) : fromOctopus(shadow.color));
-    intermediateTex->bind(BoundedBlurShader::UNIT_BASIS);
-    billboard.draw();
-    outTex->unbind();
-    ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
-
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
     if (inner) {
-        intermediateTex->bind();
-        glViewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
-        glClearColor(GLclampf(shadow.color.r*shadow.color.a), GLclampf(shadow.color.g*shadow.color.a), GLclampf(shadow.color.b*shadow.color.a), GLclampf(shadow.color.a));
+        // Inner shadow is the shadow color outside of the blurred basis - subtracted directly by blending
+        GLStateCache::clearColor(GLclampf(shadow.color.r*shadow.color.a), GLclampf(shadow.color.g*shadow.color.a), GLclampf(shadow.color.b*shadow.color.a), GLclampf(shadow.color.a));
         glClear(GL_COLOR_BUFFER_BIT);
         glEnable(GL_BLEND);
         glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
-        blitShader.bind(intermediatePixelBounds, actualBounds, actualBounds);
-        outTex->bind(BlitShader::UNIT_IN);
-        billboard.draw();
+    } else
+        glClear(GL_COLOR_BUFFER_BIT);
+    alphaBlurShader->bind(pixelBounds, bounds, intermediateActualBounds, true, reducedRadius, inner ? Color(1) : fromOctopus(shadow.color));
+    intermediateTex->bind(BoundedBlurShader::UNIT_BASIS);
+    billboard.draw();
+    if (inner)
         glDisable(GL_BLEND);
-        outTex->unbind();
-        outTex = (TextureFrameBufferPtr &&) intermediateTex;
-        actualBounds = intermediateActualBounds;
-    }
+    outTex->unbind();
+    ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
-    return PlacedImagePtr(Image::fromTexture(outTex, basis->transparencyMode() == Image::RED_IS_ALPHA ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), actualBounds+outOffset);
+    PlacedImagePtr result(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
+    if (reduction > 1 && !(result = restoreResolution(result, bounds)))
+        return nullptr;
+    return PlacedImagePtr(result, result.bounds()+outOffset);
+}
+
+PlacedImagePtr EffectRenderer::drawRectangleShadow(octopus::Effect::Type type, const octopus::Shadow &shadow, const PlacedImagePtr &basis, const ScaledBounds &rectangle, double cornerRadius, double scale) {
+    if (!basis)
+        return nullptr;
+    bool inner = type == octopus::Effect::Type::INNER_SHADOW || type == octopus::Effect::Type::INNER_GLOW;
+    Vector2d offset = scale*fromOctopus(shadow.offset);
+    double radius = fabs(scale*shadow.blur);
+    double choke = scale*(inner ? -shadow.choke : shadow.choke);
+    // Below one pixel, the blur is dominated by the rasterization of the basis
+    if (radius < 1)
+        return nullptr;
+    // Choke offsets the rectangle's outline, including its corners
+    ScaledBounds chokedRectangle = rectangle+ScaledMargin(choke);
+    if (!chokedRectangle)
+        return nullptr;
+    RectangleShadowShader *shader = shaders->getRectangleShadowShader();
+    if (!shader)
+        return nullptr;
+
+    ScaledBounds bounds = inner ? basis.bounds() : chokedRectangle+ScaledMargin(radius)+offset;
+    PixelBounds pixelBounds = outerPixelBounds(bounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds);
+    outTex->bind();
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    shader->bind(pixelBounds, bounds, chokedRectangle+offset, std::max(cornerRadius+choke, 0.), radius, inner, fromOctopus(shadow.color));
+    billboard.draw();
+    outTex->unbind();
+    ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
+    return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
 }
 
 PlacedImagePtr EffectRenderer::drawBoundedBlur(double blur, const PlacedImagePtr &basis) {
@@ -229,39 +461,53 @@ PlacedImagePtr EffectRenderer::drawBoundedBlur(double blur, const PlacedImagePtr
         return basis;
     if (!basis)
         return nullptr;
-    ODE_ASSERT(basis->transparencyMode() == Image::PREMULTIPLIED || basis->transparencyMode() == Image::NO_TRANSPARENCY);
-    BoundedBlurShader *blurShader = shaders.getBoundedBlurShader();
+    bool alphaOnly = basis->transparencyMode() == Image::RED_IS_ALPHA;
+    ODE_ASSERT(alphaOnly || basis->transparencyMode() == Image::PREMULTIPLIED || basis->transparencyMode() == Image::NO_TRANSPARENCY);
+    BoundedBlurShader *blurShader = shaders->getBoundedBlurShader(alphaOnly ? 'r' : '\0');
+    PixelFormat format = alphaOnly ? TextureFrameBufferManager::alphaOnlyFormat() : PixelFormat::PREMULTIPLIED_RGBA;
     if (!blurShader)
         return nullptr;
 
-    TexturePtr basisTex = basis->asTexture();
-    if (!basisTex)
-        return nullptr;
     ScaledBounds bounds = basis.bounds()+ScaledMargin(blur);
+    // The kernel of each pass is triangular with variance blur^2/6
+    int reduction = blurReduction(blur/sqrt(6.), QUALITY_REDUCED_BLUR_MIN_SIGMA[int(quality)]);
+    double radius = blur;
+    PlacedImagePtr input = basis;
+    if (reduction > 1) {
+        radius = sqrt(blur*blur-6*resamplingVariance(reduction));
+        if (!(input = reduceResolution(basis, reduction)))
+            return nullptr;
+    }
+    TexturePtr inputTex = input->asTexture();
+    if (!inputTex)
+        return nullptr;
     PixelBounds pixelBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr intermediateTex = tfbManager.acquire(pixelBounds);
+    TextureFrameBufferPtr intermediateTex = acquireReduced(pixelBounds, reduction, format);
     intermediateTex->bind();
-    glViewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
-    blurShader->bind(pixelBounds, bounds, basis.bounds(), false, blur, Color(1));
-    basisTex->bind(BoundedBlurShader::UNIT_BASIS);
+    blurShader->bind(pixelBounds, bounds, input.bounds(), false, radius, Color(1));
+    inputTex->bind(BoundedBlurShader::UNIT_BASIS);
     billboard.draw();
     intermediateTex->unbind();
     ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
     pixelBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds);
+    TextureFrameBufferPtr outTex = acquireReduced(pixelBounds, reduction, format);
     outTex->bind();
-    glViewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
     glClear(GL_COLOR_BUFFER_BIT);
-    blurShader->bind(pixelBounds, bounds, actualBounds, true, blur, Color(1));
+    blurShader->bind(pixelBounds, bounds, actualBounds, true, radius, Color(1));
     intermediateTex->bind(BoundedBlurShader::UNIT_BASIS);
     billboard.draw();
     outTex->unbind();
     actualBounds = ScaledBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
-    return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
+    PlacedImagePtr result = alphaOnly ? PlacedImagePtr(Image::fromAlphaTexture(outTex), actualBounds) : PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
+    if (reduction > 1)
+        return restoreResolution(result, bounds);
+    return result;
 }
 
 PlacedImagePtr EffectRenderer::drawGaussianBlur(double blur, const PlacedImagePtr &basis) {
@@ -269,42 +515,111 @@ PlacedImagePtr EffectRenderer::drawGaussianBlur(double blur, const PlacedImagePt
         return basis;
     if (!basis)
         return nullptr;
-    ODE_ASSERT(basis->transparencyMode() == Image::PREMULTIPLIED || basis->transparencyMode() == Image::NO_TRANSPARENCY);
-    GaussianBlurShader *blurShader = shaders.getGaussianBlurShader();
+    bool alphaOnly = basis->transparencyMode() == Image::RED_IS_ALPHA;
+    ODE_ASSERT(alphaOnly || basis->transparencyMode() == Image::PREMULTIPLIED || basis->transparencyMode() == Image::NO_TRANSPARENCY);
+    GaussianBlurShader *blurShader = shaders->getGaussianBlurShader(alphaOnly ? 'r' : '\0');
+    PixelFormat format = alphaOnly ? TextureFrameBufferManager::alphaOnlyFormat() : PixelFormat::PREMULTIPLIED_RGBA;
     if (!blurShader)
         return nullptr;
 
-    TexturePtr basisTex = basis->asTexture();
-    if (!basisTex)
-        return nullptr;
     ScaledBounds bounds = basis.bounds()+ScaledMargin(GAUSSIAN_BLUR_RANGE_FACTOR*blur);
+    // Large blurs are computed at reduced resolution, where the fixed number of samples is sufficiently dense
+    int reduction = blurReduction(blur, QUALITY_REDUCED_BLUR_MIN_SIGMA[int(quality)]);
+    double sigma = blur;
+    PlacedImagePtr input = basis;
+    if (reduction > 1) {
+        sigma = sqrt(blur*blur-resamplingVariance(reduction));
+        if (!(input = reduceResolution(basis, reduction)))
+            return nullptr;
+    }
+    TexturePtr inputTex = input->asTexture();
+    if (!inputTex)
+        return nullptr;
     PixelBounds pixelBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr intermediateTex = tfbManager.acquire(pixelBounds);
+    TextureFrameBufferPtr intermediateTex = acquireReduced(pixelBounds, reduction, format);
     intermediateTex->bind();
-    glViewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
-    blurShader->bind(pixelBounds, bounds, basis.bounds(), false, blur, Color(1));
-    basisTex->bind(GaussianBlurShader::UNIT_BASIS);
+    blurShader->bind(pixelBounds, bounds, input.bounds(), false, sigma, Color(1));
+    inputTex->bind(GaussianBlurShader::UNIT_BASIS);
     billboard.draw();
     intermediateTex->unbind();
     ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
     pixelBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds);
+    TextureFrameBufferPtr outTex = acquireReduced(pixelBounds, reduction, format);
     outTex->bind();
-    glViewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
     glClear(GL_COLOR_BUFFER_BIT);
-    blurShader->bind(pixelBounds, bounds, actualBounds, true, blur, Color(1));
+    blurShader->bind(pixelBounds, bounds, actualBounds, true, sigma, Color(1));
     intermediateTex->bind(GaussianBlurShader::UNIT_BASIS);
     billboard.draw();
     outTex->unbind();
     actualBounds = ScaledBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
+    PlacedImagePtr result = alphaOnly ? PlacedImagePtr(Image::fromAlphaTexture(outTex), actualBounds) : PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
+    if (reduction > 1)
+        return restoreResolution(result, bounds);
+    return result;
+}
+
+TextureFrameBufferPtr EffectRenderer::acquireReduced(PixelBounds &bounds, int reduction, PixelFormat format) {
+    ODE_ASSERT(reduction > 0);
+    if (reduction == 1)
+        return tfbManager.acquire(bounds, format);
+    PixelBounds reducedBounds(Vector2i(), (bounds.dimensions()+Vector2i(reduction-1, reduction-1))/reduction);
+    TextureFrameBufferPtr result = tfbManager.acquire(reducedBounds, format);
+    bounds.b = bounds.a+reduction*reducedBounds.dimensions();
+    return result;
+}
+
+PlacedImagePtr EffectRenderer::reduceResolution(const PlacedImagePtr &image, int reduction) {
+    PlacedImagePtr result = image;
+    for (int level = 2; level <= reduction; level *= 2) {
+        // Texels of consecutive levels are aligned, so a single bilinear sample at the center of each averages 2x2 texels of the previous level
+        bool alphaOnly = result->transparencyMode() == Image::RED_IS_ALPHA;
+        TexturePtr inputTex = result->asTexture();
+        if (!inputTex)
+            return nullptr;
+        PixelBounds pixelBounds = outerPixelBounds(image.bounds());
+        TextureFrameBufferPtr outTex = acquireReduced(pixelBounds, level, alphaOnly ? TextureFrameBufferManager::alphaOnlyFormat() : PixelFormat::PREMULTIPLIED_RGBA);
+        outTex->bind();
+        GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+        GLStateCache::clearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        (alphaOnly ? alphaBlitShader : blitShader).bind(pixelBounds, image.bounds(), result.bounds());
+        inputTex->bind(BlitShader::UNIT_IN);
+        billboard.draw();
+        outTex->unbind();
+        ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
+        result = PlacedImagePtr(alphaOnly ? Image::fromAlphaTexture(outTex) : Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
+    }
+    return result;
+}
+
+PlacedImagePtr EffectRenderer::restoreResolution(const PlacedImagePtr &image, const ScaledBounds &bounds) {
+    bool alphaOnly = image->transparencyMode() == Image::RED_IS_ALPHA;
+    TexturePtr inputTex = image->asTexture();
+    if (!inputTex)
+        return nullptr;
+    PixelBounds pixelBounds = outerPixelBounds(bounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds, alphaOnly ? TextureFrameBufferManager::alphaOnlyFormat() : PixelFormat::PREMULTIPLIED_RGBA);
+    outTex->bind();
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    (alphaOnly ? alphaBlitShader : blitShader).bind(pixelBounds, bounds, image.bounds());
+    inputTex->bind(BlitShader::UNIT_IN);
+    billboard.draw();
+    outTex->unbind();
+    ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
+    if (alphaOnly)
+        return PlacedImagePtr(Image::fromAlphaTexture(outTex), actualBounds);
     return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
 }
 
-PlacedImagePtr EffectRenderer::drawChoke(double choke, const Color &color, const PlacedImagePtr &basis) {
+PlacedImagePtr EffectRenderer::drawChoke(double choke, const Color *color, const PlacedImagePtr &basis) {
     ScaledBounds bounds = basis.bounds()+ScaledMargin(choke+1.01);
     if (!bounds)
         return nullptr;
@@ -313,44 +628,167 @@ PlacedImagePtr EffectRenderer::drawChoke(double choke, const Color &color, const
     return drawDistanceThreshold(minDistance, maxDistance, float(-choke), maxDistance+1.f, color, basis, bounds);
 }
 
-PlacedImagePtr EffectRenderer::drawDistanceThreshold(float minDistance, float maxDistance, float lowerThreshold, float upperThreshold, const Color &color, const PlacedImagePtr &basis, const ScaledBounds &outputBounds) {
+PlacedImagePtr EffectRenderer::drawDistanceThreshold(float minDistance, float maxDistance, float lowerThreshold, float upperThreshold, const Color *color, const PlacedImagePtr &basis, const ScaledBounds &outputBounds) {
     if (!(basis && outputBounds))
         return nullptr;
-    DistanceTransformShader *distanceTransformShader = shaders.getDistanceTransformShader(basis->transparencyMode() == Image::RED_IS_ALPHA ? 'r' : 'a');
-    DistanceThresholdShader *distanceThresholdShader = shaders.getDistanceThresholdShader();
+    // Up to the shader precision (in pixels), the separable distance shader samples every pixel and is exact, beyond it its fixed number of samples becomes sparse
+    if (std::max(-minDistance, maxDistance) > float(shaders->precision()))
+        return drawJumpFloodThreshold(std::max(-minDistance, maxDistance), lowerThreshold, upperThreshold, color, basis, outputBounds);
+    char channel = basis->transparencyMode() == Image::RED_IS_ALPHA ? 'r' : 'a';
+    DistanceTransformShader *distanceTransformShader = shaders->getDistanceTransformShader(channel);
+    DistanceThresholdShader *distanceThresholdShader = shaders->getDistanceThresholdShader();
     if (!(distanceTransformShader && distanceThresholdShader))
         return nullptr;
 
-    TexturePtr basisTex = basis->asTexture();
-    if (!basisTex)
-        return nullptr;
     ScaledBounds intermediateBounds = basis.bounds();
     intermediateBounds.a.x = outputBounds.a.x;
     intermediateBounds.b.x = outputBounds.b.x;
     PixelBounds pixelBounds = outerPixelBounds(intermediateBounds);
-    TextureFrameBufferPtr intermediateTex = tfbManager.acquire(pixelBounds);
-    intermediateTex->bind();
-    glViewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
-    glClearColor(0, 0, 0, 0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    distanceTransformShader->bind(pixelBounds, intermediateBounds, basis.bounds(), Vector2f(1.f, 0.f), minDistance, maxDistance);
-    basisTex->bind(DistanceTransformShader::UNIT_BASIS);
-    billboard.draw();
-    intermediateTex->unbind();
+    DistanceFieldKey key = { basis, channel, false, shaders->precision(), minDistance, maxDistance };
+    TextureFrameBufferPtr intermediateTex = findDistanceField(key, pixelBounds);
+    if (!intermediateTex) {
+        TexturePtr basisTex = basis->asTexture();
+        if (!basisTex)
+            return nullptr;
+        // The linear distance transform is encoded in the red channel only
+        intermediateTex = tfbManager.acquire(pixelBounds, TextureFrameBufferManager::alphaOnlyFormat());
+        intermediateTex->bind();
+        GLStateCache::viewport(0, 0, intermediateTex->dimensions().x, intermediateTex->dimensions().y);
+        GLStateCache::clearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        distanceTransformShader->bind(pixelBounds, intermediateBounds, basis.bounds(), Vector2f(1.f, 0.f), minDistance, maxDistance);
+        basisTex->bind(DistanceTransformShader::UNIT_BASIS);
+        billboard.draw();
+        intermediateTex->unbind();
+        storeDistanceField(key, intermediateTex, pixelBounds, 1);
+    }
     ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
     pixelBounds = outerPixelBounds(outputBounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds, color ? PixelFormat::PREMULTIPLIED_RGBA : TextureFrameBufferManager::alphaOnlyFormat());
     outTex->bind();
-    glViewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
-    distanceThresholdShader->bind(pixelBounds, outputBounds, actualBounds, Vector2f(0.f, 1.f), minDistance, maxDistance, lowerThreshold, upperThreshold, color);
+    distanceThresholdShader->bind(pixelBounds, outputBounds, actualBounds, Vector2f(0.f, 1.f), minDistance, maxDistance, lowerThreshold, upperThreshold, color ? *color : Color(1));
     intermediateTex->bind(DistanceThresholdShader::UNIT_BASIS);
     billboard.draw();
     outTex->unbind();
     actualBounds = ScaledBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
 
+    if (!color)
+        return PlacedImagePtr(Image::fromAlphaTexture(outTex), actualBounds);
+    return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
+}
+
+PlacedImagePtr EffectRenderer::drawJumpFloodThreshold(float maxDistance, float lowerThreshold, float upperThreshold, const Color *color, const PlacedImagePtr &basis, const ScaledBounds &outputBounds) {
+    if (!(basis && outputBounds))
+        return nullptr;
+    char channel = basis->transparencyMode() == Image::RED_IS_ALPHA ? 'r' : 'a';
+    JumpFloodSeedShader *seedShader = shaders->getJumpFloodSeedShader(channel);
+    JumpFloodStepShader *stepShader = shaders->getJumpFloodStepShader();
+    JumpFloodThresholdShader *thresholdShader = shaders->getJumpFloodThresholdShader();
+    if (!(seedShader && stepShader && thresholdShader))
+        return nullptr;
+
+    // Jumps halve from the largest power of two within reach down to 1, followed by one more jump of 1 which corrects most remaining errors.
+    // The result only depends on the initial jump, which therefore identifies the distance field
+    int reach = int(std::ceil(maxDistance))+1;
+    int initialJump = 1;
+    while (2*initialJump <= reach)
+        initialJump *= 2;
+    PixelBounds floodBounds = outerPixelBounds(outputBounds|basis.bounds());
+    DistanceFieldKey key = { basis, channel, true, 0, float(-initialJump), float(initialJump) };
+    TextureFrameBufferPtr floodTex = findDistanceField(key, floodBounds);
+    if (!floodTex) {
+        TexturePtr basisTex = basis->asTexture();
+        if (!basisTex)
+            return nullptr;
+        // Seed records are encoded in all four channels of raw data framebuffers - intermediate passes sample exact texel centers so linear filtering has no effect
+        floodTex = tfbManager.acquire(floodBounds, TextureFrameBufferManager::rawDataFormat());
+        ScaledBounds actualBounds(Vector2d(floodBounds.a), Vector2d(floodBounds.b)); // TODO proper conversion
+        floodTex->bind();
+        GLStateCache::viewport(0, 0, floodTex->dimensions().x, floodTex->dimensions().y);
+        GLStateCache::clearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT);
+        seedShader->bind(floodBounds, actualBounds, basis.bounds());
+        basisTex->bind(JumpFloodSeedShader::UNIT_BASIS);
+        billboard.draw();
+        floodTex->unbind();
+        int passes = 1;
+
+        TextureFrameBufferPtr swapTex = tfbManager.acquireExact(floodBounds, TextureFrameBufferManager::rawDataFormat());
+        bool finalPass = false;
+        for (int jump = initialJump; jump > 0; ++passes) {
+            swapTex->bind();
+            stepShader->bind(floodBounds, jump);
+            floodTex->bind(JumpFloodStepShader::UNIT_BASIS);
+            billboard.draw();
+            swapTex->unbind();
+            std::swap(floodTex, swapTex);
+            if (jump > 1)
+                jump /= 2;
+            else if (!finalPass)
+                finalPass = true;
+            else
+                jump = 0;
+        }
+        swapTex.reset();
+        storeDistanceField(key, floodTex, floodBounds, passes);
+    }
+
+    PixelBounds pixelBounds = outerPixelBounds(outputBounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pixelBounds, color ? PixelFormat::PREMULTIPLIED_RGBA : TextureFrameBufferManager::alphaOnlyFormat());
+    outTex->bind();
+    GLStateCache::viewport(0, 0, outTex->dimensions().x, outTex->dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    thresholdShader->bind(pixelBounds, outputBounds, floodBounds, lowerThreshold, upperThreshold, color ? *color : Color(1));
+    floodTex->bind(JumpFloodThresholdShader::UNIT_BASIS);
+    billboard.draw();
+    outTex->unbind();
+    ScaledBounds actualBounds(Vector2d(pixelBounds.a), Vector2d(pixelBounds.b)); // TODO proper conversion
+
+    if (!color)
+        return PlacedImagePtr(Image::fromAlphaTexture(outTex), actualBounds);
     return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), actualBounds);
 }
 
+TextureFrameBufferPtr EffectRenderer::findDistanceField(const DistanceFieldKey &key, PixelBounds &bounds) {
+    // Distance fields of bases which have been released by the caller can no longer be requested
+    distanceFields.erase(std::remove_if(distanceFields.begin(), distanceFields.end(), [](const DistanceField &field) {
+        return field.basis.expired();
+    }), distanceFields.end());
+    for (const DistanceField &field : distanceFields) {
+        if (
+            field.basis.lock() == key.basis && field.basisBounds == key.basis.bounds() && field.channel == key.channel && field.jumpFlood == key.jumpFlood && field.precision == key.precision &&
+            field.minDistance == key.minDistance && field.maxDistance == key.maxDistance && (field.bounds|bounds) == field.bounds
+        ) {
+            bounds = field.bounds;
+            savedDistanceFieldPasses += field.passes;
+            return field.texture;
+        }
+    }
+    return nullptr;
+}
+
+void EffectRenderer::storeDistanceField(const DistanceFieldKey &key, const TextureFrameBufferPtr &texture, const PixelBounds &bounds, int passes) {
+    DistanceField field;
+    field.basis = key.basis;
+    field.basisBounds = key.basis.bounds();
+    field.channel = key.channel;
+    field.jumpFlood = key.jumpFlood;
+    field.precision = key.precision;
+    field.minDistance = key.minDistance;
+    field.maxDistance = key.maxDistance;
+    field.texture = texture;
+    field.bounds = bounds;
+    field.passes = passes;
+    distanceFields.push_back((DistanceField &&) field);
+}
+
+void EffectRenderer::releaseDistanceFields() {
+    distanceFields.clear();
+}
+
 }
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
 #include <octopus/octopus.h>
 #include <ode-graphics.h>
 #include "../image/Image.h"
@@ -12,40 +14,117 @@
 
 namespace ode {
 
+/// Trade-off between the fidelity and the cost of effects
+enum class EffectQuality {
+    /// Full precision, used for export
+    FINAL,
+    /// Halved sample counts, blurs and shadows at reduced resolution, sub-pixel effects are skipped
+    DRAFT,
+    /// Quartered sample counts, even lower resolution of blurs and shadows
+    PREVIEW
+};
+
 class EffectRenderer {
 
 public:
-    EffectRenderer(GraphicsContext &gc, TextureFrameBufferManager &tfbManager, Mesh &billboard, BlitShader &blitShader);
+    /// savedDistanceFieldPasses is incremented by the number of passes saved by reusing a distance field
+    EffectRenderer(GraphicsContext &gc, TextureFrameBufferManager &tfbManager, Mesh &billboard, BlitShader &blitShader, BlitShader &alphaBlitShader, int &savedDistanceFieldPasses);
     PlacedImagePtr drawEffect(const octopus::Effect &effect, const PlacedImagePtr &basis, double scale);
+    /// Same as drawEffect for a basis which is known to be the rounded rectangle - shadows and glows are then evaluated analytically
+    PlacedImagePtr drawRectangleEffect(const octopus::Effect &effect, const PlacedImagePtr &basis, const ScaledBounds &rectangle, double cornerRadius, double scale);
+    /// Releases the distance fields shared by effects of the same basis
+    void releaseDistanceFields();
+    void setQuality(EffectQuality quality);
+    EffectQuality getQuality() const;
+    /// Compiles all shaders of the current quality level in advance - returns false if any failed
+    bool warmUp();
 
 private:
     class ShaderManager {
     public:
-        ShaderManager();
+        /// precision is the base number of samples of the effect shaders
+        explicit ShaderManager(int precision);
+        int precision() const;
+        /// Initializes all shaders
+        bool warmUp();
         BoundedBlurShader *getBoundedBlurShader(char channel = '\0');
-        GaussianBlurShader *getGaussianBlurShader();
+        GaussianBlurShader *getGaussianBlurShader(char channel = '\0');
         DistanceTransformShader *getDistanceTransformShader(char channel = 'a');
         DistanceThresholdShader *getDistanceThresholdShader();
+        JumpFloodSeedShader *getJumpFloodSeedShader(char channel = 'a');
+        JumpFloodStepShader *getJumpFloodStepShader();
+        JumpFloodThresholdShader *getJumpFloodThresholdShader();
+        RectangleShadowShader *getRectangleShadowShader();
     private:
         EffectShader::SharedResource shaderRes;
+        int shaderPrecision;
         BoundedBlurShader boundedBlurShaders[3];
-        GaussianBlurShader gaussianBlurShader;
+        GaussianBlurShader gaussianBlurShaders[2];
         DistanceTransformShader distanceTransformShaders[2];
         DistanceThresholdShader distanceThresholdShader;
+        JumpFloodSeedShader jumpFloodSeedShaders[2];
+        JumpFloodStepShader jumpFloodStepShader;
+        JumpFloodThresholdShader jumpFloodThresholdShader;
+        RectangleShadowShader rectangleShadowShader;
+    };
+
+    /// Identifies a distance field of a basis image - effects of a layer which require the same distance range share it
+    struct DistanceFieldKey {
+        PlacedImagePtr basis;
+        char channel;
+        bool jumpFlood;
+        /// Shader precision of the distance transform - zero for jump flooded distance fields, which do not depend on it
+        int precision;
+        float minDistance, maxDistance;
+    };
+
+    struct DistanceField {
+        std::weak_ptr<Image> basis;
+        ScaledBounds basisBounds;
+        char channel;
+        bool jumpFlood;
+        int precision;
+        float minDistance, maxDistance;
+        TextureFrameBufferPtr texture;
+        PixelBounds bounds;
+        /// Number of passes that produced the distance field
+        int passes;
     };
 
     GraphicsContext &gc;
-    ShaderManager shaders;
+    /// Shader programs of each quality level - compiled on first use
+    ShaderManager shaderManagers[3];
+    ShaderManager *shaders;
+    EffectQuality quality;
     TextureFrameBufferManager &tfbManager;
     Mesh &billboard;
     BlitShader &blitShader;
+    /// Expands alpha only images (RED_IS_ALPHA) to premultiplied white
+    BlitShader &alphaBlitShader;
+    std::vector<DistanceField> distanceFields;
+    int &savedDistanceFieldPasses;
 
     PlacedImagePtr drawStroke(const octopus::Stroke &stroke, const PlacedImagePtr &basis, double scale);
     PlacedImagePtr drawShadow(octopus::Effect::Type type, const octopus::Shadow &shadow, PlacedImagePtr basis, double scale);
+    /// Returns null if the shadow cannot be evaluated analytically
+    PlacedImagePtr drawRectangleShadow(octopus::Effect::Type type, const octopus::Shadow &shadow, const PlacedImagePtr &basis, const ScaledBounds &rectangle, double cornerRadius, double scale);
     PlacedImagePtr drawBoundedBlur(double blur, const PlacedImagePtr &basis);
     PlacedImagePtr drawGaussianBlur(double blur, const PlacedImagePtr &basis);
-    PlacedImagePtr drawChoke(double choke, const Color &color, const PlacedImagePtr &basis);
-    PlacedImagePtr drawDistanceThreshold(float minDistance, float maxDistance, float lowerThreshold, float upperThreshold, const Color &color, const PlacedImagePtr &basis, const ScaledBounds &outputBounds);
+    /// Acquires a framebuffer whose resolution is reduced by the reduction factor and which covers at least bounds - bounds are expanded to the area it actually covers
+    TextureFrameBufferPtr acquireReduced(PixelBounds &bounds, int reduction, PixelFormat format);
+    /// Successively halves the resolution of image until it is reduced by the reduction factor (a power of two)
+    PlacedImagePtr reduceResolution(const PlacedImagePtr &image, int reduction);
+    /// Resamples a reduced resolution image to full resolution within bounds
+    PlacedImagePtr restoreResolution(const PlacedImagePtr &image, const ScaledBounds &bounds);
+    /// If color is null, the result is alpha only
+    PlacedImagePtr drawChoke(double choke, const Color *color, const PlacedImagePtr &basis);
+    /// If color is null, the result is alpha only
+    PlacedImagePtr drawDistanceThreshold(float minDistance, float maxDistance, float lowerThreshold, float upperThreshold, const Color *color, const PlacedImagePtr &basis, const ScaledBounds &outputBounds);
+    /// Equivalent of drawDistanceThreshold for large distances - finds the nearest edge pixel by jump flooding in log2(maxDistance) passes
+    PlacedImagePtr drawJumpFloodThreshold(float maxDistance, float lowerThreshold, float upperThreshold, const Color *color, const PlacedImagePtr &basis, const ScaledBounds &outputBounds);
+    /// Returns a previously computed distance field for key which covers at least bounds - bounds are expanded to the area it actually covers
+    TextureFrameBufferPtr findDistanceField(const DistanceFieldKey &key, PixelBounds &bounds);
+    void storeDistanceField(const DistanceFieldKey &key, const TextureFrameBufferPtr &texture, const PixelBounds &bounds, int passes);
 
 };
 
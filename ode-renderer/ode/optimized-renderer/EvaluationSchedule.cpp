@@ -0,0 +1,207 @@
+
+#include "EvaluationSchedule.h"
+
+#include <algorithm>
+
+namespace ode {
+
+/// Returns the memory occupied by an image with the given bounds in bytes
+static long long imageMemory(const ScaledBounds &bounds) {
+    if (!bounds)
+        return 0;
+    Vector2i dimensions = outerPixelBounds(bounds).dimensions();
+    return (long long) pixelSize(PixelFormat::PREMULTIPLIED_RGBA)*dimensions.x*dimensions.y;
+}
+
+EvaluationSchedule::EvaluationSchedule(Component &component, double scale, const ScaledBounds &visibleBounds, const ScaledBounds &backgroundBounds, const AnalyticMask &analyticMask) :
+    component(component),
+    scale(scale),
+    visibleBounds(visibleBounds),
+    backgroundBounds(backgroundBounds),
+    analyticMask(analyticMask)
+{ }
+
+bool EvaluationSchedule::operandOrder(const Rendexpr *expr, std::vector<int> &order) {
+    std::vector<const Rendexpr *> operands;
+    listOperands(expr, analyticMask, operands);
+    return operandOrder(operands, order);
+}
+
+bool EvaluationSchedule::operandOrder(const std::vector<const Rendexpr *> &operands, std::vector<int> &order) {
+    if (operands.size() < 2)
+        return false;
+    order.resize(operands.size());
+    for (int i = 0; i < int(order.size()); ++i)
+        order[i] = i;
+    // The peak while evaluating operands in sequence is max(held+peak) where held is the memory of the preceding results,
+    // which is minimized by evaluating operands in descending order of the difference between their peak and result memory
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        const Cost &costA = cost(operands[a]);
+        const Cost &costB = cost(operands[b]);
+        return costA.scheduledPeak-costA.resultMemory > costB.scheduledPeak-costB.resultMemory;
+    });
+    for (int i = 0; i < int(order.size()); ++i) {
+        if (order[i] != i)
+            return true;
+    }
+    return false;
+}
+
+long long EvaluationSchedule::fixedPeakMemory(const Rendexpr *expr) {
+    return cost(expr).fixedPeak;
+}
+
+long long EvaluationSchedule::scheduledPeakMemory(const Rendexpr *expr) {
+    return cost(expr).scheduledPeak;
+}
+
+ScaledBounds EvaluationSchedule::resultBounds(const Rendexpr *expr) {
+    return cost(expr).bounds;
+}
+
+const EvaluationSchedule::Cost &EvaluationSchedule::cost(const Rendexpr *expr) {
+    static const Cost NO_COST = { ScaledBounds::unspecified, 0, 0, 0 };
+    if (!expr)
+        return NO_COST;
+    std::map<const Rendexpr *, Cost>::const_iterator it = costs.find(expr);
+    if (it != costs.end())
+        return it->second;
+
+    Cost result = NO_COST;
+    switch (expr->type) {
+        case EmptyExpression::TYPE:
+            return costs[expr] = result;
+        case IdentityExpression::TYPE:
+            return costs[expr] = cost(static_cast<const IdentityExpression *>(expr)->content.get());
+        case SetBackgroundExpression::TYPE:
+            // The background is accounted for by the background expressions within content
+            return costs[expr] = cost(static_cast<const SetBackgroundExpression *>(expr)->content.get());
+        case BackgroundExpression::TYPE:
+            result.bounds = backgroundBounds;
+            break;
+        case DrawLayerBodyExpression::TYPE:
+        case DrawLayerStrokeExpression::TYPE:
+        case DrawLayerFillExpression::TYPE:
+        case DrawLayerStrokeFillExpression::TYPE:
+        case DrawLayerTextExpression::TYPE:
+            result.bounds = layerBounds(static_cast<const LayerRenderExpression *>(expr)->layer);
+            break;
+        case DrawLayerEffectExpression::TYPE:
+            result.bounds = cost(static_cast<const DrawLayerEffectExpression *>(expr)->basis.get()).bounds|layerBounds(static_cast<const DrawLayerEffectExpression *>(expr)->layer);
+            break;
+        case ApplyFilterExpression::TYPE:
+            result.bounds = cost(static_cast<const ApplyFilterExpression *>(expr)->basis.get()).bounds;
+            break;
+        case MultiplyAlphaExpression::TYPE:
+            result.bounds = cost(static_cast<const MultiplyAlphaExpression *>(expr)->image.get()).bounds;
+            break;
+        case BlendExpression::TYPE:
+            result.bounds = cost(static_cast<const BlendExpression *>(expr)->dst.get()).bounds|cost(static_cast<const BlendExpression *>(expr)->src.get()).bounds;
+            break;
+        case BlendIgnoreAlphaExpression::TYPE:
+            result.bounds = cost(static_cast<const BlendIgnoreAlphaExpression *>(expr)->dst.get()).bounds|cost(static_cast<const BlendIgnoreAlphaExpression *>(expr)->src.get()).bounds;
+            break;
+        case MixExpression::TYPE:
+            result.bounds = cost(static_cast<const MixExpression *>(expr)->a.get()).bounds|cost(static_cast<const MixExpression *>(expr)->b.get()).bounds;
+            break;
+        case MixLayerOpacityExpression::TYPE:
+            result.bounds = cost(static_cast<const MixLayerOpacityExpression *>(expr)->a.get()).bounds|cost(static_cast<const MixLayerOpacityExpression *>(expr)->b.get()).bounds;
+            break;
+        case MaskExpression::TYPE:
+            {
+                const MaskExpression *maskExpr = static_cast<const MaskExpression *>(expr);
+                result.bounds = cost(maskExpr->image.get()).bounds&cost(maskExpr->mask.get()).bounds;
+            }
+            break;
+        case MixMaskExpression::TYPE:
+            {
+                const MixMaskExpression *mixMaskExpr = static_cast<const MixMaskExpression *>(expr);
+                result.bounds = cost(mixMaskExpr->dst.get()).bounds|(cost(mixMaskExpr->src.get()).bounds&cost(mixMaskExpr->mask.get()).bounds);
+            }
+            break;
+    }
+    result.bounds &= visibleBounds;
+    result.resultMemory = imageMemory(result.bounds);
+
+    std::vector<const Rendexpr *> operands;
+    listOperands(expr, analyticMask, operands);
+    // The operands are evaluated one after another while the results of the preceding ones are held, then the result is produced from all of them
+    long long held = 0;
+    result.fixedPeak = 0;
+    for (const Rendexpr *operand : operands) {
+        const Cost &operandCost = cost(operand);
+        result.fixedPeak = std::max(result.fixedPeak, held+operandCost.fixedPeak);
+        held += operandCost.resultMemory;
+    }
+    result.fixedPeak = std::max(result.fixedPeak, held+result.resultMemory);
+    std::vector<int> order;
+    if (!operandOrder(operands, order)) {
+        order.resize(operands.size());
+        for (int i = 0; i < int(order.size()); ++i)
+            order[i] = i;
+    }
+    held = 0;
+    result.scheduledPeak = 0;
+    for (int index : order) {
+        const Cost &operandCost = cost(operands[index]);
+        result.scheduledPeak = std::max(result.scheduledPeak, held+operandCost.scheduledPeak);
+        held += operandCost.resultMemory;
+    }
+    result.scheduledPeak = std::max(result.scheduledPeak, held+result.resultMemory);
+    return costs[expr] = result;
+}
+
+void EvaluationSchedule::listOperands(const Rendexpr *expr, const AnalyticMask &analyticMask, std::vector<const Rendexpr *> &operands) {
+    operands.clear();
+    if (!expr)
+        return;
+    switch (expr->type) {
+        case DrawLayerEffectExpression::TYPE:
+            operands.push_back(static_cast<const DrawLayerEffectExpression *>(expr)->basis.get());
+            break;
+        case ApplyFilterExpression::TYPE:
+            operands.push_back(static_cast<const ApplyFilterExpression *>(expr)->basis.get());
+            break;
+        case MultiplyAlphaExpression::TYPE:
+            operands.push_back(static_cast<const MultiplyAlphaExpression *>(expr)->image.get());
+            break;
+        case BlendExpression::TYPE:
+            operands.push_back(static_cast<const BlendExpression *>(expr)->dst.get());
+            operands.push_back(static_cast<const BlendExpression *>(expr)->src.get());
+            break;
+        case BlendIgnoreAlphaExpression::TYPE:
+            operands.push_back(static_cast<const BlendIgnoreAlphaExpression *>(expr)->dst.get());
+            operands.push_back(static_cast<const BlendIgnoreAlphaExpression *>(expr)->src.get());
+            break;
+        case MixExpression::TYPE:
+            operands.push_back(static_cast<const MixExpression *>(expr)->a.get());
+            operands.push_back(static_cast<const MixExpression *>(expr)->b.get());
+            break;
+        case MixLayerOpacityExpression::TYPE:
+            operands.push_back(static_cast<const MixLayerOpacityExpression *>(expr)->a.get());
+            operands.push_back(static_cast<const MixLayerOpacityExpression *>(expr)->b.get());
+            break;
+        case MaskExpression::TYPE:
+            operands.push_back(static_cast<const MaskExpression *>(expr)->image.get());
+            if (!analyticMask(expr))
+                operands.push_back(static_cast<const MaskExpression *>(expr)->mask.get());
+            break;
+        case MixMaskExpression::TYPE:
+            operands.push_back(static_cast<const MixMaskExpression *>(expr)->dst.get());
+            operands.push_back(static_cast<const MixMaskExpression *>(expr)->src.get());
+            if (!analyticMask(expr))
+                operands.push_back(static_cast<const MixMaskExpression *>(expr)->mask.get());
+            break;
+        default:;
+    }
+}
+
+ScaledBounds EvaluationSchedule::layerBounds(const LayerInstanceSpecifier &layer) {
+    if (layer) {
+        if (Result<LayerBounds, DesignError> bounds = component.getLayerBounds(layer->id))
+            return scaleBounds(bounds.value().bounds, scale);
+    }
+    return backgroundBounds;
+}
+
+}
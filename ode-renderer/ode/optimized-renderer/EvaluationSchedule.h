@@ -0,0 +1,56 @@
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+#include <ode-logic.h>
+
+namespace ode {
+
+/// Estimates the memory occupied by intermediate results while a render expression tree is evaluated (Sethi-Ullman numbers weighted by the pixel sizes of the results)
+/// and chooses the order of evaluation of independent operands which minimizes its peak
+class EvaluationSchedule {
+
+public:
+    /// Returns true for a mask expression whose mask is applied analytically, without being evaluated
+    typedef std::function<bool(const Rendexpr *)> AnalyticMask;
+
+    /// Results are clipped to visibleBounds, the result of a background expression is assumed to cover backgroundBounds
+    EvaluationSchedule(Component &component, double scale, const ScaledBounds &visibleBounds, const ScaledBounds &backgroundBounds, const AnalyticMask &analyticMask);
+    /// Outputs the entry indices of the expression's operands in the order in which they should be evaluated - returns false if it is the fixed left-to-right order
+    bool operandOrder(const Rendexpr *expr, std::vector<int> &order);
+    /// Same for an arbitrary list of operands whose results are all needed at the same time (e.g. inputs of a fused compositing chain)
+    bool operandOrder(const std::vector<const Rendexpr *> &operands, std::vector<int> &order);
+    /// Returns the estimated peak memory of intermediate results in bytes while evaluating expr with operands in the fixed left-to-right order
+    long long fixedPeakMemory(const Rendexpr *expr);
+    /// Returns the estimated peak memory of intermediate results in bytes while evaluating expr with operands in the scheduled order
+    long long scheduledPeakMemory(const Rendexpr *expr);
+    /// Returns the estimated bounds of the expression's result
+    ScaledBounds resultBounds(const Rendexpr *expr);
+
+    /// Outputs the operands of an expression whose results are needed at the same time, in the order of their entries
+    static void listOperands(const Rendexpr *expr, const AnalyticMask &analyticMask, std::vector<const Rendexpr *> &operands);
+
+private:
+    struct Cost {
+        ScaledBounds bounds;
+        /// Memory occupied by the result
+        long long resultMemory;
+        long long fixedPeak;
+        long long scheduledPeak;
+    };
+
+    Component &component;
+    double scale;
+    ScaledBounds visibleBounds;
+    ScaledBounds backgroundBounds;
+    AnalyticMask analyticMask;
+    std::map<const Rendexpr *, Cost> costs;
+
+    const Cost &cost(const Rendexpr *expr);
+    ScaledBounds layerBounds(const LayerInstanceSpecifier &layer);
+
+};
+
+}
@@ -0,0 +1,193 @@
+
+#include "ExecutionPlan.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace ode {
+
+// Costs in microseconds - only their ratios affect the plan
+// Fixed overhead of a GPU pass (framebuffer switch, state changes, draw call)
+static constexpr double GPU_PASS_COST = 25;
+static constexpr double GPU_PIXEL_COST = .0005;
+// Per-pixel cost of a compositing operation on the CPU
+static constexpr double CPU_PIXEL_COST = .004;
+// Per-pixel cost of rasterizing a shape, which takes place on the CPU regardless of the plan
+static constexpr double RASTERIZATION_PIXEL_COST = .002;
+// Fixed overhead of an upload to video memory (texture creation) and its cost per byte
+static constexpr double UPLOAD_COST = 40;
+static constexpr double UPLOAD_BYTE_COST = .0005;
+
+static constexpr double UNSUPPORTED = std::numeric_limits<double>::infinity();
+
+static double uploadCost(long long pixels, int bytesPerPixel) {
+    return pixels ? UPLOAD_COST+UPLOAD_BYTE_COST*double(bytesPerPixel*pixels) : 0;
+}
+
+static double gpuPassCost(long long pixels) {
+    return GPU_PASS_COST+GPU_PIXEL_COST*double(pixels);
+}
+
+/// Returns the fill of a fill expression or null if it is not valid
+static const octopus::Fill *expressionFill(const Rendexpr *expr) {
+    if (expr->type == DrawLayerFillExpression::TYPE) {
+        const DrawLayerFillExpression *fillExpr = static_cast<const DrawLayerFillExpression *>(expr);
+        if (fillExpr->layer->shape.has_value() && fillExpr->index < int(fillExpr->layer->shape->fills.size()))
+            return &fillExpr->layer->shape->fills[fillExpr->index];
+    } else if (expr->type == DrawLayerStrokeFillExpression::TYPE) {
+        const DrawLayerStrokeFillExpression *fillExpr = static_cast<const DrawLayerStrokeFillExpression *>(expr);
+        if (fillExpr->layer->shape.has_value() && fillExpr->index < int(fillExpr->layer->shape->strokes.size()))
+            return &fillExpr->layer->shape->strokes[fillExpr->index].fill;
+    }
+    return nullptr;
+}
+
+ExecutionPlan::ExecutionPlan(EvaluationSchedule &schedule, const AnalyticMask &analyticMask) : schedule(schedule), analyticMask(analyticMask) { }
+
+void ExecutionPlan::plan(const Rendexpr *root) {
+    assign(root, false);
+}
+
+ExecutionPlan::Device ExecutionPlan::device(const Rendexpr *expr) const {
+    std::map<const Rendexpr *, Estimate>::const_iterator it = plannedEstimates.find(expr);
+    return it != plannedEstimates.end() ? it->second.device : GPU;
+}
+
+const char *ExecutionPlan::deviceName(Device device) {
+    switch (device) {
+        case GPU:
+            return "GPU";
+        case CPU:
+            return "CPU";
+    }
+    return "";
+}
+
+const ExecutionPlan::SubtreeCost &ExecutionPlan::subtreeCost(const Rendexpr *expr) {
+    static const SubtreeCost NO_COST = { 0, 0, GPU, { GPU, 0, 0, 0 } };
+    if (!expr)
+        return NO_COST;
+    std::map<const Rendexpr *, SubtreeCost>::const_iterator it = subtreeCosts.find(expr);
+    if (it != subtreeCosts.end())
+        return it->second;
+
+    SubtreeCost result = NO_COST;
+    long long pixels = 0;
+    if (PixelBounds bounds = outerPixelBounds(schedule.resultBounds(expr)))
+        pixels = (long long) bounds.dimensions().x*bounds.dimensions().y;
+    // Costs of the operation on either device, its operands are inputs
+    double cpuCost = UNSUPPORTED, gpuCost = UNSUPPORTED;
+    switch (expr->type) {
+        case EmptyExpression::TYPE:
+            return subtreeCosts[expr] = NO_COST;
+        case IdentityExpression::TYPE:
+            return subtreeCosts[expr] = subtreeCost(static_cast<const IdentityExpression *>(expr)->content.get());
+        case SetBackgroundExpression::TYPE:
+            return subtreeCosts[expr] = subtreeCost(static_cast<const SetBackgroundExpression *>(expr)->content.get());
+        case ApplyFilterExpression::TYPE:
+            // Filters are not applied yet
+            return subtreeCosts[expr] = subtreeCost(static_cast<const ApplyFilterExpression *>(expr)->basis.get());
+        case BackgroundExpression::TYPE:
+            // The background is evaluated separately and assumed to reside in video memory
+            result.onCpu = UNSUPPORTED;
+            result.estimate = Estimate { GPU, UNSUPPORTED, 0, pixels };
+            return subtreeCosts[expr] = result;
+        case DrawLayerBodyExpression::TYPE:
+        case DrawLayerStrokeExpression::TYPE:
+            #ifdef ODE_RASTERIZER_TEXTURE_SUPPORT
+                gpuCost = RASTERIZATION_PIXEL_COST*double(pixels);
+            #else
+                // Rasterized into an alpha only bitmap
+                result.onCpu = RASTERIZATION_PIXEL_COST*double(pixels);
+                result.onGpu = result.onCpu+uploadCost(pixels, 1);
+                result.onGpuDevice = CPU;
+                result.estimate = Estimate { CPU, result.onCpu, UNSUPPORTED, pixels };
+                return subtreeCosts[expr] = result;
+            #endif
+            break;
+        case DrawLayerFillExpression::TYPE:
+        case DrawLayerStrokeFillExpression::TYPE:
+            if (const octopus::Fill *fill = expressionFill(expr)) {
+                if (fill->type == octopus::Fill::Type::COLOR) {
+                    // A solid color is a single pixel stretched over the fill's bounds
+                    pixels = 1;
+                    cpuCost = CPU_PIXEL_COST;
+                }
+            }
+            gpuCost = gpuPassCost(pixels);
+            break;
+        case DrawLayerTextExpression::TYPE:
+            // Rasterized on the CPU but always transformed on the GPU
+            gpuCost = RASTERIZATION_PIXEL_COST*double(pixels)+uploadCost(pixels, 4)+gpuPassCost(pixels);
+            break;
+        case BlendExpression::TYPE:
+            if (static_cast<const BlendExpression *>(expr)->blendMode == octopus::BlendMode::NORMAL)
+                cpuCost = CPU_PIXEL_COST*double(pixels);
+            gpuCost = gpuPassCost(pixels);
+            break;
+        case MaskExpression::TYPE:
+            if (!analyticMask(expr))
+                cpuCost = CPU_PIXEL_COST*double(pixels);
+            gpuCost = gpuPassCost(pixels);
+            break;
+        case MixExpression::TYPE:
+        case MixLayerOpacityExpression::TYPE:
+        case MultiplyAlphaExpression::TYPE:
+            cpuCost = CPU_PIXEL_COST*double(pixels);
+            gpuCost = gpuPassCost(pixels);
+            break;
+        case BlendIgnoreAlphaExpression::TYPE:
+        case MixMaskExpression::TYPE:
+            gpuCost = gpuPassCost(pixels);
+            break;
+        case DrawLayerEffectExpression::TYPE:
+            // Effects take several passes
+            gpuCost = 4*gpuPassCost(pixels);
+            break;
+    }
+
+    // Operands of a CPU operation must reside in physical memory, those of a GPU operation in video memory
+    std::vector<const Rendexpr *> operands;
+    EvaluationSchedule::listOperands(expr, analyticMask, operands);
+    for (const Rendexpr *operand : operands) {
+        const SubtreeCost &operandCost = subtreeCost(operand);
+        cpuCost += operandCost.onCpu;
+        gpuCost += operandCost.onGpu;
+    }
+    result.onCpu = cpuCost;
+    result.onGpu = std::min(gpuCost, cpuCost+uploadCost(pixels, 4));
+    result.onGpuDevice = gpuCost <= cpuCost+uploadCost(pixels, 4) ? GPU : CPU;
+    result.estimate = Estimate { result.onGpuDevice, cpuCost, gpuCost, pixels };
+    return subtreeCosts[expr] = result;
+}
+
+void ExecutionPlan::assign(const Rendexpr *expr, bool onCpu) {
+    // A result referenced multiple times is evaluated on the device chosen for its first reference
+    if (!expr || plannedEstimates.find(expr) != plannedEstimates.end())
+        return;
+    const SubtreeCost &cost = subtreeCost(expr);
+    Estimate estimate = cost.estimate;
+    estimate.device = onCpu ? CPU : cost.onGpuDevice;
+    plannedEstimates[expr] = estimate;
+    switch (expr->type) {
+        case IdentityExpression::TYPE:
+            assign(static_cast<const IdentityExpression *>(expr)->content.get(), onCpu);
+            break;
+        case SetBackgroundExpression::TYPE:
+            assign(static_cast<const SetBackgroundExpression *>(expr)->content.get(), onCpu);
+            assign(static_cast<const SetBackgroundExpression *>(expr)->background.get(), false);
+            break;
+        case ApplyFilterExpression::TYPE:
+            assign(static_cast<const ApplyFilterExpression *>(expr)->basis.get(), onCpu);
+            break;
+        default:
+            {
+                std::vector<const Rendexpr *> operands;
+                EvaluationSchedule::listOperands(expr, analyticMask, operands);
+                for (const Rendexpr *operand : operands)
+                    assign(operand, estimate.device == CPU);
+            }
+    }
+}
+
+}
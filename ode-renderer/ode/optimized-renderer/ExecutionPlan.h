@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <vector>
+#include <ode-logic.h>
+#include "EvaluationSchedule.h"
+
+namespace ode {
+
+/// Chooses for each expression of a render expression tree whether its operation is evaluated on the CPU, in physical memory (see bitmap-compositing.h),
+/// or on the GPU, by a cost model of the operation and the size of its result. The model tracks where the results reside,
+/// so that the transfers of images from physical to video memory, which any mix of the two entails, are accounted for and minimized.
+/// Transfers in the other direction stall the GPU and are never planned. The savings of compositing fusion are not modelled.
+class ExecutionPlan {
+
+public:
+    enum Device {
+        GPU,
+        CPU
+    };
+
+    struct Estimate {
+        /// The device chosen for the expression's operation
+        Device device;
+        /// Estimated cost in microseconds of evaluating the subtree with the operation on either device, including the transfers of intermediate results - infinite if not supported
+        double cpuCost, gpuCost;
+        /// Estimated number of pixels of the result
+        long long pixels;
+    };
+
+    /// Returns true for a mask expression whose mask is applied analytically, without being evaluated
+    typedef EvaluationSchedule::AnalyticMask AnalyticMask;
+
+    /// The schedule provides the estimated bounds of results
+    ExecutionPlan(EvaluationSchedule &schedule, const AnalyticMask &analyticMask);
+    /// Plans the evaluation of the tree of root, whose result is needed in video memory
+    void plan(const Rendexpr *root);
+    /// Returns the device chosen for the expression, GPU if it has not been planned
+    Device device(const Rendexpr *expr) const;
+    /// Estimates of the planned expressions
+    inline const std::map<const Rendexpr *, Estimate> &estimates() const { return plannedEstimates; }
+
+    /// Returns the name of the device
+    static const char *deviceName(Device device);
+
+private:
+    /// Lowest total time estimates of the subtree's evaluation in microseconds
+    struct SubtreeCost {
+        /// With the result needed on the GPU (in video memory) and on the CPU (in physical memory)
+        double onGpu, onCpu;
+        /// The device chosen for the operation if the result is needed on the GPU - always the CPU in the other case
+        Device onGpuDevice;
+        Estimate estimate;
+    };
+
+    EvaluationSchedule &schedule;
+    AnalyticMask analyticMask;
+    std::map<const Rendexpr *, SubtreeCost> subtreeCosts;
+    std::map<const Rendexpr *, Estimate> plannedEstimates;
+
+    const SubtreeCost &subtreeCost(const Rendexpr *expr);
+    void assign(const Rendexpr *expr, bool onCpu);
+
+};
+
+}
@@ -0,0 +1,77 @@
+
+#include "ProgressiveRenderJob.h"
+
+#include <cmath>
+
+namespace ode {
+
+ProgressiveRenderJob::ProgressiveRenderJob(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, int previewReduction) :
+    renderer(renderer),
+    imageBase(imageBase),
+    component(component),
+    root(root),
+    scale(scale),
+    bounds(bounds),
+    time(time),
+    previewReduction(previewReduction),
+    previewPass(previewReduction > 1)
+{
+    if (previewPass) {
+        ScaledBounds previewBounds = 1./previewReduction*ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b);
+        job.reset(new RenderJob(renderer, imageBase, component, root, scale/previewReduction, outerPixelBounds(previewBounds), time));
+    } else
+        job.reset(new RenderJob(renderer, imageBase, component, root, scale, bounds, time));
+}
+
+bool ProgressiveRenderJob::advance(int maxOperations, double maxSeconds) {
+    if (previewPass) {
+        // The preview is drawn with reduced effect quality, which is restored for the final pass
+        EffectQuality quality = renderer.effectQuality();
+        if (quality == EffectQuality::FINAL)
+            renderer.setEffectQuality(EffectQuality::DRAFT);
+        bool previewFinished = job->advance(maxOperations, maxSeconds);
+        renderer.setEffectQuality(quality);
+        if (!previewFinished)
+            return false;
+        preview = job->result();
+        previewPass = false;
+        // The final pass starts with the next call, so that the caller can present the preview in the meantime
+        job.reset(new RenderJob(renderer, imageBase, component, root, scale, bounds, time));
+        return false;
+    }
+    return job->advance(maxOperations, maxSeconds);
+}
+
+bool ProgressiveRenderJob::finished() const {
+    return !previewPass && job->finished();
+}
+
+double ProgressiveRenderJob::progress() const {
+    if (previewReduction <= 1)
+        return job->progress();
+    double weight = previewWeight();
+    if (previewPass)
+        return weight*job->progress();
+    return weight+(1-weight)*job->progress();
+}
+
+bool ProgressiveRenderJob::hasResult() const {
+    return finished() || preview;
+}
+
+PlacedImagePtr ProgressiveRenderJob::result() {
+    if (finished())
+        return job->result();
+    if (preview) {
+        // Stretched over the full-scale bounds, the texture is sampled with bilinear filtering
+        return renderer.reframe(PlacedImagePtr(preview, double(previewReduction)*preview.bounds()), bounds);
+    }
+    return nullptr;
+}
+
+double ProgressiveRenderJob::previewWeight() const {
+    double reductionSq = double(previewReduction)*double(previewReduction);
+    return 1/(reductionSq+1);
+}
+
+}
@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include <memory>
+#include <ode-logic.h>
+#include "../image/Image.h"
+#include "../image/ImageBase.h"
+#include "Renderer.h"
+#include "RenderJob.h"
+
+namespace ode {
+
+/// Renders the component first at a reduced scale and draft effect quality and then at full scale, so that a preview of the result is available early.
+/// Data independent of scale (shape geometry, decoded and uploaded images) is prepared by the preview pass and reused by the final one
+class ProgressiveRenderJob {
+
+public:
+    /// previewReduction is the factor by which the scale is reduced for the preview pass, which is skipped if it is not greater than 1
+    ProgressiveRenderJob(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, int previewReduction);
+    ProgressiveRenderJob(const ProgressiveRenderJob &) = delete;
+    ProgressiveRenderJob &operator=(const ProgressiveRenderJob &) = delete;
+    /// Continues the render within the budget (see RenderJob::advance) - returns true if the final pass is finished
+    bool advance(int maxOperations, double maxSeconds);
+    bool finished() const;
+    /// Returns the estimated fraction of the work of both passes done, between 0 and 1
+    double progress() const;
+    /// Returns true if the preview or the final result is available
+    bool hasResult() const;
+    /// Returns the final result if finished, otherwise the preview scaled up to the full bounds, or null if neither is available
+    PlacedImagePtr result();
+
+private:
+    Renderer &renderer;
+    ImageBase &imageBase;
+    Component &component;
+    Rendexptr root;
+    double scale;
+    PixelBounds bounds;
+    double time;
+    int previewReduction;
+    std::unique_ptr<RenderJob> job;
+    bool previewPass;
+    PlacedImagePtr preview;
+
+    /// Fraction of the total work attributed to the preview pass, proportional to its area
+    double previewWeight() const;
+
+};
+
+}
@@ -1,12 +1,146 @@
 
 #include "RenderContext.h"
 
+#include <cmath>
+#include <string>
+#include <vector>
 #include <ode/animation/animate.h>
+#include <ode/core/effect-margin.h>
+#include "bitmap-compositing.h"
 
 namespace ode {
 
+// Subtrees with fewer operations are cheaper to evaluate again than to retain
+static constexpr int MIN_RETAINED_OPERATIONS = 3;
+
+// Estimated fraction of the bounds covered by a shape other than a rectangle (as if it was an ellipse)
+static constexpr double APPROXIMATE_SHAPE_COVERAGE = .785;
+// Estimated fraction of the bounds of a text layer covered by glyphs
+static constexpr double APPROXIMATE_TEXT_COVERAGE = .3;
+
 static const EmptyExpression EMPTY_EXPRESSION;
 
+/// Outputs the average color of a solid color or gradient fill (not premultiplied)
+static bool averageFillColor(const octopus::Fill &fill, Color &color) {
+    switch (fill.type) {
+        case octopus::Fill::Type::COLOR:
+            if (fill.color.has_value()) {
+                color = Color(fill.color->r, fill.color->g, fill.color->b, fill.color->a);
+                return true;
+            }
+            break;
+        case octopus::Fill::Type::GRADIENT:
+            if (fill.gradient.has_value() && !fill.gradient->stops.empty()) {
+                // Each segment between consecutive stops contributes the mean of its end colors weighted by its length
+                const std::vector<octopus::Gradient::ColorStop> &stops = fill.gradient->stops;
+                Color sum(0, 0, 0, 0);
+                double total = 0;
+                for (size_t i = 1; i < stops.size(); ++i) {
+                    double weight = .5*std::max(stops[i].position-stops[i-1].position, 0.);
+                    sum.r += weight*(stops[i-1].color.r+stops[i].color.r);
+                    sum.g += weight*(stops[i-1].color.g+stops[i].color.g);
+                    sum.b += weight*(stops[i-1].color.b+stops[i].color.b);
+                    sum.a += weight*(stops[i-1].color.a+stops[i].color.a);
+                    total += 2*weight;
+                }
+                if (total > 0)
+                    color = Color(sum.r/total, sum.g/total, sum.b/total, sum.a/total);
+                else
+                    color = Color(stops.front().color.r, stops.front().color.g, stops.front().color.b, stops.front().color.a);
+                return true;
+            }
+            break;
+        default:;
+    }
+    return false;
+}
+
+/// Outputs the average color of the topmost visible fill, or leaves color unchanged if there is none - returns false if it cannot be averaged
+static bool topmostFillColor(const std::vector<octopus::Fill> &fills, Color &color) {
+    for (std::vector<octopus::Fill>::const_reverse_iterator it = fills.rbegin(); it != fills.rend(); ++it) {
+        if (it->visible)
+            return averageFillColor(*it, color);
+    }
+    return true;
+}
+
+typedef unsigned long long SubtreeHash;
+
+// 64-bit FNV-1a hash
+static void hashAppend(SubtreeHash &hash, const void *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= SubtreeHash(reinterpret_cast<const unsigned char *>(data)[i]);
+        hash *= 0x100000001b3ull;
+    }
+}
+
+template <typename T>
+static void hashAppend(SubtreeHash &hash, const T &value) {
+    hashAppend(hash, &value, sizeof(T));
+}
+
+static void hashAppend(SubtreeHash &hash, const std::string &str) {
+    // The terminating null character separates consecutive strings
+    hashAppend(hash, str.c_str(), str.size()+1);
+}
+
+// Returns true if the fill is positioned relative to an ancestor rather than its layer
+static bool isFillPositionedByAncestor(const octopus::Fill &fill) {
+    return fill.positioning.has_value() && fill.positioning->origin != octopus::Fill::Positioning::Origin::LAYER;
+}
+
+// Returns true if the layer's image depends on its absolute position rather than only its transformation
+static bool dependsOnAbsolutePosition(const octopus::Layer &layer) {
+    if (layer.shape.has_value()) {
+        for (const octopus::Fill &fill : layer.shape->fills) {
+            if (isFillPositionedByAncestor(fill))
+                return true;
+        }
+        for (const octopus::Shape::Stroke &stroke : layer.shape->strokes) {
+            if (isFillPositionedByAncestor(stroke.fill))
+                return true;
+        }
+    }
+    for (const octopus::Effect &effect : layer.effects) {
+        if ((effect.overlay.has_value() && isFillPositionedByAncestor(effect.overlay.value())) || (effect.stroke.has_value() && isFillPositionedByAncestor(effect.stroke->fill)))
+            return true;
+    }
+    return false;
+}
+
+/// Returns the maximum combined reach of nested effects in the expression tree, in pixels
+static double maxEffectReach(const Rendexpr *expr, double scale, std::map<const Rendexpr *, double> &memo) {
+    if (!expr)
+        return 0;
+    std::map<const Rendexpr *, double>::const_iterator it = memo.find(expr);
+    if (it != memo.end())
+        return it->second;
+    double operandReach = 0;
+    switch (expr->type) {
+        #define VISIT_NODE(T)
+        #define VISIT_CHILD(T, m) \
+            operandReach = std::max(operandReach, maxEffectReach(static_cast<const T *>(expr)->m.get(), scale, memo))
+        RENDER_EXPRESSION_CASES(VISIT_NODE, VISIT_CHILD)
+        #undef VISIT_NODE
+        #undef VISIT_CHILD
+    }
+    double reach = operandReach;
+    if (expr->type == SetBackgroundExpression::TYPE) {
+        // Effects within content may be applied to the background
+        const SetBackgroundExpression *setBgExpr = static_cast<const SetBackgroundExpression *>(expr);
+        reach = maxEffectReach(setBgExpr->content.get(), scale, memo)+maxEffectReach(setBgExpr->background.get(), scale, memo);
+    } else if (expr->type == DrawLayerEffectExpression::TYPE) {
+        const DrawLayerEffectExpression *drawExpr = static_cast<const DrawLayerEffectExpression *>(expr);
+        if (drawExpr->index >= 0 && drawExpr->index < int(drawExpr->layer->effects.size())) {
+            double effectScale = scale*drawExpr->layer.parentFeatureScale*drawExpr->layer->featureScale.value_or(1);
+            // Extra pixels cover the rounding of intermediate results to pixel bounds
+            reach += effectScale*effectReach(drawExpr->layer->effects[drawExpr->index])+2;
+        }
+    }
+    memo[expr] = reach;
+    return reach;
+}
+
 RenderContext::CacheKey::CacheKey(RenderContext *ctx, const Rendexpr *expr) : std::pair<const Rendexpr *, std::stack<const Rendexpr *> >(
     expr->type == BackgroundExpression::TYPE ? nullptr : expr,
     expr->type == BackgroundExpression::TYPE ? ctx->backgroundStack : std::stack<const Rendexpr *>()
@@ -14,22 +148,36 @@ RenderContext::CacheKey::CacheKey(RenderContext *ctx, const Rendexpr *expr) : st
 
 const Rendexpr *RenderContext::step(const Rendexpr *expr, int entry) {
     ODE_ASSERT(expr);
+    if (!root)
+        root = expr;
 
+    SubtreeCache::Key retainedKey;
+    Vector2d translation;
     if (!entry) {
         std::map<CacheKey, std::pair<PlacedImagePtr, int> >::iterator it = imageCache.find(CacheKey(this, expr));
         if (it != imageCache.end()) {
             imageStack.push(it->second.first);
             // TODO BACKGROUNDS ARE CURRENTLY NOT ERASED - WASTE OF VIDEO MEMORY !!!
-            if (++it->second.second >= expr->refs && expr->type != BackgroundExpression::TYPE)
+            if (++it->second.second >= remainingRefs(expr) && expr->type != BackgroundExpression::TYPE)
                 imageCache.erase(it);
             return nullptr;
         }
+        PlacedImagePtr retained;
+        if (getSubtreeKey(expr, retainedKey, translation) && renderer.getSubtreeCache().find(retainedKey, translation, retained)) {
+            imageStack.push(retained);
+            elideOperands(expr);
+            if (remainingRefs(expr) > 1)
+                imageCache.insert(std::make_pair(CacheKey(this, expr), std::make_pair(retained, 1)));
+            return nullptr;
+        }
     }
 
     if (const Rendexpr *result = stepUncached(expr, entry))
         return result;
-    else if (expr->refs > 1 || expr->type == BackgroundExpression::TYPE) { // TODO BACKGROUNDS - see above
-        ODE_ASSERT(!imageStack.empty());
+    ODE_ASSERT(!imageStack.empty());
+    if (getSubtreeKey(expr, retainedKey, translation))
+        renderer.getSubtreeCache().store(retainedKey, translation, imageStack.top());
+    if (remainingRefs(expr) > 1 || expr->type == BackgroundExpression::TYPE) { // TODO BACKGROUNDS - see above
         // Important: CacheKey object must be created AFTER stepUncached
         imageCache.insert(std::make_pair(CacheKey(this, expr), std::make_pair(imageStack.top(), 1)));
     }
@@ -40,6 +188,51 @@ const Rendexpr *RenderContext::step(const Rendexpr *expr, int entry) {
 const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
     #define NONNULL(x) ((x) ? (x) : &EMPTY_EXPRESSION)
 
+    if (!entry && approximateLayer(expr))
+        return nullptr;
+
+    if (expr->type == MixLayerOpacityExpression::TYPE) {
+        std::map<const Rendexpr *, std::pair<ScaledBounds, Color> >::iterator it = collapsedGroups.find(expr);
+        if (!entry && it == collapsedGroups.end()) {
+            ScaledBounds groupBounds;
+            Color color;
+            if (collapseGroup(expr, groupBounds, color))
+                it = collapsedGroups.insert(std::make_pair(expr, std::make_pair(groupBounds, color))).first;
+        }
+        if (it != collapsedGroups.end())
+            return stepCollapsed(it, entry);
+    }
+
+    if (compositingFusion && CompositingChain::isFusible(expr) && !onCpu(expr)) {
+        std::map<const Rendexpr *, CompositingChain>::iterator it = fusedChains.find(expr);
+        if (!entry && it == fusedChains.end()) {
+            CompositingChain chain;
+            // Rectangle masks are applied by a dedicated analytic pass, operations planned on the CPU are evaluated separately
+            if (chain.build(expr, [this](const Rendexpr *expr) { return hasRectangleMask(expr) || onCpu(expr); }))
+                it = fusedChains.insert(std::make_pair(expr, (CompositingChain &&) chain)).first;
+        }
+        if (it != fusedChains.end())
+            return stepFused(it, entry);
+    }
+
+    // Operands are evaluated in the scheduled order and their results are restored to the order of entries before the operation is applied
+    if (operandScheduling) {
+        if (!entry) {
+            std::vector<int> order;
+            if (evaluationSchedule().operandOrder(expr, order))
+                operandOrders[expr] = (std::vector<int> &&) order;
+        }
+        std::map<const Rendexpr *, std::vector<int> >::iterator it = operandOrders.find(expr);
+        if (it != operandOrders.end()) {
+            if (entry < int(it->second.size()))
+                entry = it->second[entry];
+            else if (entry == int(it->second.size())) {
+                restoreOperandOrder(it->second);
+                operandOrders.erase(it);
+            }
+        }
+    }
+
     switch (expr->type) {
 
         case EmptyExpression::TYPE:
@@ -64,7 +257,10 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                             imageStack.pop();
                             ODE_ASSERT(!imageStack.empty());
                             PlacedImagePtr dst = imageStack.top();
-                            imageStack.top() = renderer.blend(dst, src, blendExpr->blendMode);
+                            if (onCpu(expr) && bitmapBlend(imageStack.top(), dst, src, blendExpr->blendMode))
+                                renderer.reportCpuOperation();
+                            else
+                                imageStack.top() = renderer.blend(dst, src, blendExpr->blendMode);
                             return nullptr;
                         }
                 }
@@ -102,6 +298,14 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                     case 0:
                         return NONNULL(maskExpr->image.get());
                     case 1:
+                        {
+                            Renderer::RectangleMask rectangleMask;
+                            if (getRectangleMask(maskExpr->mask.get(), rectangleMask)) {
+                                ODE_ASSERT(!imageStack.empty());
+                                imageStack.top() = renderer.mask(imageStack.top(), rectangleMask, maskExpr->channelMatrix);
+                                return nullptr;
+                            }
+                        }
                         return NONNULL(maskExpr->mask.get());
                     case 2:
                         {
@@ -110,7 +314,10 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                             imageStack.pop();
                             ODE_ASSERT(!imageStack.empty());
                             PlacedImagePtr image = imageStack.top();
-                            imageStack.top() = renderer.mask(image, mask, maskExpr->channelMatrix);
+                            if (onCpu(expr) && bitmapMask(imageStack.top(), image, mask, maskExpr->channelMatrix))
+                                renderer.reportCpuOperation();
+                            else
+                                imageStack.top() = renderer.mask(image, mask, maskExpr->channelMatrix);
                             return nullptr;
                         }
                 }
@@ -127,6 +334,18 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                     case 1:
                         return NONNULL(mixMaskExpr->src.get());
                     case 2:
+                        {
+                            Renderer::RectangleMask rectangleMask;
+                            if (getRectangleMask(mixMaskExpr->mask.get(), rectangleMask)) {
+                                ODE_ASSERT(!imageStack.empty());
+                                PlacedImagePtr src = imageStack.top();
+                                imageStack.pop();
+                                ODE_ASSERT(!imageStack.empty());
+                                PlacedImagePtr dst = imageStack.top();
+                                imageStack.top() = renderer.mixMask(dst, src, rectangleMask, mixMaskExpr->channelMatrix);
+                                return nullptr;
+                            }
+                        }
                         return NONNULL(mixMaskExpr->mask.get());
                     case 3:
                         {
@@ -161,7 +380,10 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                             imageStack.pop();
                             ODE_ASSERT(!imageStack.empty());
                             PlacedImagePtr a = imageStack.top();
-                            imageStack.top() = renderer.mix(a, b, mixExpr->ratio);
+                            if (onCpu(expr) && bitmapMix(imageStack.top(), a, b, mixExpr->ratio))
+                                renderer.reportCpuOperation();
+                            else
+                                imageStack.top() = renderer.mix(a, b, mixExpr->ratio);
                             return nullptr;
                         }
                 }
@@ -176,41 +398,47 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                     case 0:
                         return NONNULL(multiplyAlphaExpr->image.get());
                     case 1:
-                        ODE_ASSERT(!imageStack.empty());
-                        imageStack.top() = renderer.multiplyAlpha(imageStack.top(), multiplyAlphaExpr->multiplier);
-                        return nullptr;
+                        {
+                            ODE_ASSERT(!imageStack.empty());
+                            PlacedImagePtr image = imageStack.top();
+                            if (onCpu(expr) && bitmapMultiplyAlpha(imageStack.top(), image, multiplyAlphaExpr->multiplier))
+                                renderer.reportCpuOperation();
+                            else
+                                imageStack.top() = renderer.multiplyAlpha(image, multiplyAlphaExpr->multiplier);
+                            return nullptr;
+                        }
                 }
                 ODE_ASSERT(!"Invalid entry");
                 return nullptr;
             }
 
         case DrawLayerBodyExpression::TYPE:
-            imageStack.push(renderer.drawLayerBody(component, static_cast<const DrawLayerBodyExpression *>(expr)->layer, scale, time));
+            imageStack.push(renderer.drawLayerBody(component, static_cast<const DrawLayerBodyExpression *>(expr)->layer, visibleBounds, scale, time));
             return nullptr;
 
         case DrawLayerStrokeExpression::TYPE:
             {
                 const DrawLayerStrokeExpression *drawExpr = static_cast<const DrawLayerStrokeExpression *>(expr);
-                imageStack.push(renderer.drawLayerStroke(component, drawExpr->layer, drawExpr->index, scale, time));
+                imageStack.push(renderer.drawLayerStroke(component, drawExpr->layer, drawExpr->index, visibleBounds, scale, time));
                 return nullptr;
             }
 
         case DrawLayerFillExpression::TYPE:
             {
                 const DrawLayerFillExpression *drawExpr = static_cast<const DrawLayerFillExpression *>(expr);
-                imageStack.push(renderer.drawLayerFill(component, drawExpr->layer, drawExpr->index, imageBase, scale, time));
+                imageStack.push(renderer.drawLayerFill(component, drawExpr->layer, drawExpr->index, imageBase, visibleBounds, scale, time, onCpu(expr)));
                 return nullptr;
             }
 
         case DrawLayerStrokeFillExpression::TYPE:
             {
                 const DrawLayerStrokeFillExpression *drawExpr = static_cast<const DrawLayerStrokeFillExpression *>(expr);
-                imageStack.push(renderer.drawLayerStrokeFill(component, drawExpr->layer, drawExpr->index, imageBase, scale, time));
+                imageStack.push(renderer.drawLayerStrokeFill(component, drawExpr->layer, drawExpr->index, imageBase, visibleBounds, scale, time, onCpu(expr)));
                 return nullptr;
             }
 
         case DrawLayerTextExpression::TYPE:
-            imageStack.push(renderer.drawLayerText(component, static_cast<const DrawLayerTextExpression *>(expr)->layer, scale, time));
+            imageStack.push(renderer.drawLayerText(component, static_cast<const DrawLayerTextExpression *>(expr)->layer, visibleBounds, scale, time));
             return nullptr;
 
         case DrawLayerEffectExpression::TYPE:
@@ -221,7 +449,7 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                         return NONNULL(drawExpr->basis.get());
                     case 1:
                         ODE_ASSERT(!imageStack.empty());
-                        imageStack.top() = renderer.drawLayerEffect(component, drawExpr->layer, drawExpr->index, imageBase, imageStack.top(), scale, time);
+                        imageStack.top() = renderer.drawLayerEffect(component, drawExpr->layer, drawExpr->index, imageBase, imageStack.top(), visibleBounds, scale, time);
                         return nullptr;
                 }
                 ODE_ASSERT(!"Invalid entry");
@@ -313,6 +541,8 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
                                 imageStack.top() = a;
                             else if (layerOpacity == 1)
                                 imageStack.top() = b;
+                            else if (onCpu(expr) && bitmapMix(imageStack.top(), a, b, layerOpacity))
+                                renderer.reportCpuOperation();
                             else
                                 imageStack.top() = renderer.mix(a, b, layerOpacity);
                             return nullptr;
@@ -327,6 +557,434 @@ const Rendexpr *RenderContext::stepUncached(const Rendexpr *expr, int entry) {
     return nullptr;
 }
 
+const Rendexpr *RenderContext::stepFused(std::map<const Rendexpr *, CompositingChain>::iterator chain, int entry) {
+    const std::vector<const Rendexpr *> &inputs = chain->second.inputs();
+    std::map<const Rendexpr *, std::vector<int> >::iterator order = operandOrders.end();
+    if (operandScheduling) {
+        if (!entry) {
+            std::vector<int> inputOrder;
+            if (evaluationSchedule().operandOrder(inputs, inputOrder))
+                operandOrders[chain->first] = (std::vector<int> &&) inputOrder;
+        }
+        order = operandOrders.find(chain->first);
+    }
+    if (entry < int(inputs.size()))
+        return NONNULL(inputs[order != operandOrders.end() ? order->second[entry] : entry]);
+    ODE_ASSERT(imageStack.size() >= inputs.size());
+    std::vector<PlacedImagePtr> images(inputs.size());
+    for (int i = int(inputs.size()); i--;) {
+        images[order != operandOrders.end() ? order->second[i] : i] = imageStack.top();
+        imageStack.pop();
+    }
+    if (order != operandOrders.end())
+        operandOrders.erase(order);
+    imageStack.push(renderer.composite(chain->second, images));
+    fusedChains.erase(chain);
+    return nullptr;
+}
+
+EvaluationSchedule &RenderContext::evaluationSchedule() {
+    if (!schedule) {
+        ScaledBounds backgroundBounds = ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b)&visibleBounds;
+        schedule.reset(new EvaluationSchedule(component, scale, visibleBounds, backgroundBounds, [this](const Rendexpr *expr) { return hasRectangleMask(expr); }));
+    }
+    return *schedule;
+}
+
+const ExecutionPlan &RenderContext::executionPlan(const Rendexpr *root) {
+    if (!this->root)
+        this->root = root;
+    ODE_ASSERT(this->root == root);
+    return executionPlan();
+}
+
+ExecutionPlan &RenderContext::executionPlan() {
+    if (!plan) {
+        plan.reset(new ExecutionPlan(evaluationSchedule(), [this](const Rendexpr *expr) { return hasRectangleMask(expr); }));
+        plan->plan(root);
+    }
+    return *plan;
+}
+
+bool RenderContext::onCpu(const Rendexpr *expr) {
+    return hybridExecution && executionPlan().device(expr) == ExecutionPlan::CPU;
+}
+
+void RenderContext::restoreOperandOrder(const std::vector<int> &order) {
+    ODE_ASSERT(imageStack.size() >= order.size());
+    std::vector<PlacedImagePtr> operands(order.size());
+    for (int i = int(order.size()); i--;) {
+        operands[order[i]] = imageStack.top();
+        imageStack.pop();
+    }
+    for (const PlacedImagePtr &operand : operands)
+        imageStack.push(operand);
+}
+
+int RenderContext::remainingRefs(const Rendexpr *expr) const {
+    std::map<const Rendexpr *, int>::const_iterator it = elidedRefs.find(expr);
+    return it != elidedRefs.end() ? expr->refs-it->second : expr->refs;
+}
+
+void RenderContext::elideOperands(const Rendexpr *expr) {
+    std::vector<const Rendexpr *> operands;
+    switch (expr->type) {
+        #define VISIT_NODE(T)
+        #define VISIT_CHILD(T, m) \
+            operands.push_back(static_cast<const T *>(expr)->m.get())
+        RENDER_EXPRESSION_CASES(VISIT_NODE, VISIT_CHILD)
+        #undef VISIT_NODE
+        #undef VISIT_CHILD
+    }
+    for (const Rendexpr *operand : operands)
+        elideOperand(operand);
+}
+
+void RenderContext::elideOperand(const Rendexpr *operand) {
+    if (!operand || operand->type == BackgroundExpression::TYPE)
+        return;
+    int remaining = operand->refs-++elidedRefs[operand];
+    std::map<CacheKey, std::pair<PlacedImagePtr, int> >::iterator it = imageCache.find(CacheKey(this, operand));
+    if (it != imageCache.end()) {
+        // The cached result may no longer be needed by the remaining references
+        if (it->second.second >= remaining)
+            imageCache.erase(it);
+    } else if (remaining <= 0)
+        elideOperands(operand);
+}
+
+bool RenderContext::getRectangleMask(const Rendexpr *maskExpr, Renderer::RectangleMask &rectangleMask) {
+    // If the mask image is already cached, it is cheaper to use it
+    if (!(maskExpr && maskExpr->type == DrawLayerBodyExpression::TYPE) || imageCache.find(CacheKey(this, maskExpr)) != imageCache.end())
+        return false;
+    if (renderer.getRectangleMask(component, static_cast<const DrawLayerBodyExpression *>(maskExpr)->layer, scale, time, rectangleMask)) {
+        ++elidedRefs[maskExpr];
+        return true;
+    }
+    return false;
+}
+
+bool RenderContext::hasRectangleMask(const Rendexpr *expr) {
+    const Rendexpr *maskExpr = nullptr;
+    if (expr->type == MaskExpression::TYPE)
+        maskExpr = static_cast<const MaskExpression *>(expr)->mask.get();
+    else if (expr->type == MixMaskExpression::TYPE)
+        maskExpr = static_cast<const MixMaskExpression *>(expr)->mask.get();
+    Renderer::RectangleMask rectangleMask;
+    return maskExpr && maskExpr->type == DrawLayerBodyExpression::TYPE && renderer.getRectangleMask(component, static_cast<const DrawLayerBodyExpression *>(maskExpr)->layer, scale, time, rectangleMask);
+}
+
+bool RenderContext::approximateLayer(const Rendexpr *expr) {
+    double threshold = renderer.detailThreshold();
+    if (!(threshold > 0 && (expr->type == DrawLayerBodyExpression::TYPE || expr->type == DrawLayerTextExpression::TYPE || expr->type == DrawLayerEffectExpression::TYPE)))
+        return false;
+    const LayerInstanceSpecifier &layer = static_cast<const LayerRenderExpression *>(expr)->layer;
+    if (!layer)
+        return false;
+    Result<LayerBounds, DesignError> layerBounds = component.getLayerBounds(layer->id);
+    if (!layerBounds)
+        return false;
+    ScaledBounds bounds = scaleBounds(layerBounds.value().bounds, scale);
+    if (!(bounds.dimensions().x < threshold && bounds.dimensions().y < threshold))
+        return false;
+    // Animated layers may be elsewhere than their static bounds
+    Result<const DocumentAnimation *, DesignError> animation = component.getAnimation(layer->id);
+    if (animation && !animation.value()->animations.empty())
+        return false;
+
+    switch (expr->type) {
+        case DrawLayerBodyExpression::TYPE:
+            if (layer->shape.has_value()) {
+                Renderer::RectangleMask rectangle;
+                if (renderer.getRectangleMask(component, layer, scale, time, rectangle))
+                    imageStack.push(renderer.drawApproximation(rectangle.rectangle, Color(1, 1, 1, 1)));
+                else
+                    imageStack.push(renderer.drawApproximation(bounds, Color(APPROXIMATE_SHAPE_COVERAGE, APPROXIMATE_SHAPE_COVERAGE)));
+                return true;
+            }
+            break;
+        case DrawLayerTextExpression::TYPE:
+            if (layer->text.has_value()) {
+                // The topmost visible fill of the default style, black if there is none
+                Color color(0, 0, 0, 1);
+                if (layer->text->defaultStyle.fills.has_value() && !topmostFillColor(layer->text->defaultStyle.fills.value(), color))
+                    return false;
+                double alpha = APPROXIMATE_TEXT_COVERAGE*color.a;
+                imageStack.push(renderer.drawApproximation(bounds, Color(alpha*color.r, alpha*color.g, alpha*color.b, alpha)));
+                return true;
+            }
+            break;
+        case DrawLayerEffectExpression::TYPE:
+            {
+                // Effects other than overlays (which only replace the fill) are dropped along with their basis if their own extent is also below the threshold,
+                // otherwise they are evaluated in full from the layer's approximated basis
+                const DrawLayerEffectExpression *drawExpr = static_cast<const DrawLayerEffectExpression *>(expr);
+                if (drawExpr->index >= 0 && drawExpr->index < int(layer->effects.size()) && layer->effects[drawExpr->index].type != octopus::Effect::Type::OVERLAY) {
+                    UntransformedMargin margin = effectMargin(layer->effects[drawExpr->index]);
+                    double effectScale = scale*layer.parentFeatureScale*layer->featureScale.value_or(1);
+                    // The margin is applied uniformly as the layer may be rotated
+                    ScaledBounds effectBounds = bounds+ScaledMargin(effectScale*std::max(std::max(fabs(margin.a.x), fabs(margin.a.y)), std::max(fabs(margin.b.x), fabs(margin.b.y))));
+                    if (!(effectBounds.dimensions().x < threshold && effectBounds.dimensions().y < threshold))
+                        return false;
+                    if (drawExpr->basis)
+                        ++elidedRefs[drawExpr->basis.get()];
+                    imageStack.push(PlacedImagePtr());
+                    return true;
+                }
+            }
+            break;
+    }
+    return false;
+}
+
+bool RenderContext::collapseGroup(const Rendexpr *expr, ScaledBounds &bounds, Color &color) {
+    double threshold = renderer.detailThreshold();
+    if (!(threshold > 0 && expr->type == MixLayerOpacityExpression::TYPE))
+        return false;
+    const LayerInstanceSpecifier &layer = static_cast<const MixLayerOpacityExpression *>(expr)->layer;
+    // The background of the group's content is replaced as well, so it must be blended normally onto it
+    if (!(layer && layer->type == octopus::Layer::Type::GROUP && (layer->blendMode == octopus::BlendMode::NORMAL || layer->blendMode == octopus::BlendMode::PASS_THROUGH)))
+        return false;
+    Result<LayerBounds, DesignError> layerBounds = component.getLayerBounds(layer->id);
+    if (!layerBounds)
+        return false;
+    bounds = scaleBounds(layerBounds.value().bounds, scale);
+    if (!(bounds.dimensions().x < threshold && bounds.dimensions().y < threshold))
+        return false;
+    color = Color(0, 0, 0, 0);
+    return accumulateApproximateColor(*layer, layerBounds.value().bounds, 1, color);
+}
+
+bool RenderContext::accumulateApproximateColor(const octopus::Layer &layer, const UnscaledBounds &groupBounds, double coverage, Color &color) {
+    if (!layer.visible)
+        return true;
+    // Effects and masks may extend beyond or cut into the bounds, other blend modes depend on what is underneath
+    for (const octopus::Effect &effect : layer.effects) {
+        if (effect.visible)
+            return false;
+    }
+    if (layer.mask.has_value() || !(layer.blendMode == octopus::BlendMode::NORMAL || layer.blendMode == octopus::BlendMode::PASS_THROUGH))
+        return false;
+    // Animated layers may be elsewhere than their static bounds
+    Result<const DocumentAnimation *, DesignError> animation = component.getAnimation(layer.id);
+    if (animation && !animation.value()->animations.empty())
+        return false;
+    coverage *= layer.opacity;
+
+    Color layerColor(0, 0, 0, 0);
+    switch (layer.type) {
+        case octopus::Layer::Type::GROUP:
+            if (layer.layers.has_value()) {
+                // Children are listed from the bottom up
+                for (const octopus::Layer &child : layer.layers.value()) {
+                    if (!accumulateApproximateColor(child, groupBounds, coverage, color))
+                        return false;
+                }
+            }
+            return true;
+        case octopus::Layer::Type::SHAPE:
+            if (!layer.shape.has_value())
+                return true;
+            for (const octopus::Shape::Stroke &stroke : layer.shape->strokes) {
+                if (stroke.visible)
+                    return false;
+            }
+            if (!topmostFillColor(layer.shape->fills, layerColor))
+                return false;
+            {
+                Rectangle<double> rectangle;
+                double cornerRadius = 0;
+                Result<Rasterizer::Shape *, DesignError> shape = component.getLayerShape(layer.id);
+                if (!(shape && shape.value() && Rasterizer::getRoundedRectangle(shape.value(), TransformationMatrix::identity, rectangle, cornerRadius)))
+                    coverage *= APPROXIMATE_SHAPE_COVERAGE;
+            }
+            break;
+        case octopus::Layer::Type::TEXT:
+            if (!layer.text.has_value())
+                return true;
+            layerColor = Color(0, 0, 0, 1);
+            if (layer.text->defaultStyle.fills.has_value() && !topmostFillColor(layer.text->defaultStyle.fills.value(), layerColor))
+                return false;
+            coverage *= APPROXIMATE_TEXT_COVERAGE;
+            break;
+        default:
+            return false;
+    }
+
+    Result<LayerBounds, DesignError> layerBounds = component.getLayerBounds(layer.id);
+    if (!layerBounds)
+        return false;
+    const UnscaledBounds &bounds = layerBounds.value().bounds;
+    double groupArea = groupBounds.dimensions().x*groupBounds.dimensions().y;
+    if (!(groupArea > 0))
+        return false;
+    coverage *= std::min(bounds.dimensions().x*bounds.dimensions().y/groupArea, 1.);
+    // Premultiplied source-over of the layer's color spread over the group's bounds
+    double alpha = coverage*layerColor.a;
+    color.r = alpha*layerColor.r+(1-alpha)*color.r;
+    color.g = alpha*layerColor.g+(1-alpha)*color.g;
+    color.b = alpha*layerColor.b+(1-alpha)*color.b;
+    color.a = alpha+(1-alpha)*color.a;
+    return true;
+}
+
+const Rendexpr *RenderContext::stepCollapsed(std::map<const Rendexpr *, std::pair<ScaledBounds, Color> >::iterator group, int entry) {
+    const MixLayerOpacityExpression *mixExpr = static_cast<const MixLayerOpacityExpression *>(group->first);
+    switch (entry) {
+        case 0:
+            // Only the background is evaluated, the group's content is replaced by its approximation
+            elideOperand(mixExpr->b.get());
+            return NONNULL(mixExpr->a.get());
+        case 1:
+            ODE_ASSERT(!imageStack.empty());
+            imageStack.top() = renderer.blend(imageStack.top(), renderer.drawApproximation(group->second.first, group->second.second), octopus::BlendMode::NORMAL);
+            collapsedGroups.erase(group);
+            return nullptr;
+    }
+    ODE_ASSERT(!"Invalid entry");
+    return nullptr;
+}
+
+const RenderContext::SubtreeInfo &RenderContext::subtreeInfo(const Rendexpr *expr) {
+    std::map<const Rendexpr *, SubtreeInfo>::const_iterator it = subtreeInfos.find(expr);
+    if (it != subtreeInfos.end())
+        return it->second;
+    SubtreeInfo info;
+    info.contentHash = 0xcbf29ce484222325ull;
+    info.operations = 0;
+    info.placed = false;
+    info.selfContained = true;
+    hashAppend(info.contentHash, expr->type);
+    hashAppend(info.contentHash, expr->flags);
+
+    const LayerInstanceSpecifier *layer = nullptr;
+    std::vector<const Rendexpr *> operands;
+    switch (expr->type) {
+        case EmptyExpression::TYPE:
+        case IdentityExpression::TYPE:
+            break;
+        case BlendExpression::TYPE:
+            hashAppend(info.contentHash, static_cast<const BlendExpression *>(expr)->blendMode);
+            break;
+        case BlendIgnoreAlphaExpression::TYPE:
+            hashAppend(info.contentHash, static_cast<const BlendIgnoreAlphaExpression *>(expr)->blendMode);
+            break;
+        case MaskExpression::TYPE:
+            hashAppend(info.contentHash, static_cast<const MaskExpression *>(expr)->channelMatrix.m);
+            break;
+        case MixMaskExpression::TYPE:
+            hashAppend(info.contentHash, static_cast<const MixMaskExpression *>(expr)->channelMatrix.m);
+            break;
+        case MixExpression::TYPE:
+            hashAppend(info.contentHash, static_cast<const MixExpression *>(expr)->ratio);
+            break;
+        case MultiplyAlphaExpression::TYPE:
+            hashAppend(info.contentHash, static_cast<const MultiplyAlphaExpression *>(expr)->multiplier);
+            break;
+        case DrawLayerBodyExpression::TYPE:
+        case DrawLayerTextExpression::TYPE:
+        case MixLayerOpacityExpression::TYPE:
+            layer = &static_cast<const LayerRenderExpression *>(expr)->layer;
+            break;
+        case DrawLayerStrokeExpression::TYPE:
+            layer = &static_cast<const DrawLayerStrokeExpression *>(expr)->layer;
+            hashAppend(info.contentHash, static_cast<const DrawLayerStrokeExpression *>(expr)->index);
+            break;
+        case DrawLayerFillExpression::TYPE:
+            layer = &static_cast<const DrawLayerFillExpression *>(expr)->layer;
+            hashAppend(info.contentHash, static_cast<const DrawLayerFillExpression *>(expr)->index);
+            break;
+        case DrawLayerStrokeFillExpression::TYPE:
+            layer = &static_cast<const DrawLayerStrokeFillExpression *>(expr)->layer;
+            hashAppend(info.contentHash, static_cast<const DrawLayerStrokeFillExpression *>(expr)->index);
+            break;
+        case DrawLayerEffectExpression::TYPE:
+            layer = &static_cast<const DrawLayerEffectExpression *>(expr)->layer;
+            hashAppend(info.contentHash, static_cast<const DrawLayerEffectExpression *>(expr)->index);
+            break;
+        case ApplyFilterExpression::TYPE:
+        case BackgroundExpression::TYPE:
+            // Filter parameters are not part of the hash
+            info.selfContained = false;
+            break;
+        case SetBackgroundExpression::TYPE:
+            break;
+    }
+    if (!(expr->type == EmptyExpression::TYPE || expr->type == IdentityExpression::TYPE || expr->type == BackgroundExpression::TYPE))
+        ++info.operations;
+
+    if (layer && *layer) {
+        // The layer's content is identified by its last modification, its placement by its transformation relative to the subtree's first layer
+        TransformationMatrix layerTransform = TransformationMatrix::scale(scale)*layer->parentTransform*TransformationMatrix((*layer)->transform);
+        hashAppend(info.contentHash, (*layer)->id);
+        hashAppend(info.contentHash, component.layerContentSerial((*layer)->id));
+        hashAppend(info.contentHash, layer->parentFeatureScale);
+        for (int i = 0; i < 2; ++i) {
+            for (int j = 0; j < 2; ++j)
+                hashAppend(info.contentHash, layerTransform[i][j]);
+        }
+        Result<const DocumentAnimation *, DesignError> animation = component.getAnimation((*layer)->id);
+        if (animation && !animation.value()->animations.empty())
+            hashAppend(info.contentHash, time);
+        info.placed = true;
+        info.translation = Vector2d(layerTransform[2][0], layerTransform[2][1]);
+        // Fills positioned relative to an ancestor do not move with the layer, so the result may only be reused at the same position
+        if (dependsOnAbsolutePosition(*layer->layer))
+            hashAppend(info.contentHash, info.translation);
+    }
+
+    switch (expr->type) {
+        #define VISIT_NODE(T)
+        #define VISIT_CHILD(T, m) \
+            operands.push_back(static_cast<const T *>(expr)->m.get())
+        RENDER_EXPRESSION_CASES(VISIT_NODE, VISIT_CHILD)
+        #undef VISIT_NODE
+        #undef VISIT_CHILD
+    }
+    for (const Rendexpr *operand : operands) {
+        if (!operand) {
+            hashAppend(info.contentHash, char(0));
+            continue;
+        }
+        const SubtreeInfo &operandInfo = subtreeInfo(operand);
+        hashAppend(info.contentHash, operandInfo.contentHash);
+        if (operandInfo.placed) {
+            if (!info.placed) {
+                info.placed = true;
+                info.translation = operandInfo.translation;
+            }
+            hashAppend(info.contentHash, operandInfo.translation-info.translation);
+        }
+        info.operations += operandInfo.operations;
+        // Backgrounds within the content subtree of SetBackground are resolved by it
+        if (!(operandInfo.selfContained || (expr->type == SetBackgroundExpression::TYPE && operand == static_cast<const SetBackgroundExpression *>(expr)->content.get())))
+            info.selfContained = false;
+    }
+    return subtreeInfos[expr] = info;
+}
+
+bool RenderContext::getSubtreeKey(const Rendexpr *expr, SubtreeCache::Key &key, Vector2d &translation) {
+    // A result restricted to visible bounds is incomplete
+    if (!(subtreeRetention && visibleBounds == ScaledBounds::infinite && expr->type != IdentityExpression::TYPE))
+        return false;
+    const SubtreeInfo &info = subtreeInfo(expr);
+    if (!(info.selfContained && info.placed && info.operations >= MIN_RETAINED_OPERATIONS))
+        return false;
+    key.componentId = component.uniqueId();
+    key.contentHash = info.contentHash;
+    key.scale = scale;
+    key.subpixelTranslation = Vector2d(info.translation.x-floor(info.translation.x), info.translation.y-floor(info.translation.y));
+    key.quality = renderer.effectQuality();
+    key.detailThreshold = renderer.detailThreshold();
+    translation = info.translation;
+    return true;
+}
+
+void RenderContext::restrictToBounds(const Rendexpr *root) {
+    std::map<const Rendexpr *, double> memo;
+    visibleBounds = ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b)+ScaledMargin(ceil(maxEffectReach(root, scale, memo)));
+}
+
 PlacedImagePtr RenderContext::peek() const {
     ODE_ASSERT(!imageStack.empty());
     return imageStack.top();
@@ -334,7 +992,24 @@ PlacedImagePtr RenderContext::peek() const {
 
 PlacedImagePtr RenderContext::finish() {
     ODE_ASSERT(imageStack.size() == 1);
+    if (root) {
+        long long fixedPeak = evaluationSchedule().fixedPeakMemory(root);
+        renderer.reportPeakMemory(fixedPeak, operandScheduling ? evaluationSchedule().scheduledPeakMemory(root) : fixedPeak);
+    }
     if (!imageStack.empty()) {
+        if (visibleBounds != ScaledBounds::infinite) {
+            PlacedImagePtr image = imageStack.top();
+            // Clipped to the component's dimensions the same way as the complete result
+            if (component.getOctopus().dimensions.has_value()) {
+                PixelBounds componentBounds = outerPixelBounds(scaleBounds(UnscaledBounds(0, 0, component.getOctopus().dimensions->width, component.getOctopus().dimensions->height), scale));
+                if (PixelBounds clipBounds = componentBounds&bounds) {
+                    if (clipBounds != bounds)
+                        image = renderer.reframe(image, clipBounds);
+                } else
+                    image = nullptr;
+            }
+            return renderer.reframe(image, bounds);
+        }
         if (component.getOctopus().dimensions.has_value())
             return renderer.reframe(imageStack.top(), outerPixelBounds(scaleBounds(UnscaledBounds(0, 0, component.getOctopus().dimensions->width, component.getOctopus().dimensions->height), scale)));
         else
@@ -1,10 +1,16 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <stack>
+#include <vector>
 #include <ode-logic.h>
 #include "../image/ImageBase.h"
 #include "Renderer.h"
+#include "CompositingChain.h"
+#include "EvaluationSchedule.h"
+#include "ExecutionPlan.h"
 
 namespace ode {
 
@@ -15,6 +21,19 @@ public:
     const Rendexpr *step(const Rendexpr *expr, int entry);
     PlacedImagePtr peek() const;
     PlacedImagePtr finish();
+    /// Enables evaluation of chains of compositing operations in a single pass (intermediate results are then not produced)
+    inline void setCompositingFusion(bool enabled) { compositingFusion = enabled; }
+    /// Enables reuse of subtree results retained by the renderer from previous renders (see SubtreeCache), whose subtrees are then not evaluated
+    inline void setSubtreeRetention(bool enabled) { subtreeRetention = enabled; }
+    /// Enables evaluation of independent operands in the order which minimizes the peak memory of intermediate results (see EvaluationSchedule) instead of left-to-right
+    inline void setOperandScheduling(bool enabled) { operandScheduling = enabled; }
+    /// Enables evaluation of operations on the CPU where the cost model of ExecutionPlan deems it cheaper than on the GPU (disabled by default)
+    inline void setHybridExecution(bool enabled) { hybridExecution = enabled; }
+    /// Returns the plan of the devices on which the operations of the tree of root are evaluated - root must be the tree being evaluated, if any
+    const ExecutionPlan &executionPlan(const Rendexpr *root);
+    /// Restricts the result to the bounds passed in the constructor and skips drawing content which cannot affect them.
+    /// Content within the combined reach of nested effects in the expression tree of root is kept, so that effects remain correct near the edges
+    void restrictToBounds(const Rendexpr *root);
 
 private:
     class CacheKey : public std::pair<const Rendexpr *, std::stack<const Rendexpr *> > {
@@ -22,18 +41,73 @@ private:
         CacheKey(RenderContext *ctx, const Rendexpr *expr);
     };
 
+    /// Identifies the content of a subtree independently of its nodes
+    struct SubtreeInfo {
+        unsigned long long contentHash;
+        /// Number of rendering operations in the subtree
+        int operations;
+        /// Whether the subtree contains a layer, in which case translation is the translation of its first layer
+        bool placed;
+        Vector2d translation;
+        /// False if the result depends on something outside the subtree (e.g. a background)
+        bool selfContained;
+    };
+
     Renderer &renderer;
     ImageBase &imageBase;
     Component &component;
     double scale;
     PixelBounds bounds;
     double time;
+    /// Content outside of these bounds is not drawn
+    ScaledBounds visibleBounds = ScaledBounds::infinite;
     std::stack<PlacedImagePtr> imageStack;
     std::stack<const Rendexpr *> backgroundStack;
     std::stack<const Rendexpr *> backgroundAntiStack;
     std::map<CacheKey, std::pair<PlacedImagePtr, int> > imageCache;
+    bool compositingFusion = true;
+    std::map<const Rendexpr *, CompositingChain> fusedChains;
+    /// Number of references to an expression that were satisfied without evaluating it
+    std::map<const Rendexpr *, int> elidedRefs;
+    /// Bounds and premultiplied averaged colors which replace the content of groups collapsed by the detail threshold while their backgrounds are evaluated
+    std::map<const Rendexpr *, std::pair<ScaledBounds, Color> > collapsedGroups;
+    bool subtreeRetention = true;
+    std::map<const Rendexpr *, SubtreeInfo> subtreeInfos;
+    bool operandScheduling = true;
+    std::unique_ptr<EvaluationSchedule> schedule;
+    /// Evaluation orders of the operands of expressions being evaluated, if they differ from the order of entries
+    std::map<const Rendexpr *, std::vector<int> > operandOrders;
+    bool hybridExecution = false;
+    std::unique_ptr<ExecutionPlan> plan;
+    /// The first evaluated expression
+    const Rendexpr *root = nullptr;
 
     const Rendexpr *stepUncached(const Rendexpr *expr, int entry);
+    int remainingRefs(const Rendexpr *expr) const;
+    /// Records the references of the expression's operands as elided when its result is obtained without evaluating them, along with those of operands which are then no longer needed at all
+    void elideOperands(const Rendexpr *expr);
+    /// Records a single reference to operand as elided, along with the references of its own operands if it is then no longer needed
+    void elideOperand(const Rendexpr *operand);
+    /// Returns true if the mask expression can be applied analytically as a rectangle (without rendering it)
+    bool getRectangleMask(const Rendexpr *maskExpr, Renderer::RectangleMask &rectangleMask);
+    bool hasRectangleMask(const Rendexpr *expr);
+    /// If the expression draws a layer which is smaller than the renderer's detail threshold, pushes its approximation (or nothing for effects whose extent is also below it) and returns true
+    bool approximateLayer(const Rendexpr *expr);
+    /// If the expression mixes the opacity of a group which is smaller than the renderer's detail threshold, outputs its bounds and a single averaged color which replaces all of its content
+    bool collapseGroup(const Rendexpr *expr, ScaledBounds &bounds, Color &color);
+    /// Composites the averaged color of the layer and its descendants, scaled by the fraction of groupBounds they cover and coverage, over color - returns false if they cannot be approximated this way
+    bool accumulateApproximateColor(const octopus::Layer &layer, const UnscaledBounds &groupBounds, double coverage, Color &color);
+    const Rendexpr *stepCollapsed(std::map<const Rendexpr *, std::pair<ScaledBounds, Color> >::iterator group, int entry);
+    const Rendexpr *stepFused(std::map<const Rendexpr *, CompositingChain>::iterator chain, int entry);
+    EvaluationSchedule &evaluationSchedule();
+    ExecutionPlan &executionPlan();
+    /// Returns true if the expression's operation is planned to be evaluated on the CPU
+    bool onCpu(const Rendexpr *expr);
+    /// Reorders the operand results at the top of the image stack from the order of evaluation to the order of entries
+    void restoreOperandOrder(const std::vector<int> &order);
+    const SubtreeInfo &subtreeInfo(const Rendexpr *expr);
+    /// Returns true if the result of the subtree may be retained across renders and outputs its key and translation
+    bool getSubtreeKey(const Rendexpr *expr, SubtreeCache::Key &key, Vector2d &translation);
 
 };
 
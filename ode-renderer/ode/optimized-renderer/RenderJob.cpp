@@ -0,0 +1,80 @@
+
+#include "RenderJob.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace ode {
+
+RenderJob::RenderJob(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time) :
+    root(root),
+    renderContext(renderer, imageBase, component, scale, bounds, time),
+    completedNodes(0),
+    done(false)
+{
+    if (root) {
+        nodeCount(root.get());
+        exprStack.push(std::make_pair(root.get(), 0));
+    } else {
+        image = renderer.reframe(nullptr, bounds);
+        done = true;
+    }
+}
+
+bool RenderJob::advance(int maxOperations, double maxSeconds) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point deadline = Clock::now()+std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(maxSeconds));
+    int operations = 0;
+    while (!exprStack.empty()) {
+        std::pair<const Rendexpr *, int> &top = exprStack.top();
+        if (const Rendexpr *child = renderContext.step(top.first, top.second++))
+            exprStack.push(std::make_pair(child, 0));
+        else {
+            // An expression completed on first entry was not evaluated from its operands (it is a leaf or its result was cached)
+            completedNodes += top.second == 1 ? nodeCount(top.first) : 1;
+            exprStack.pop();
+            if (exprStack.empty())
+                break;
+            if (maxOperations > 0 && ++operations >= maxOperations)
+                return false;
+            if (maxSeconds > 0 && Clock::now() >= deadline)
+                return false;
+        }
+    }
+    if (!done) {
+        image = renderContext.finish();
+        done = true;
+    }
+    return true;
+}
+
+double RenderJob::progress() const {
+    if (done)
+        return 1;
+    if (root) {
+        std::map<const Rendexpr *, int>::const_iterator it = nodeCounts.find(root.get());
+        if (it != nodeCounts.end() && it->second > 0)
+            return std::min(double(completedNodes)/double(it->second), 1.);
+    }
+    return 0;
+}
+
+int RenderJob::nodeCount(const Rendexpr *expr) {
+    if (!expr)
+        return 1;
+    std::map<const Rendexpr *, int>::const_iterator it = nodeCounts.find(expr);
+    if (it != nodeCounts.end())
+        return it->second;
+    int count = 1;
+    switch (expr->type) {
+        #define VISIT_NODE(T)
+        #define VISIT_CHILD(T, m) \
+            count += nodeCount(static_cast<const T *>(expr)->m.get())
+        RENDER_EXPRESSION_CASES(VISIT_NODE, VISIT_CHILD)
+        #undef VISIT_NODE
+        #undef VISIT_CHILD
+    }
+    return nodeCounts[expr] = count;
+}
+
+}
@@ -0,0 +1,48 @@
+
+#pragma once
+
+#include <map>
+#include <stack>
+#include <utility>
+#include <ode-logic.h>
+#include "../image/Image.h"
+#include "../image/ImageBase.h"
+#include "Renderer.h"
+#include "RenderContext.h"
+
+namespace ode {
+
+/// Renders the component incrementally - the expression tree is evaluated in portions by subsequent calls of advance,
+/// so that the render can be interleaved with other work on the same graphics context or abandoned by destroying the job,
+/// which returns its intermediate framebuffers to the renderer. The component must not be modified until the job is finished
+class RenderJob {
+
+public:
+    RenderJob(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time);
+    RenderJob(const RenderJob &) = delete;
+    RenderJob &operator=(const RenderJob &) = delete;
+    /// Evaluates expressions until the whole tree is evaluated, maxOperations expressions have been evaluated (if positive),
+    /// or maxSeconds have elapsed (if positive) - returns true if the job is finished. Only the time spent issuing the work is measured,
+    /// the GPU may still be processing it when advance returns
+    bool advance(int maxOperations, double maxSeconds);
+    inline bool finished() const { return done; }
+    /// Returns the estimated fraction of the work done, between 0 and 1
+    double progress() const;
+    /// Returns the rendered image once the job is finished
+    inline const PlacedImagePtr &result() const { return image; }
+
+private:
+    Rendexptr root;
+    RenderContext renderContext;
+    std::stack<std::pair<const Rendexpr *, int> > exprStack;
+    /// Number of nodes of the subtree of each expression, with shared subtrees counted for each reference
+    std::map<const Rendexpr *, int> nodeCounts;
+    int completedNodes;
+    bool done;
+    PlacedImagePtr image;
+
+    int nodeCount(const Rendexpr *expr);
+
+};
+
+}
@@ -1,7 +1,6 @@
 
 #include "Renderer.h"
 
-#include <cstring>
 #include <algorithm>
 #include "GradientTexture.h"
 
@@ -32,10 +31,34 @@ static TransformationMatrix animationTransform(Component &component, const Layer
     return result;
 }
 
+// Adjusts channel matrix for a mask whose alpha channel is stored in red and other channels are implicitly white
+static void remapRedIsAlphaChannelMatrix(ChannelMatrix &channelMatrix) {
+    channelMatrix.m[4] += channelMatrix.m[0];
+    channelMatrix.m[4] += channelMatrix.m[1];
+    channelMatrix.m[4] += channelMatrix.m[2];
+    channelMatrix.m[0] = channelMatrix.m[3];
+    channelMatrix.m[1] = 0;
+    channelMatrix.m[2] = 0;
+    channelMatrix.m[3] = 0;
+}
+
+// Alpha only images can be composited with each other into single-channel framebuffers, otherwise they have to be expanded
+static bool keepAlphaOnly(const PlacedImagePtr &image) {
+    return image->transparencyMode() == Image::RED_IS_ALPHA && TextureFrameBufferManager::alphaOnlyFormat() == PixelFormat::R;
+}
+
+static bool keepAlphaOnly(const PlacedImagePtr &a, const PlacedImagePtr &b) {
+    return keepAlphaOnly(a) && keepAlphaOnly(b);
+}
+
 Renderer::Renderer(GraphicsContext &gc) :
     gc(gc),
     textRenderer(gc, tfbManager, billboard, blitShader),
-    effectRenderer(gc, tfbManager, billboard, blitShader),
+    effectRenderer(gc, tfbManager, billboard, blitShader, alphaBlitShader, stats.savedDistanceFieldPasses),
+    effectCache(tfbManager),
+    subtreeCache(tfbManager),
+    stats(),
+    lodThreshold(0),
     compositingShaderRes(CompositingShader::prepare()),
     fillShaderRes(FillShader::prepare())
 {
@@ -45,14 +68,15 @@ Renderer::Renderer(GraphicsContext &gc) :
 
     int pels[4] = { };
     transparentTexture.initialize(BitmapConstRef(PixelFormat::RGBA, pels, 1, 1));
-    memset(pels, 0xff, sizeof(pels));
-    whiteTexture.initialize(BitmapConstRef(PixelFormat::RGBA, pels, 1, 1));
 
     solidColorShader.initialize(compositingShaderRes);
     blitShader.initialize(compositingShaderRes);
+    alphaBlitShader.initialize(compositingShaderRes, 'r');
     mixShader.initialize(compositingShaderRes);
     mixMaskShader.initialize(compositingShaderRes);
+    rectangleMaskShader.initialize(compositingShaderRes);
     alphaMultShader.initialize(compositingShaderRes);
+    unpremultiplyShader.initialize(compositingShaderRes);
 }
 
 PlacedImagePtr Renderer::blend(const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode, bool ignoreSrcAlpha) {
@@ -60,13 +84,16 @@ PlacedImagePtr Renderer::blend(const PlacedImagePtr &dst, const PlacedImagePtr &
         return src;
     if (!src)
         return dst;
+    if (dst->transparencyMode() == Image::RED_IS_ALPHA || src->transparencyMode() == Image::RED_IS_ALPHA) {
+        if (keepAlphaOnly(dst, src) && blendMode == octopus::BlendMode::NORMAL && !ignoreSrcAlpha)
+            return blendAlphaOnly(dst, src);
+        return blend(resolveAlphaChannel(dst), resolveAlphaChannel(src), blendMode, ignoreSrcAlpha);
+    }
 
-    BlendShader &shader = blendShaders[blendMode];
-    if (!shader.ready()) {
-        if (!shader.initialize(compositingShaderRes, BlendShader::blendFunctionSource(blendMode))) {
-            // TODO log error
-            return nullptr;
-        }
+    BlendShader *shader = getBlendShader(blendMode);
+    if (!shader) {
+        // TODO log error
+        return nullptr;
     }
 
     ScaledBounds bounds = dst.bounds()|src.bounds();
@@ -79,10 +106,11 @@ PlacedImagePtr Renderer::blend(const PlacedImagePtr &dst, const PlacedImagePtr &
     TexturePtr srcTex = src->asTexture();
 
     outTex->bind();
-    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
-    shader.bind(pxBounds, bounds, dst.bounds(), src.bounds(), ignoreSrcAlpha);
+    shader->bind(pxBounds, bounds, dst.bounds(), src.bounds(), ignoreSrcAlpha);
+    ++stats.compositingPasses;
     dstTex->bind(BlendShader::UNIT_DST);
     srcTex->bind(BlendShader::UNIT_SRC);
     billboard.draw();
@@ -90,6 +118,35 @@ PlacedImagePtr Renderer::blend(const PlacedImagePtr &dst, const PlacedImagePtr &
     return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), pxBounds);
 }
 
+PlacedImagePtr Renderer::blendAlphaOnly(const PlacedImagePtr &dst, const PlacedImagePtr &src) {
+    ScaledBounds bounds = dst.bounds()|src.bounds();
+    if (!bounds)
+        return nullptr;
+    PixelBounds pxBounds = outerPixelBounds(bounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, PixelFormat::R);
+
+    TexturePtr dstTex = dst->asTexture();
+    TexturePtr srcTex = src->asTexture();
+
+    // Union of coverage (normal blending of the red channel) by fixed function blending
+    outTex->bind();
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    blitShader.bind(pxBounds, dst.bounds(), dst.bounds());
+    ++stats.compositingPasses;
+    dstTex->bind(BlitShader::UNIT_IN);
+    billboard.draw();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_COLOR);
+    blitShader.bind(pxBounds, src.bounds(), src.bounds());
+    srcTex->bind(BlitShader::UNIT_IN);
+    billboard.draw();
+    glDisable(GL_BLEND);
+    outTex->unbind();
+    return PlacedImagePtr(Image::fromTexture(outTex, Image::RED_IS_ALPHA), pxBounds);
+}
+
 PlacedImagePtr Renderer::blend(const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode) {
     return blend(dst, src, blendMode, false);
 }
@@ -101,37 +158,34 @@ PlacedImagePtr Renderer::blendIgnoreAlpha(const PlacedImagePtr &dst, const Place
 PlacedImagePtr Renderer::mask(const PlacedImagePtr &image, const PlacedImagePtr &mask, ChannelMatrix channelMatrix) {
     if (!image || !mask)
         return nullptr;
+    bool alphaOnly = image->transparencyMode() == Image::RED_IS_ALPHA;
+    if (alphaOnly && !keepAlphaOnly(image))
+        return this->mask(resolveAlphaChannel(image), mask, channelMatrix);
 
     ScaledBounds bounds = image.bounds()&mask.bounds();
     if (!bounds)
         return nullptr;
     PixelBounds pxBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA);
 
     TexturePtr imageTex = image->asTexture();
     TexturePtr maskTex = mask->asTexture();
 
-    if (mask->transparencyMode() == Image::RED_IS_ALPHA) {
-        channelMatrix.m[4] += channelMatrix.m[0];
-        channelMatrix.m[4] += channelMatrix.m[1];
-        channelMatrix.m[4] += channelMatrix.m[2];
-        channelMatrix.m[0] = channelMatrix.m[3];
-        channelMatrix.m[1] = 0;
-        channelMatrix.m[2] = 0;
-        channelMatrix.m[3] = 0;
-    }
+    if (mask->transparencyMode() == Image::RED_IS_ALPHA)
+        remapRedIsAlphaChannelMatrix(channelMatrix);
 
     outTex->bind();
-    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
     mixMaskShader.bind(pxBounds, bounds, bounds, image.bounds(), mask.bounds(), channelMatrix);
+    ++stats.compositingPasses;
     transparentTexture.bind(MixMaskShader::UNIT_A);
     imageTex->bind(MixMaskShader::UNIT_B);
     maskTex->bind(MixMaskShader::UNIT_MASK);
     billboard.draw();
     outTex->unbind();
-    return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), pxBounds);
+    return PlacedImagePtr(Image::fromTexture(outTex, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
 }
 
 PlacedImagePtr Renderer::mixMask(const PlacedImagePtr &a, const PlacedImagePtr &b, const PlacedImagePtr &mask, ChannelMatrix channelMatrix) {
@@ -147,38 +201,129 @@ PlacedImagePtr Renderer::mixMask(const PlacedImagePtr &a, const PlacedImagePtr &
         channelMatrix.m[4] = 1-channelMatrix.m[4];
         return this->mask(a, mask, channelMatrix);
     }
+    bool alphaOnly = keepAlphaOnly(a, b);
+    if (!alphaOnly && (a->transparencyMode() == Image::RED_IS_ALPHA || b->transparencyMode() == Image::RED_IS_ALPHA))
+        return mixMask(resolveAlphaChannel(a), resolveAlphaChannel(b), mask, channelMatrix);
 
     ScaledBounds bounds = a.bounds()|b.bounds();
     if (!bounds)
         return nullptr;
     PixelBounds pxBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA);
 
     TexturePtr aTex = a->asTexture();
     TexturePtr bTex = b->asTexture();
     TexturePtr maskTex = mask->asTexture();
 
-    if (mask->transparencyMode() == Image::RED_IS_ALPHA) {
-        channelMatrix.m[4] += channelMatrix.m[0];
-        channelMatrix.m[4] += channelMatrix.m[1];
-        channelMatrix.m[4] += channelMatrix.m[2];
-        channelMatrix.m[0] = channelMatrix.m[3];
-        channelMatrix.m[1] = 0;
-        channelMatrix.m[2] = 0;
-        channelMatrix.m[3] = 0;
-    }
+    if (mask->transparencyMode() == Image::RED_IS_ALPHA)
+        remapRedIsAlphaChannelMatrix(channelMatrix);
 
     outTex->bind();
-    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
     mixMaskShader.bind(pxBounds, bounds, a.bounds(), b.bounds(), mask.bounds(), channelMatrix);
+    ++stats.compositingPasses;
     aTex->bind(MixMaskShader::UNIT_A);
     bTex->bind(MixMaskShader::UNIT_B);
     maskTex->bind(MixMaskShader::UNIT_MASK);
     billboard.draw();
     outTex->unbind();
-    return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), pxBounds);
+    return PlacedImagePtr(Image::fromTexture(outTex, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
+}
+
+// Bounds of the rectangle's coverage as if it were rasterized by drawLayerVector
+static ScaledBounds rectangleMaskBounds(const Renderer::RectangleMask &mask) {
+    PixelBounds pxBounds = outerPixelBounds(mask.rectangle)+PixelMargin(1);
+    return ScaledBounds(Vector2d(pxBounds.a), Vector2d(pxBounds.b));
+}
+
+// Returns true if the rectangle fully covers all pixels within bounds (the rectangle shrunk by the corner radius along either axis is never affected by the corners)
+static bool rectangleMaskCovers(const Renderer::RectangleMask &mask, const ScaledBounds &bounds) {
+    ScaledBounds horizontalBand = mask.rectangle, verticalBand = mask.rectangle;
+    horizontalBand.a.y += mask.cornerRadius;
+    horizontalBand.b.y -= mask.cornerRadius;
+    verticalBand.a.x += mask.cornerRadius;
+    verticalBand.b.x -= mask.cornerRadius;
+    return (bounds&horizontalBand) == bounds || (bounds&verticalBand) == bounds;
+}
+
+PlacedImagePtr Renderer::mask(const PlacedImagePtr &image, const RectangleMask &mask, ChannelMatrix channelMatrix) {
+    if (!image)
+        return nullptr;
+    bool alphaOnly = image->transparencyMode() == Image::RED_IS_ALPHA;
+    if (alphaOnly && !keepAlphaOnly(image))
+        return this->mask(resolveAlphaChannel(image), mask, channelMatrix);
+
+    ScaledBounds bounds = image.bounds()&rectangleMaskBounds(mask);
+    if (!bounds)
+        return nullptr;
+    // Coverage is implicitly white, same as a rasterized mask
+    remapRedIsAlphaChannelMatrix(channelMatrix);
+    // Image entirely within the rectangle is unaffected
+    if (channelMatrix.m[0]+channelMatrix.m[4] == 1 && rectangleMaskCovers(mask, image.bounds()))
+        return image;
+    PixelBounds pxBounds = outerPixelBounds(bounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA);
+
+    TexturePtr imageTex = image->asTexture();
+
+    outTex->bind();
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    rectangleMaskShader.bind(pxBounds, bounds, bounds, image.bounds(), mask.rectangle, mask.cornerRadius, channelMatrix.m[0], channelMatrix.m[4]);
+    ++stats.compositingPasses;
+    transparentTexture.bind(RectangleMaskShader::UNIT_A);
+    imageTex->bind(RectangleMaskShader::UNIT_B);
+    billboard.draw();
+    outTex->unbind();
+    return PlacedImagePtr(Image::fromTexture(outTex, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
+}
+
+PlacedImagePtr Renderer::mixMask(const PlacedImagePtr &a, const PlacedImagePtr &b, const RectangleMask &mask, ChannelMatrix channelMatrix) {
+    if (!a)
+        return this->mask(b, mask, channelMatrix);
+    if (!b) {
+        channelMatrix.m[0] = -channelMatrix.m[0];
+        channelMatrix.m[1] = -channelMatrix.m[1];
+        channelMatrix.m[2] = -channelMatrix.m[2];
+        channelMatrix.m[3] = -channelMatrix.m[3];
+        channelMatrix.m[4] = 1-channelMatrix.m[4];
+        return this->mask(a, mask, channelMatrix);
+    }
+    bool alphaOnly = keepAlphaOnly(a, b);
+    if (!alphaOnly && (a->transparencyMode() == Image::RED_IS_ALPHA || b->transparencyMode() == Image::RED_IS_ALPHA))
+        return mixMask(resolveAlphaChannel(a), resolveAlphaChannel(b), mask, channelMatrix);
+
+    remapRedIsAlphaChannelMatrix(channelMatrix);
+    ScaledBounds bounds = a.bounds()|b.bounds();
+    if (!bounds)
+        return nullptr;
+    if (channelMatrix.m[0]+channelMatrix.m[4] == 1 && rectangleMaskCovers(mask, bounds))
+        return b;
+    // Without bias, b does not contribute outside of the rectangle
+    if (channelMatrix.m[4] == 0) {
+        ScaledBounds bBounds = b.bounds()&rectangleMaskBounds(mask);
+        bounds = bBounds ? a.bounds()|bBounds : a.bounds();
+    }
+    PixelBounds pxBounds = outerPixelBounds(bounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA);
+
+    TexturePtr aTex = a->asTexture();
+    TexturePtr bTex = b->asTexture();
+
+    outTex->bind();
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    rectangleMaskShader.bind(pxBounds, bounds, a.bounds(), b.bounds(), mask.rectangle, mask.cornerRadius, channelMatrix.m[0], channelMatrix.m[4]);
+    ++stats.compositingPasses;
+    aTex->bind(RectangleMaskShader::UNIT_A);
+    bTex->bind(RectangleMaskShader::UNIT_B);
+    billboard.draw();
+    outTex->unbind();
+    return PlacedImagePtr(Image::fromTexture(outTex, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
 }
 
 PlacedImagePtr Renderer::mix(const PlacedImagePtr &a, const PlacedImagePtr &b, double ratio) {
@@ -190,26 +335,30 @@ PlacedImagePtr Renderer::mix(const PlacedImagePtr &a, const PlacedImagePtr &b, d
         return multiplyAlpha(b, ratio);
     if (!b)
         return multiplyAlpha(a, 1-ratio);
+    bool alphaOnly = keepAlphaOnly(a, b);
+    if (!alphaOnly && (a->transparencyMode() == Image::RED_IS_ALPHA || b->transparencyMode() == Image::RED_IS_ALPHA))
+        return mix(resolveAlphaChannel(a), resolveAlphaChannel(b), ratio);
 
     ScaledBounds bounds = a.bounds()|b.bounds();
     if (!bounds)
         return nullptr;
     PixelBounds pxBounds = outerPixelBounds(bounds);
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA);
 
     TexturePtr aTex = a->asTexture();
     TexturePtr bTex = b->asTexture();
 
     outTex->bind();
-    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
     mixShader.bind(pxBounds, bounds, a.bounds(), b.bounds(), float(ratio));
+    ++stats.compositingPasses;
     aTex->bind(MixShader::UNIT_A);
     bTex->bind(MixShader::UNIT_B);
     billboard.draw();
     outTex->unbind();
-    return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), pxBounds);
+    return PlacedImagePtr(Image::fromTexture(outTex, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
 }
 
 PlacedImagePtr Renderer::multiplyAlpha(const PlacedImagePtr &image, double multiplier) {
@@ -217,74 +366,426 @@ PlacedImagePtr Renderer::multiplyAlpha(const PlacedImagePtr &image, double multi
         return nullptr;
     if (multiplier == 1)
         return image;
+    bool alphaOnly = image->transparencyMode() == Image::RED_IS_ALPHA;
+    if (alphaOnly && !keepAlphaOnly(image))
+        return multiplyAlpha(resolveAlphaChannel(image), multiplier);
 
     PixelBounds pxBounds = outerPixelBounds(image.bounds());
-    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds, alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA);
 
     TexturePtr tex = image->asTexture();
 
     outTex->bind();
-    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
     alphaMultShader.bind(pxBounds, image.bounds(), image.bounds(), float(multiplier));
+    ++stats.compositingPasses;
     tex->bind(AlphaMultShader::UNIT_IN);
     billboard.draw();
     outTex->unbind();
+    return PlacedImagePtr(Image::fromTexture(outTex, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
+}
+
+PlacedImagePtr Renderer::composite(const CompositingChain &chain, const std::vector<PlacedImagePtr> &inputs) {
+    const std::vector<CompositingChain::Node> &chainNodes = chain.nodes();
+    ODE_ASSERT(!chainNodes.empty() && inputs.size() == chain.inputs().size());
+
+    // Alpha only inputs are only supported as masks, other operands must be expanded
+    std::vector<PlacedImagePtr> images(inputs);
+    for (const CompositingChain::Node &node : chainNodes) {
+        if (node.operation == CompositingChain::INPUT)
+            continue;
+        for (int i = 0, n = node.operation == CompositingChain::MASK || node.operation == CompositingChain::MULTIPLY_ALPHA ? 1 : 2; i < n; ++i) {
+            const CompositingChain::Node &operand = chainNodes[node.operands[i]];
+            if (operand.operation == CompositingChain::INPUT && images[operand.operands[0]] && images[operand.operands[0]]->transparencyMode() == Image::RED_IS_ALPHA)
+                images[operand.operands[0]] = resolveAlphaChannel(images[operand.operands[0]]);
+        }
+    }
+
+    // Resolve the bounds of each node's result with the same shortcuts as the individual operations
+    // passthrough >= 0 means that the node's result is exactly the image of that input,
+    // alphaOnly means that the individual operations would keep the result in the alpha only format
+    struct NodeResult {
+        ScaledBounds bounds;
+        bool empty;
+        int passthrough;
+        bool alphaOnly;
+    };
+    std::vector<NodeResult> results(chainNodes.size());
+    int passes = 0;
+    long long intermediatePixels = 0;
+    for (size_t k = 0; k < chainNodes.size(); ++k) {
+        const CompositingChain::Node &node = chainNodes[k];
+        const NodeResult &a = results[node.operands[0]];
+        const NodeResult &b = results[node.operands[1]];
+        const NodeResult &c = results[node.operands[2]];
+        NodeResult &result = results[k];
+        result = NodeResult { ScaledBounds(0, 0, 0, 0), true, -1, false };
+        switch (node.operation) {
+            case CompositingChain::INPUT:
+                if (images[node.operands[0]])
+                    result = NodeResult { images[node.operands[0]].bounds(), false, node.operands[0], keepAlphaOnly(inputs[node.operands[0]]) };
+                continue;
+            case CompositingChain::BLEND:
+            case CompositingChain::BLEND_IGNORE_ALPHA:
+                if (a.empty)
+                    result = b;
+                else if (b.empty)
+                    result = a;
+                else {
+                    result.bounds = a.bounds|b.bounds;
+                    result.alphaOnly = a.alphaOnly && b.alphaOnly && node.operation == CompositingChain::BLEND && node.blendMode == octopus::BlendMode::NORMAL;
+                }
+                break;
+            case CompositingChain::MASK:
+                if (!(a.empty || b.empty)) {
+                    result.bounds = a.bounds&b.bounds;
+                    result.alphaOnly = a.alphaOnly;
+                }
+                break;
+            case CompositingChain::MIX_MASK:
+                if (c.empty) {
+                    if (a.empty)
+                        result.bounds = b.bounds;
+                    else if (b.empty)
+                        result.bounds = a.bounds;
+                    else
+                        result.bounds = a.bounds|b.bounds;
+                } else if (a.empty) {
+                    if (!b.empty)
+                        result.bounds = b.bounds&c.bounds;
+                } else if (b.empty)
+                    result.bounds = a.bounds&c.bounds;
+                else
+                    result.bounds = a.bounds|b.bounds;
+                result.alphaOnly = (a.empty || a.alphaOnly) && (b.empty || b.alphaOnly);
+                break;
+            case CompositingChain::MIX:
+                if (node.parameter == 0)
+                    result = a;
+                else if (node.parameter == 1)
+                    result = b;
+                else {
+                    if (a.empty)
+                        result.bounds = b.bounds;
+                    else if (b.empty)
+                        result.bounds = a.bounds;
+                    else
+                        result.bounds = a.bounds|b.bounds;
+                    result.alphaOnly = (a.empty || a.alphaOnly) && (b.empty || b.alphaOnly);
+                }
+                break;
+            case CompositingChain::MULTIPLY_ALPHA:
+                if (node.parameter == 1)
+                    result = a;
+                else if (node.parameter != 0 && !a.empty) {
+                    result.bounds = a.bounds;
+                    result.alphaOnly = a.alphaOnly;
+                }
+                break;
+        }
+        if (result.passthrough < 0) {
+            if (result.bounds) {
+                // Intermediate results are pixel-aligned
+                PixelBounds pxBounds = outerPixelBounds(result.bounds);
+                result.bounds = ScaledBounds(Vector2d(pxBounds.a), Vector2d(pxBounds.b));
+                result.empty = false;
+                if (k+1 < chainNodes.size())
+                    intermediatePixels += (long long) pxBounds.dimensions().x*pxBounds.dimensions().y;
+                ++passes;
+            } else
+                result = NodeResult { ScaledBounds(0, 0, 0, 0), true, -1, false };
+        }
+    }
+    const NodeResult &rootResult = results.back();
+    // The input is returned in its original format, same as by the individual operations' shortcuts
+    if (rootResult.passthrough >= 0)
+        return inputs[rootResult.passthrough];
+    if (rootResult.empty)
+        return nullptr;
+    // The fused shader only produces premultiplied results - chains which would remain alpha only are evaluated by the individual operations
+    if (rootResult.alphaOnly)
+        return compositeSeparately(chain, inputs);
+
+    FusedCompositingShader &shader = fusedCompositingShaders[chain.signature()];
+    if (!shader.ready()) {
+        if (!shader.initialize(compositingShaderRes, chain)) {
+            // TODO log error
+            return nullptr;
+        }
+    }
+
+    ScaledBounds bounds = rootResult.bounds;
+    PixelBounds pxBounds = outerPixelBounds(bounds);
+    TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
+
+    std::vector<TexturePtr> inputTextures(images.size());
+    std::vector<ScaledBounds> inputBounds(images.size(), bounds);
+    for (size_t i = 0; i < images.size(); ++i) {
+        if (images[i]) {
+            inputTextures[i] = images[i]->asTexture();
+            inputBounds[i] = images[i].bounds();
+        }
+    }
+    std::vector<CompositingChain::Node> nodes(chainNodes);
+    std::vector<ScaledBounds> nodeBounds(nodes.size());
+    for (size_t k = 0; k < nodes.size(); ++k) {
+        CompositingChain::Node &node = nodes[k];
+        nodeBounds[k] = results[k].empty ? ScaledBounds(0, 0, 0, 0) : results[k].bounds;
+        // Source alpha is only ignored if both operands are present, otherwise the other operand is passed through unchanged
+        if (node.operation == CompositingChain::BLEND_IGNORE_ALPHA)
+            node.parameter = !(results[node.operands[0]].empty || results[node.operands[1]].empty);
+        int maskNode = node.operation == CompositingChain::MASK ? node.operands[1] : node.operation == CompositingChain::MIX_MASK ? node.operands[2] : -1;
+        if (maskNode >= 0 && results[maskNode].passthrough >= 0) {
+            if (images[results[maskNode].passthrough]->transparencyMode() == Image::RED_IS_ALPHA)
+                remapRedIsAlphaChannelMatrix(node.channelMatrix);
+        }
+    }
+
+    outTex->bind();
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    shader.bind(pxBounds, bounds, inputBounds, nodes, nodeBounds);
+    for (size_t i = 0; i < inputTextures.size(); ++i) {
+        if (inputTextures[i])
+            inputTextures[i]->bind(int(i));
+        else
+            transparentTexture.bind(int(i));
+    }
+    billboard.draw();
+    outTex->unbind();
+
+    ++stats.compositingPasses;
+    ++stats.fusedPasses;
+    stats.savedPasses += passes-1;
+    stats.savedPixels += intermediatePixels;
     return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), pxBounds);
 }
 
-PlacedImagePtr Renderer::drawLayerBody(Component &component, const LayerInstanceSpecifier &layer, double scale, double time) {
-    return drawLayerVector(component, layer, Rasterizer::BODY, scale, time);
+PlacedImagePtr Renderer::compositeSeparately(const CompositingChain &chain, const std::vector<PlacedImagePtr> &inputs) {
+    const std::vector<CompositingChain::Node> &chainNodes = chain.nodes();
+    std::vector<PlacedImagePtr> results(chainNodes.size());
+    for (size_t k = 0; k < chainNodes.size(); ++k) {
+        const CompositingChain::Node &node = chainNodes[k];
+        const PlacedImagePtr &a = results[node.operands[0]];
+        const PlacedImagePtr &b = results[node.operands[1]];
+        const PlacedImagePtr &c = results[node.operands[2]];
+        switch (node.operation) {
+            case CompositingChain::INPUT:
+                results[k] = inputs[node.operands[0]];
+                break;
+            case CompositingChain::BLEND:
+                results[k] = blend(a, b, node.blendMode);
+                break;
+            case CompositingChain::BLEND_IGNORE_ALPHA:
+                results[k] = blendIgnoreAlpha(a, b, node.blendMode);
+                break;
+            case CompositingChain::MASK:
+                results[k] = mask(a, b, node.channelMatrix);
+                break;
+            case CompositingChain::MIX_MASK:
+                results[k] = mixMask(a, b, c, node.channelMatrix);
+                break;
+            case CompositingChain::MIX:
+                results[k] = mix(a, b, node.parameter);
+                break;
+            case CompositingChain::MULTIPLY_ALPHA:
+                results[k] = multiplyAlpha(a, node.parameter);
+                break;
+        }
+    }
+    return results.back();
+}
+
+BlendShader *Renderer::getBlendShader(octopus::BlendMode blendMode) {
+    BlendShader &shader = blendShaders[blendMode];
+    if (shader.ready() || shader.initialize(compositingShaderRes, BlendShader::blendFunctionSource(blendMode)))
+        return &shader;
+    return nullptr;
+}
+
+GradientFillShader *Renderer::getGradientFillShader(octopus::Gradient::Type type) {
+    GradientFillShader &shader = gradientFillShaders[type];
+    if (shader.ready() || shader.initialize(fillShaderRes, GradientFillShader::shapeFunctionSource(type)))
+        return &shader;
+    return nullptr;
+}
+
+ImageFillShader *Renderer::getImageFillShader() {
+    ImageFillShader &shader = imageFillShaders[0];
+    if (shader.ready() || shader.initialize(fillShaderRes))
+        return &shader;
+    return nullptr;
 }
 
-PlacedImagePtr Renderer::drawLayerStroke(Component &component, const LayerInstanceSpecifier &layer, int index, double scale, double time) {
-    return drawLayerVector(component, layer, index, scale, time);
+bool Renderer::isRectangleEffectBasis(const LayerInstanceSpecifier &layer, const octopus::Effect &effect) {
+    switch (effect.type) {
+        case octopus::Effect::Type::DROP_SHADOW:
+        case octopus::Effect::Type::INNER_SHADOW:
+        case octopus::Effect::Type::OUTER_GLOW:
+        case octopus::Effect::Type::INNER_GLOW:
+            break;
+        default:
+            return false;
+    }
+    if (!(layer->shape.has_value() && layer->shape->path.has_value() && layer->shape->path->type == octopus::Path::Type::RECTANGLE))
+        return false;
+    if (effect.basis == octopus::EffectBasis::BODY_AND_STROKES) {
+        // Inside strokes do not extend the facet
+        for (const octopus::Shape::Stroke &stroke : layer->shape->strokes) {
+            if (stroke.visible && stroke.position != octopus::Stroke::Position::INSIDE)
+                return false;
+        }
+        return true;
+    }
+    return effect.basis == octopus::EffectBasis::BODY;
 }
 
-PlacedImagePtr Renderer::drawLayerFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, double scale, double time) {
+bool Renderer::getRectangleMask(Component &component, const LayerInstanceSpecifier &layer, double scale, double time, RectangleMask &rectangleMask) {
+    if (Result<Rasterizer::Shape *, DesignError> shape = component.getLayerShape(layer->id)) {
+        if (shape.value()) {
+            TransformationMatrix layerTransform = TransformationMatrix::scale(scale)*layer.parentTransform*TransformationMatrix(layer->transform)*animationTransform(component, layer, time);
+            Rectangle<double> rectangle;
+            if (Rasterizer::getRoundedRectangle(shape.value(), layerTransform, rectangle, rectangleMask.cornerRadius)) {
+                rectangleMask.rectangle = ScaledBounds(rectangle.a, rectangle.b);
+                return bool(rectangleMask.rectangle);
+            }
+        }
+    }
+    return false;
+}
+
+PlacedImagePtr Renderer::drawLayerBody(Component &component, const LayerInstanceSpecifier &layer, const ScaledBounds &visibleBounds, double scale, double time) {
+    return drawLayerVector(component, layer, Rasterizer::BODY, visibleBounds, scale, time);
+}
+
+PlacedImagePtr Renderer::drawLayerStroke(Component &component, const LayerInstanceSpecifier &layer, int index, const ScaledBounds &visibleBounds, double scale, double time) {
+    return drawLayerVector(component, layer, index, visibleBounds, scale, time);
+}
+
+PlacedImagePtr Renderer::drawLayerFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const ScaledBounds &visibleBounds, double scale, double time, bool physicalMemory) {
     if (layer->shape.has_value() && index < int(layer->shape->fills.size()))
-        return drawFill(component, layer, imageBase, layer->shape->fills[index], scale, time);
+        return drawFill(component, layer, imageBase, layer->shape->fills[index], visibleBounds, scale, time, physicalMemory);
     return nullptr;
 }
 
-PlacedImagePtr Renderer::drawLayerStrokeFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, double scale, double time) {
+PlacedImagePtr Renderer::drawLayerStrokeFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const ScaledBounds &visibleBounds, double scale, double time, bool physicalMemory) {
     if (layer->shape.has_value() && index < int(layer->shape->strokes.size()))
-        return drawFill(component, layer, imageBase, layer->shape->strokes[index].fill, scale, time);
+        return drawFill(component, layer, imageBase, layer->shape->strokes[index].fill, visibleBounds, scale, time, physicalMemory);
     return nullptr;
 }
 
-PlacedImagePtr Renderer::drawLayerText(Component &component, const LayerInstanceSpecifier &layer, double scale, double time) {
-    return textRenderer.drawLayerText(component, layer, ScaledBounds::infinite, scale, time);
+PlacedImagePtr Renderer::drawLayerText(Component &component, const LayerInstanceSpecifier &layer, const ScaledBounds &visibleBounds, double scale, double time) {
+    return textRenderer.drawLayerText(component, layer, visibleBounds, scale, time);
 }
 
-PlacedImagePtr Renderer::drawLayerEffect(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const PlacedImagePtr &basis, double scale, double time) {
+PlacedImagePtr Renderer::drawLayerEffect(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const PlacedImagePtr &basis, const ScaledBounds &visibleBounds, double scale, double time) {
     ODE_ASSERT(index >= 0 && index < (int) layer->effects.size());
     const octopus::Effect &effect = layer->effects[index];
     if (effect.type == octopus::Effect::Type::OVERLAY) {
         if (effect.overlay.has_value())
-            return drawFill(component, layer, imageBase, effect.overlay.value(), scale, time);
-    } else
-        return effectRenderer.drawEffect(effect, basis, scale*layer.parentFeatureScale*layer->featureScale.value_or(1));
+            return drawFill(component, layer, imageBase, effect.overlay.value(), visibleBounds, scale, time);
+    } else {
+        double effectScale = scale*layer.parentFeatureScale*layer->featureScale.value_or(1);
+        // A basis restricted to visible bounds is incomplete, so the result must not be cached,
+        // and the analytic rectangle effect is skipped as its output would not be restricted
+        bool complete = visibleBounds == ScaledBounds::infinite;
+        EffectCache::Key cacheKey;
+        Vector2d translation;
+        bool cacheable = complete && getEffectCacheKey(component, layer, index, scale, effectScale, time, cacheKey, translation);
+        if (cacheable) {
+            if (PlacedImagePtr result = effectCache.find(cacheKey, translation))
+                return result;
+        }
+        PlacedImagePtr result;
+        RectangleMask rectangle;
+        if (complete && isRectangleEffectBasis(layer, effect) && getRectangleMask(component, layer, scale, time, rectangle))
+            result = effectRenderer.drawRectangleEffect(effect, basis, rectangle.rectangle, rectangle.cornerRadius, effectScale);
+        else
+            result = effectRenderer.drawEffect(effect, basis, effectScale);
+        if (cacheable)
+            effectCache.store(cacheKey, translation, result);
+        return result;
+    }
     return nullptr;
 }
 
+bool Renderer::getEffectCacheKey(Component &component, const LayerInstanceSpecifier &layer, int index, double scale, double effectScale, double time, EffectCache::Key &key, Vector2d &translation) {
+    const octopus::Effect &effect = layer->effects[index];
+    bool resamplable = false;
+    switch (effect.type) {
+        case octopus::Effect::Type::STROKE:
+            break;
+        case octopus::Effect::Type::DROP_SHADOW:
+        case octopus::Effect::Type::INNER_SHADOW:
+            resamplable = effect.shadow.has_value() && fabs(effectScale*effect.shadow->blur) >= 1;
+            break;
+        case octopus::Effect::Type::OUTER_GLOW:
+        case octopus::Effect::Type::INNER_GLOW:
+            resamplable = effect.glow.has_value() && fabs(effectScale*effect.glow->blur) >= 1;
+            break;
+        default:
+            return false;
+    }
+    // The basis must be the layer's own shape, which is identified by the layer's content serial along with the effect itself
+    if (!(layer->shape.has_value() && (effect.basis == octopus::EffectBasis::BODY || effect.basis == octopus::EffectBasis::BODY_AND_STROKES)))
+        return false;
+    TransformationMatrix layerTransform = TransformationMatrix::scale(scale)*layer.parentTransform*TransformationMatrix(layer->transform)*animationTransform(component, layer, time);
+    key.componentId = component.uniqueId();
+    key.revision = component.revision();
+    key.layerId = layer->id;
+    key.contentSerial = component.layerContentSerial(layer->id);
+    key.effectIndex = index;
+    key.scale = effectScale;
+    key.linearTransform[0] = layerTransform[0][0];
+    key.linearTransform[1] = layerTransform[0][1];
+    key.linearTransform[2] = layerTransform[1][0];
+    key.linearTransform[3] = layerTransform[1][1];
+    translation = Vector2d(layerTransform[2][0], layerTransform[2][1]);
+    // Sharp results are only reused at the same subpixel position - blurred ones may be resampled
+    key.subpixelTranslation = resamplable ? Vector2d() : Vector2d(translation.x-floor(translation.x), translation.y-floor(translation.y));
+    key.quality = effectRenderer.getQuality();
+    key.detailThreshold = lodThreshold;
+    return true;
+}
+
 PlacedImagePtr Renderer::applyFilter(const octopus::Filter &filter, const PlacedImagePtr &basis) {
     // TODO
     return basis;
 }
 
+PlacedImagePtr Renderer::drawApproximation(const ScaledBounds &bounds, const Color &color) {
+    PixelBounds pxBounds = outerPixelBounds(bounds);
+    if (!(pxBounds && color.a > 0))
+        return nullptr;
+    // The image only spans a few pixels, so it is computed directly in physical memory
+    Bitmap bitmap(PixelFormat::PREMULTIPLIED_RGBA, pxBounds.dimensions());
+    for (int y = pxBounds.a.y; y < pxBounds.b.y; ++y) {
+        for (int x = pxBounds.a.x; x < pxBounds.b.x; ++x) {
+            double coverage = std::max(std::min(bounds.b.x, x+1.)-std::max(bounds.a.x, double(x)), 0.)*std::max(std::min(bounds.b.y, y+1.)-std::max(bounds.a.y, double(y)), 0.);
+            byte *pixel = reinterpret_cast<byte *>(bitmap(x-pxBounds.a.x, y-pxBounds.a.y));
+            pixel[0] = channelFloatToByte(coverage*color.r);
+            pixel[1] = channelFloatToByte(coverage*color.g);
+            pixel[2] = channelFloatToByte(coverage*color.b);
+            pixel[3] = channelFloatToByte(coverage*color.a);
+        }
+    }
+    return PlacedImagePtr(Image::fromBitmap((Bitmap &&) bitmap, Image::PREMULTIPLIED), pxBounds);
+}
+
 PlacedImagePtr Renderer::reframe(const PlacedImagePtr &image, const PixelBounds &bounds) {
     ScaledBounds sBounds((Vector2d) bounds.a, (Vector2d) bounds.b);
     TextureFrameBufferPtr outTex = tfbManager.acquireExact(bounds);
     TexturePtr tex = image ? image->asTexture() : nullptr;
 
     outTex->bind();
-    glViewport(0, 0, bounds.dimensions().x, bounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, bounds.dimensions().x, bounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
     if (tex) {
-        blitShader.bind(bounds-bounds.a, sBounds, image.bounds());
+        blitShader.bind(bounds, sBounds, image.bounds());
         tex->bind(BlitShader::UNIT_IN);
         billboard.draw();
     }
@@ -300,10 +801,10 @@ void Renderer::screenDraw(const PixelBounds &viewport, const PlacedImagePtr &ima
         return; // TODO log error
 
     gc.bindOutputFramebuffer();
-    glViewport(viewport.a.x, viewport.a.y, viewport.dimensions().x, viewport.dimensions().y);
+    GLStateCache::viewport(viewport.a.x, viewport.a.y, viewport.dimensions().x, viewport.dimensions().y);
     glEnable(GL_BLEND);
     glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
-    glClearColor(float(bgColor.r), float(bgColor.g), float(bgColor.b), float(bgColor.a));
+    GLStateCache::clearColor(float(bgColor.r), float(bgColor.g), float(bgColor.b), float(bgColor.a));
     glClear(GL_COLOR_BUFFER_BIT);
     PixelBounds bottomUpViewport = viewport;
     bottomUpViewport.a.y = viewport.b.y;
@@ -314,8 +815,105 @@ void Renderer::screenDraw(const PixelBounds &viewport, const PlacedImagePtr &ima
     glDisable(GL_BLEND);
 }
 
+bool Renderer::readback(TextureReadback &readback, const PlacedImagePtr &image, PixelFormat format) {
+    // The texture may be reused as soon as the transfer is initiated
+    TexturePtr tex = convertForTransfer(image, format);
+    return tex && readback.start(*tex, format);
+}
+
+bool Renderer::download(const SparseBitmapRef &bitmap, const PlacedImagePtr &image) {
+    TexturePtr tex = convertForTransfer(image, bitmap.format);
+    return tex && tex->download(bitmap);
+}
+
 void Renderer::cleanUp() {
-    tfbManager = TextureFrameBufferManager();
+    effectRenderer.releaseDistanceFields();
+    effectCache.clear();
+    subtreeCache.clear();
+    tfbManager.clear();
+}
+
+bool Renderer::warmUp() {
+    static const octopus::BlendMode BLEND_MODES[] = {
+        octopus::BlendMode::NORMAL,
+        octopus::BlendMode::MULTIPLY,
+        octopus::BlendMode::SCREEN,
+        octopus::BlendMode::LINEAR_DODGE,
+        octopus::BlendMode::LINEAR_BURN,
+        octopus::BlendMode::COLOR_DODGE,
+        octopus::BlendMode::COLOR_BURN,
+        octopus::BlendMode::SUBTRACT,
+        octopus::BlendMode::DIFFERENCE,
+        octopus::BlendMode::EXCLUSION,
+        octopus::BlendMode::DIVIDE,
+        octopus::BlendMode::DARKEN,
+        octopus::BlendMode::LIGHTEN,
+        octopus::BlendMode::DARKER_COLOR,
+        octopus::BlendMode::LIGHTER_COLOR,
+        octopus::BlendMode::OVERLAY,
+        octopus::BlendMode::SOFT_LIGHT,
+        octopus::BlendMode::HARD_LIGHT,
+        octopus::BlendMode::VIVID_LIGHT,
+        octopus::BlendMode::LINEAR_LIGHT,
+        octopus::BlendMode::PIN_LIGHT,
+        octopus::BlendMode::HARD_MIX,
+        octopus::BlendMode::HUE,
+        octopus::BlendMode::SATURATION,
+        octopus::BlendMode::COLOR,
+        octopus::BlendMode::LUMINOSITY
+    };
+    static const octopus::Gradient::Type GRADIENT_TYPES[] = {
+        octopus::Gradient::Type::LINEAR,
+        octopus::Gradient::Type::RADIAL,
+        octopus::Gradient::Type::ANGULAR,
+        octopus::Gradient::Type::DIAMOND
+    };
+    // Fused compositing shaders cannot be warmed up as they depend on the structure of the rendered design
+    bool ok = true;
+    for (octopus::BlendMode blendMode : BLEND_MODES)
+        ok &= getBlendShader(blendMode) != nullptr;
+    for (octopus::Gradient::Type type : GRADIENT_TYPES)
+        ok &= getGradientFillShader(type) != nullptr;
+    ok &= getImageFillShader() != nullptr;
+    ok &= effectRenderer.warmUp();
+    return ok;
+}
+
+void Renderer::setEffectQuality(EffectQuality quality) {
+    effectRenderer.setQuality(quality);
+}
+
+EffectQuality Renderer::effectQuality() const {
+    return effectRenderer.getQuality();
+}
+
+void Renderer::setDetailThreshold(double pixels) {
+    lodThreshold = pixels;
+}
+
+double Renderer::detailThreshold() const {
+    return lodThreshold;
+}
+
+void Renderer::reportPeakMemory(long long unscheduledPeak, long long scheduledPeak) {
+    stats.unscheduledPeakMemory = std::max(stats.unscheduledPeakMemory, unscheduledPeak);
+    stats.scheduledPeakMemory = std::max(stats.scheduledPeakMemory, scheduledPeak);
+}
+
+void Renderer::reportCpuOperation() {
+    ++stats.cpuOperations;
+}
+
+Renderer::Statistics Renderer::statistics() const {
+    Statistics result = stats;
+    result.glStateChanges = GLStateCache::statistics().issuedCalls;
+    result.skippedGlStateChanges = GLStateCache::statistics().skippedCalls;
+    return result;
+}
+
+void Renderer::resetStatistics() {
+    stats = Statistics();
+    GLStateCache::resetStatistics();
 }
 
 // TODO DEPRECATE
@@ -331,35 +929,54 @@ PlacedImagePtr Renderer::resolveAlphaChannel(const PlacedImagePtr &image) {
     TexturePtr maskTex = image->asTexture();
 
     outTex->bind();
-    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-    glClearColor(0, 0, 0, 0);
+    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+    GLStateCache::clearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
-    mixMaskShader.bind(pxBounds, image.bounds(), image.bounds(), image.bounds(), image.bounds(), ChannelMatrix { { 1, 0, 0, 0, 0 } });
-    transparentTexture.bind(MixMaskShader::UNIT_A);
-    whiteTexture.bind(MixMaskShader::UNIT_B);
-    maskTex->bind(MixMaskShader::UNIT_MASK);
+    alphaBlitShader.bind(pxBounds, image.bounds(), image.bounds());
+    maskTex->bind(BlitShader::UNIT_IN);
     billboard.draw();
     outTex->unbind();
     return PlacedImagePtr(Image::fromTexture(outTex, Image::PREMULTIPLIED), pxBounds);
 }
 
-PlacedImagePtr Renderer::drawLayerVector(Component &component, const LayerInstanceSpecifier &layer, int strokeIndex, double scale, double time) {
+TexturePtr Renderer::convertForTransfer(const PlacedImagePtr &image, PixelFormat format) {
+    if (!image)
+        return nullptr;
+    PlacedImagePtr rgbaImage = image->transparencyMode() == Image::RED_IS_ALPHA ? resolveAlphaChannel(image) : image;
+    TexturePtr tex = rgbaImage ? rgbaImage->asTexture() : nullptr;
+    if (!(tex && format == PixelFormat::RGBA && rgbaImage->transparencyMode() == Image::PREMULTIPLIED))
+        return tex;
+
+    PixelBounds bounds(Vector2i(), tex->dimensions());
+    ScaledBounds sBounds((Vector2d) bounds.a, (Vector2d) bounds.b);
+    TextureFrameBufferPtr outTex = tfbManager.acquireExact(bounds);
+    outTex->bind();
+    GLStateCache::viewport(0, 0, bounds.dimensions().x, bounds.dimensions().y);
+    unpremultiplyShader.bind(bounds, sBounds, sBounds);
+    tex->bind(UnpremultiplyShader::UNIT_IN);
+    billboard.draw();
+    outTex->unbind();
+    return outTex;
+}
+
+PlacedImagePtr Renderer::drawLayerVector(Component &component, const LayerInstanceSpecifier &layer, int strokeIndex, const ScaledBounds &visibleBounds, double scale, double time) {
     if (Result<Rasterizer::Shape *, DesignError> shape = component.getLayerShape(layer->id)) {
-        if (Result<LayerBounds, DesignError> layerBounds = component.getLayerBounds(layer->id)) {
+        if (shape.value()) {
             TransformationMatrix animationMatrix = animationTransform(component, layer, time);
             TransformationMatrix layerTransform = TransformationMatrix::scale(scale)*layer.parentTransform*TransformationMatrix(layer->transform)*animationMatrix;
-            if (PixelBounds bounds = outerPixelBounds(scaleBounds(transformBounds(layerBounds.value().untransformedBounds, layerTransform), 1))) {
+            // Exact bounds of the transformed path (or stroke) - tighter than the transformed bounds of the whole layer
+            if (PixelBounds bounds = outerPixelBounds((ScaledBounds) Rasterizer::getBounds(shape.value(), strokeIndex, layerTransform)&visibleBounds)) {
                 // A transparent margin of 1 pixel on each side is added to make sure that CLAMP_TO_EDGE extends with transparent color
                 bounds += PixelMargin(1);
                 #ifdef ODE_RASTERIZER_TEXTURE_SUPPORT
-                    TextureFrameBufferPtr texture = tfbManager.acquire(bounds);
+                    TextureFrameBufferPtr texture = tfbManager.acquire(bounds, TextureFrameBufferManager::alphaOnlyFormat());
                     Matrix3x2d transformation = TransformationMatrix(1, 0, 0, 1, -bounds.a.x, -bounds.a.y)*layerTransform; // do not move before ifdef, bounds modified in previous statement
                     Rasterizer::TextureDescriptor textureDescriptor = { };
                     textureDescriptor.handle = texture->getInternalGLHandle();
                     textureDescriptor.dimensions = texture->dimensions();
                     textureDescriptor.format = texture->format();
                     if (rasterizer.rasterize(shape.value(), strokeIndex, transformation, textureDescriptor))
-                        return PlacedImagePtr(ImagePtr(new TextureImage(texture, Image::NORMAL, Image::NO_BORDER)), bounds);
+                        return PlacedImagePtr(ImagePtr(new TextureImage(texture, texture->format() == PixelFormat::R ? Image::RED_IS_ALPHA : Image::NORMAL, Image::NO_BORDER)), bounds);
                 #else
                     Matrix3x2d transformation = TransformationMatrix(1, 0, 0, 1, -bounds.a.x, -bounds.a.y)*layerTransform;
                     BitmapPtr bitmap(new Bitmap(PixelFormat::ALPHA, bounds.dimensions()));
@@ -375,12 +992,16 @@ PlacedImagePtr Renderer::drawLayerVector(Component &component, const LayerInstan
     return nullptr;
 }
 
-PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpecifier &layer, ImageBase &imageBase, const octopus::Fill &fill, double scale, double time) {
+PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpecifier &layer, ImageBase &imageBase, const octopus::Fill &fill, const ScaledBounds &visibleBounds, double scale, double time, bool physicalMemory) {
     if (Result<LayerBounds, DesignError> layerBounds = component.getLayerBounds(layer->id)) {
         TransformationMatrix animationMatrix = animationTransform(component, layer, time);
         TransformationMatrix layerTransform = layer.parentTransform*TransformationMatrix(layer->transform)*animationMatrix;
         UnscaledBounds fillBounds = transformBounds(layerBounds.value().untransformedBounds, layerTransform);
         ScaledBounds sFillBounds = scaleBounds(fillBounds, scale);
+        // Content outside the visible bounds would be discarded anyway
+        ScaledBounds sVisibleFillBounds = (sFillBounds+ScaledMargin(1))&visibleBounds;
+        if (!sVisibleFillBounds)
+            return nullptr;
 
         TransformationMatrix transform;
         if (fill.positioning.has_value()) {
@@ -404,9 +1025,18 @@ PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpeci
             case octopus::Fill::Type::COLOR:
                 if (fill.color.has_value()) {
                     Color color = animationFillColor(component, layer, time, Color(fill.color->r, fill.color->g, fill.color->b, fill.color->a));
+                    if (physicalMemory) {
+                        Bitmap bitmap(PixelFormat::PREMULTIPLIED_RGBA, 1, 1);
+                        byte *pixel = reinterpret_cast<byte *>(bitmap.pixels());
+                        pixel[0] = channelFloatToByte(color.r*color.a);
+                        pixel[1] = channelFloatToByte(color.g*color.a);
+                        pixel[2] = channelFloatToByte(color.b*color.a);
+                        pixel[3] = channelFloatToByte(color.a);
+                        return PlacedImagePtr(Image::fromBitmap((Bitmap &&) bitmap, Image::PREMULTIPLIED), sFillBounds+ScaledMargin(1));
+                    }
                     TextureFrameBufferPtr t = tfbManager.acquireExact(PixelBounds(0, 0, 1, 1));
                     t->bind();
-                    glClearColor(GLclampf(color.r*color.a), GLclampf(color.g*color.a), GLclampf(color.b*color.a), GLclampf(color.a));
+                    GLStateCache::clearColor(GLclampf(color.r*color.a), GLclampf(color.g*color.a), GLclampf(color.b*color.a), GLclampf(color.a));
                     glClear(GL_COLOR_BUFFER_BIT);
                     t->unbind();
                     return PlacedImagePtr(Image::fromTexture(t, Image::NORMAL), sFillBounds+ScaledMargin(1));
@@ -415,12 +1045,10 @@ PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpeci
 
             case octopus::Fill::Type::GRADIENT:
                 if (fill.gradient.has_value()) {
-                    GradientFillShader &shader = gradientFillShaders[fill.gradient->type];
-                    if (!shader.ready()) {
-                        if (!shader.initialize(fillShaderRes, GradientFillShader::shapeFunctionSource(fill.gradient->type))) {
-                            // TODO log error
-                            return nullptr;
-                        }
+                    GradientFillShader *shader = getGradientFillShader(fill.gradient->type);
+                    if (!shader) {
+                        // TODO log error
+                        return nullptr;
                     }
 
                     GradientTexture gradientTexture;
@@ -429,12 +1057,12 @@ PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpeci
                         return nullptr;
                     }
 
-                    ScaledBounds bounds = sFillBounds+ScaledMargin(1);
+                    ScaledBounds bounds = sVisibleFillBounds;
                     PixelBounds pxBounds = outerPixelBounds(bounds);
                     TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
                     outTex->bind();
-                    glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-                    shader.bind(pxBounds, bounds, Matrix3x3f(Matrix3x3d(transform)), gradientTexture.transformation());
+                    GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+                    shader->bind(pxBounds, bounds, Matrix3x3f(Matrix3x3d(transform)), gradientTexture.transformation());
                     gradientTexture.bind(GradientFillShader::UNIT_GRADIENT);
                     billboard.draw();
                     outTex->unbind();
@@ -444,12 +1072,10 @@ PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpeci
 
             case octopus::Fill::Type::IMAGE:
                 if (fill.image.has_value()) {
-                    ImageFillShader &shader = imageFillShaders[0];
-                    if (!shader.ready()) {
-                        if (!shader.initialize(fillShaderRes)) {
-                            // TODO log error
-                            return nullptr;
-                        }
+                    ImageFillShader *shader = getImageFillShader();
+                    if (!shader) {
+                        // TODO log error
+                        return nullptr;
                     }
 
                     if (ImagePtr image = imageBase.get(fill.image.value())) {
@@ -502,12 +1128,12 @@ PlacedImagePtr Renderer::drawFill(Component &component, const LayerInstanceSpeci
                             );
                         }
 
-                        ScaledBounds bounds = sFillBounds+ScaledMargin(1);
+                        ScaledBounds bounds = sVisibleFillBounds;
                         PixelBounds pxBounds = outerPixelBounds(bounds);
                         TextureFrameBufferPtr outTex = tfbManager.acquire(pxBounds);
                         outTex->bind();
-                        glViewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
-                        shader.bind(pxBounds, bounds, Matrix3x3f(Matrix3x3d(transform)));
+                        GLStateCache::viewport(0, 0, pxBounds.dimensions().x, pxBounds.dimensions().y);
+                        shader->bind(pxBounds, bounds, Matrix3x3f(Matrix3x3d(transform)));
                         texture->bind(ImageFillShader::UNIT_IMAGE);
                         billboard.draw();
                         outTex->unbind();
@@ -2,6 +2,8 @@
 #pragma once
 
 #include <map>
+#include <string>
+#include <vector>
 #include <octopus/octopus.h>
 #include <ode-essentials.h>
 #include <ode-rasterizer.h>
@@ -12,6 +14,9 @@
 #include "../frame-buffer-management/TextureFrameBufferManager.h"
 #include "../text-renderer/TextRenderer.h"
 #include "EffectRenderer.h"
+#include "EffectCache.h"
+#include "SubtreeCache.h"
+#include "CompositingChain.h"
 #include "compositing-shaders/compositing-shaders.h"
 #include "fill-shaders/fill-shaders.h"
 
@@ -21,58 +26,140 @@ namespace ode {
 class Renderer {
 
 public:
+    /// Counters of compositing passes since the last resetStatistics call
+    struct Statistics {
+        int compositingPasses;
+        /// Compositing passes that evaluated a fused chain of operations
+        int fusedPasses;
+        /// Number of intermediate passes eliminated by fusion
+        int savedPasses;
+        /// Total area of the intermediate framebuffers that did not have to be written and read back
+        long long savedPixels;
+        /// Number of distance field passes eliminated by sharing the distance field between effects of the same layer
+        int savedDistanceFieldPasses;
+        /// OpenGL state changes issued and skipped as redundant by GLStateCache
+        int glStateChanges;
+        int skippedGlStateChanges;
+        /// Highest estimated peak memory of intermediate results of a render in bytes (see EvaluationSchedule),
+        /// if operands were evaluated left-to-right and in the order actually used
+        long long unscheduledPeakMemory;
+        long long scheduledPeakMemory;
+        /// Compositing operations evaluated in physical memory instead of a GPU pass (see ExecutionPlan)
+        int cpuOperations;
+    };
+
+    /// An axis-aligned rectangle with uniformly rounded corners, applied as a mask analytically instead of through a mask image
+    struct RectangleMask {
+        ScaledBounds rectangle;
+        double cornerRadius;
+    };
+
     explicit Renderer(GraphicsContext &gc);
 
     PlacedImagePtr blend(const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode);
     PlacedImagePtr blendIgnoreAlpha(const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode);
     PlacedImagePtr mask(const PlacedImagePtr &image, const PlacedImagePtr &mask, ChannelMatrix channelMatrix);
     PlacedImagePtr mixMask(const PlacedImagePtr &a, const PlacedImagePtr &b, const PlacedImagePtr &mask, ChannelMatrix channelMatrix);
+    PlacedImagePtr mask(const PlacedImagePtr &image, const RectangleMask &mask, ChannelMatrix channelMatrix);
+    PlacedImagePtr mixMask(const PlacedImagePtr &a, const PlacedImagePtr &b, const RectangleMask &mask, ChannelMatrix channelMatrix);
     PlacedImagePtr mix(const PlacedImagePtr &a, const PlacedImagePtr &b, double ratio);
     PlacedImagePtr multiplyAlpha(const PlacedImagePtr &image, double multiplier);
-
-    PlacedImagePtr drawLayerBody(Component &component, const LayerInstanceSpecifier &layer, double scale, double time);
-    PlacedImagePtr drawLayerStroke(Component &component, const LayerInstanceSpecifier &layer, int index, double scale, double time);
-    PlacedImagePtr drawLayerFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, double scale, double time);
-    PlacedImagePtr drawLayerStrokeFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, double scale, double time);
-    PlacedImagePtr drawLayerText(Component &component, const LayerInstanceSpecifier &layer, double scale, double time);
-    PlacedImagePtr drawLayerEffect(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const PlacedImagePtr &basis, double scale, double time);
+    /// Evaluates the whole chain in a single pass, inputs correspond to chain.inputs()
+    PlacedImagePtr composite(const CompositingChain &chain, const std::vector<PlacedImagePtr> &inputs);
+
+    /// Returns true and outputs the rectangle if the layer's body (as drawn by drawLayerBody) is an axis-aligned rectangle with uniformly rounded corners
+    bool getRectangleMask(Component &component, const LayerInstanceSpecifier &layer, double scale, double time, RectangleMask &rectangleMask);
+    /// Layer drawing operations may omit content outside visibleBounds
+    PlacedImagePtr drawLayerBody(Component &component, const LayerInstanceSpecifier &layer, const ScaledBounds &visibleBounds, double scale, double time);
+    PlacedImagePtr drawLayerStroke(Component &component, const LayerInstanceSpecifier &layer, int index, const ScaledBounds &visibleBounds, double scale, double time);
+    /// If physicalMemory is set, a solid color fill is produced as a bitmap, so that it can be composited on the CPU (see bitmap-compositing.h)
+    PlacedImagePtr drawLayerFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const ScaledBounds &visibleBounds, double scale, double time, bool physicalMemory = false);
+    PlacedImagePtr drawLayerStrokeFill(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const ScaledBounds &visibleBounds, double scale, double time, bool physicalMemory = false);
+    PlacedImagePtr drawLayerText(Component &component, const LayerInstanceSpecifier &layer, const ScaledBounds &visibleBounds, double scale, double time);
+    PlacedImagePtr drawLayerEffect(Component &component, const LayerInstanceSpecifier &layer, int index, ImageBase &imageBase, const PlacedImagePtr &basis, const ScaledBounds &visibleBounds, double scale, double time);
     PlacedImagePtr applyFilter(const octopus::Filter &filter, const PlacedImagePtr &basis);
+    /// Produces an image of a rectangle of a uniform (premultiplied) color, where partially covered pixels are weighted by their coverage -
+    /// used to approximate content which is too small to be drawn in detail
+    PlacedImagePtr drawApproximation(const ScaledBounds &bounds, const Color &color);
 
     PlacedImagePtr reframe(const PlacedImagePtr &image, const PixelBounds &bounds);
 
     void screenDraw(const PixelBounds &viewport, const PlacedImagePtr &image, const Color &bgColor);
+    /// Initiates the asynchronous transfer of the image's pixels to physical memory (see TextureReadback) in the given format -
+    /// conversion of PREMULTIPLIED_RGBA to RGBA is performed on the GPU
+    bool readback(TextureReadback &readback, const PlacedImagePtr &image, PixelFormat format);
+    /// Transfers the image's pixels directly into existing memory in the bitmap's format (RGBA or PREMULTIPLIED_RGBA), dimensions must match
+    bool download(const SparseBitmapRef &bitmap, const PlacedImagePtr &image);
 
     // Free up some memory
     void cleanUp();
 
+    /// Compiles the shaders of all blend modes, fills and effects, which are otherwise compiled on first use - returns false if any failed
+    bool warmUp();
+
+    /// Sets the quality of subsequently drawn effects
+    void setEffectQuality(EffectQuality quality);
+    EffectQuality effectQuality() const;
+    /// Sets the size (in pixels) below which layers are approximated in subsequent renders instead of being drawn in detail, zero to disable
+    void setDetailThreshold(double pixels);
+    double detailThreshold() const;
+    /// Results of expression subtrees retained across renders (see RenderContext)
+    inline SubtreeCache &getSubtreeCache() { return subtreeCache; }
+
+    /// Records the estimated peak memory of intermediate results of a render in the statistics
+    void reportPeakMemory(long long unscheduledPeak, long long scheduledPeak);
+    /// Records an operation evaluated in physical memory in the statistics
+    void reportCpuOperation();
+    Statistics statistics() const;
+    void resetStatistics();
+
 private:
     GraphicsContext &gc;
     Rasterizer rasterizer;
     TextureFrameBufferManager tfbManager;
     TextRenderer textRenderer;
     EffectRenderer effectRenderer;
+    EffectCache effectCache;
+    SubtreeCache subtreeCache;
+    Statistics stats;
+    double lodThreshold;
 
     PlacedImagePtr resolveAlphaChannel(const PlacedImagePtr &image);
+    /// Returns a texture with the image's pixels in format, converting them on the GPU if necessary
+    TexturePtr convertForTransfer(const PlacedImagePtr &image, PixelFormat format);
     PlacedImagePtr transformImage(const PlacedImagePtr &image, const Matrix3x3d &transformation);
     PlacedImagePtr blend(const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode, bool ignoreSrcAlpha);
-    PlacedImagePtr drawLayerVector(Component &component, const LayerInstanceSpecifier &layer, int strokeIndex, double scale, double time);
-    PlacedImagePtr drawFill(Component &component, const LayerInstanceSpecifier &layer, ImageBase &imageBase, const octopus::Fill &fill, double scale, double time);
+    PlacedImagePtr blendAlphaOnly(const PlacedImagePtr &dst, const PlacedImagePtr &src);
+    /// Evaluates the chain by the individual operations, one pass per node
+    PlacedImagePtr compositeSeparately(const CompositingChain &chain, const std::vector<PlacedImagePtr> &inputs);
+    PlacedImagePtr drawLayerVector(Component &component, const LayerInstanceSpecifier &layer, int strokeIndex, const ScaledBounds &visibleBounds, double scale, double time);
+    PlacedImagePtr drawFill(Component &component, const LayerInstanceSpecifier &layer, ImageBase &imageBase, const octopus::Fill &fill, const ScaledBounds &visibleBounds, double scale, double time, bool physicalMemory = false);
+    /// Returns true if the result of the layer's index-th effect can be cached across renders and outputs its cache key and the layer's translation
+    bool getEffectCacheKey(Component &component, const LayerInstanceSpecifier &layer, int index, double scale, double effectScale, double time, EffectCache::Key &key, Vector2d &translation);
+    BlendShader *getBlendShader(octopus::BlendMode blendMode);
+    GradientFillShader *getGradientFillShader(octopus::Gradient::Type type);
+    ImageFillShader *getImageFillShader();
+    /// Returns true if effect is a shadow or glow whose basis is the layer's rectangle shape
+    static bool isRectangleEffectBasis(const LayerInstanceSpecifier &layer, const octopus::Effect &effect);
 
     Mesh billboard;
 
     Texture2D transparentTexture;
-    Texture2D whiteTexture;
 
     CompositingShader::SharedResource compositingShaderRes;
     FillShader::SharedResource fillShaderRes;
     SolidColorShader solidColorShader;
     BlitShader blitShader;
+    BlitShader alphaBlitShader;
     MixShader mixShader;
     MixMaskShader mixMaskShader;
+    RectangleMaskShader rectangleMaskShader;
     AlphaMultShader alphaMultShader;
+    UnpremultiplyShader unpremultiplyShader;
     std::map<octopus::BlendMode, BlendShader> blendShaders;
     std::map<octopus::Gradient::Type, GradientFillShader> gradientFillShaders;
     std::map<int, ImageFillShader> imageFillShaders;
+    std::map<std::string, FusedCompositingShader> fusedCompositingShaders;
 
 };
 
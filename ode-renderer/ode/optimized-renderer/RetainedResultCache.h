@@ -0,0 +1,52 @@
+
+#pragma once
+
+#include <map>
+#include <ode-essentials.h>
+#include "../image/Image.h"
+#include "../frame-buffer-management/TextureFrameBufferManager.h"
+
+namespace ode {
+
+/// Retains rendered results identified by keys of type K across renders and releases the least recently used ones when the framebuffer manager runs out of memory
+template <typename K>
+class RetainedResultCache : public TextureFrameBufferManager::Retainer {
+
+public:
+    /// Returns the memory that would be occupied by result - results are held as RGBA framebuffers at most
+    static size_t resultMemory(const PlacedImagePtr &result);
+
+    explicit RetainedResultCache(TextureFrameBufferManager &tfbManager);
+    RetainedResultCache(const RetainedResultCache<K> &) = delete;
+    ~RetainedResultCache();
+    RetainedResultCache<K> &operator=(const RetainedResultCache<K> &) = delete;
+    /// Outputs the result stored for key (which may be null), moved by the difference between translation and the translation it was stored with - returns false if there is none
+    bool find(const K &key, const Vector2d &translation, PlacedImagePtr &result);
+    /// Stores result (which may be null) under key, replacing any previous one
+    void store(const K &key, const Vector2d &translation, const PlacedImagePtr &result);
+    /// Removes all results whose keys satisfy predicate
+    template <typename P>
+    void eraseIf(P predicate);
+    void clear();
+
+    size_t retainedMemory() const override;
+    bool evict() override;
+
+private:
+    struct Entry {
+        PlacedImagePtr result;
+        Vector2d translation;
+        size_t memory;
+        unsigned long long lastUse;
+    };
+
+    TextureFrameBufferManager &tfbManager;
+    std::map<K, Entry> entries;
+    size_t memory;
+    unsigned long long useCounter;
+
+};
+
+}
+
+#include "RetainedResultCache.hpp"
@@ -0,0 +1,89 @@
+
+#include "RetainedResultCache.h"
+
+namespace ode {
+
+template <typename K>
+size_t RetainedResultCache<K>::resultMemory(const PlacedImagePtr &result) {
+    return result ? 4*size_t(result->dimensions().x)*size_t(result->dimensions().y) : size_t(0);
+}
+
+template <typename K>
+RetainedResultCache<K>::RetainedResultCache(TextureFrameBufferManager &tfbManager) : tfbManager(tfbManager), memory(0), useCounter(0) {
+    tfbManager.addRetainer(this);
+}
+
+template <typename K>
+RetainedResultCache<K>::~RetainedResultCache() {
+    tfbManager.removeRetainer(this);
+}
+
+template <typename K>
+bool RetainedResultCache<K>::find(const K &key, const Vector2d &translation, PlacedImagePtr &result) {
+    typename std::map<K, Entry>::iterator it = entries.find(key);
+    if (it == entries.end())
+        return false;
+    it->second.lastUse = ++useCounter;
+    if (it->second.result)
+        result = PlacedImagePtr(it->second.result, it->second.result.bounds()+(translation-it->second.translation));
+    else
+        result = nullptr;
+    return true;
+}
+
+template <typename K>
+void RetainedResultCache<K>::store(const K &key, const Vector2d &translation, const PlacedImagePtr &result) {
+    Entry entry;
+    entry.result = result;
+    entry.translation = translation;
+    entry.memory = resultMemory(result);
+    entry.lastUse = ++useCounter;
+    typename std::map<K, Entry>::iterator it = entries.find(key);
+    if (it != entries.end()) {
+        memory -= it->second.memory;
+        entries.erase(it);
+    }
+    memory += entry.memory;
+    entries.insert(std::make_pair(key, (Entry &&) entry));
+}
+
+template <typename K>
+template <typename P>
+void RetainedResultCache<K>::eraseIf(P predicate) {
+    for (typename std::map<K, Entry>::iterator it = entries.begin(); it != entries.end();) {
+        if (predicate(it->first)) {
+            memory -= it->second.memory;
+            it = entries.erase(it);
+        } else
+            ++it;
+    }
+}
+
+template <typename K>
+void RetainedResultCache<K>::clear() {
+    entries.clear();
+    memory = 0;
+}
+
+template <typename K>
+size_t RetainedResultCache<K>::retainedMemory() const {
+    return memory;
+}
+
+template <typename K>
+bool RetainedResultCache<K>::evict() {
+    typename std::map<K, Entry>::iterator leastRecent = entries.end();
+    for (typename std::map<K, Entry>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        if (leastRecent == entries.end() || it->second.lastUse < leastRecent->second.lastUse)
+            leastRecent = it;
+    }
+    if (leastRecent == entries.end())
+        return false;
+    // The entry is removed from the map before its framebuffer is returned to the pool
+    PlacedImagePtr result = (PlacedImagePtr &&) leastRecent->second.result;
+    memory -= leastRecent->second.memory;
+    entries.erase(leastRecent);
+    return true;
+}
+
+}
@@ -0,0 +1,39 @@
+
+#include "SubtreeCache.h"
+
+#include <tuple>
+
+namespace ode {
+
+bool SubtreeCache::Key::operator<(const Key &other) const {
+    return (
+        std::tie(componentId, contentHash, scale, subpixelTranslation.x, subpixelTranslation.y, quality, detailThreshold) <
+        std::tie(other.componentId, other.contentHash, other.scale, other.subpixelTranslation.x, other.subpixelTranslation.y, other.quality, other.detailThreshold)
+    );
+}
+
+SubtreeCache::SubtreeCache(TextureFrameBufferManager &tfbManager) : results(tfbManager), memoryLimit(DEFAULT_MEMORY_LIMIT) { }
+
+bool SubtreeCache::find(const Key &key, const Vector2d &translation, PlacedImagePtr &result) {
+    return results.find(key, translation, result);
+}
+
+void SubtreeCache::store(const Key &key, const Vector2d &translation, const PlacedImagePtr &result) {
+    // Empty results are retained too so that their subtrees are skipped
+    if (RetainedResultCache<Key>::resultMemory(result) > memoryLimit/4)
+        return;
+    results.store(key, translation, result);
+    // Results of modified subtrees are never looked up again and are the first to go
+    while (results.retainedMemory() > memoryLimit && results.evict());
+}
+
+void SubtreeCache::clear() {
+    results.clear();
+}
+
+void SubtreeCache::setMemoryLimit(size_t bytes) {
+    memoryLimit = bytes;
+    while (results.retainedMemory() > memoryLimit && results.evict());
+}
+
+}
@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include <ode-essentials.h>
+#include <ode-logic.h>
+#include "../image/Image.h"
+#include "../frame-buffer-management/TextureFrameBufferManager.h"
+#include "EffectRenderer.h"
+#include "RetainedResultCache.h"
+
+namespace ode {
+
+/// Retains rendered results of render expression subtrees across renders and modifications of unrelated layers.
+/// Results are identified by the content of the subtree rather than its nodes, so they survive reassembly of the expression tree
+class SubtreeCache {
+
+public:
+    /// Default limit of the memory occupied by retained results (in bytes), a part of the framebuffer manager's budget
+    static constexpr size_t DEFAULT_MEMORY_LIMIT = size_t(64)<<20;
+
+    /// Identifies the content of a subtree
+    struct Key {
+        /// Unique identifier of the component - see Component::uniqueId
+        unsigned long long componentId;
+        /// Structural hash of the subtree, including the content serials and placement of its layers relative to the first one
+        unsigned long long contentHash;
+        double scale;
+        /// Fractional part of the translation of the subtree's first layer - results are only reused at integer offsets
+        Vector2d subpixelTranslation;
+        EffectQuality quality;
+        /// The renderer's detail threshold, below which layers are approximated
+        double detailThreshold;
+
+        bool operator<(const Key &other) const;
+    };
+
+    explicit SubtreeCache(TextureFrameBufferManager &tfbManager);
+    /// Outputs the result stored for key, moved by the difference between translation and the translation it was stored with - returns false if there is none
+    bool find(const Key &key, const Vector2d &translation, PlacedImagePtr &result);
+    void store(const Key &key, const Vector2d &translation, const PlacedImagePtr &result);
+    void clear();
+    void setMemoryLimit(size_t bytes);
+
+private:
+    RetainedResultCache<Key> results;
+    size_t memoryLimit;
+
+};
+
+}
@@ -0,0 +1,152 @@
+
+#include "TilePyramid.h"
+
+#ifndef __EMSCRIPTEN__
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <octopus/serializer.h>
+#include <ode-media.h>
+#include "render.h"
+
+namespace ode {
+
+// 64-bit FNV-1a hash
+static void hashAppend(unsigned long long &hash, const void *data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned long long) reinterpret_cast<const unsigned char *>(data)[i];
+        hash *= 0x100000001b3ull;
+    }
+}
+
+TilePyramid::TilePyramid(Renderer &renderer, ImageBase &imageBase, Component &component, const FilePath &cacheDirectory, int tileSize) :
+    renderer(renderer),
+    imageBase(imageBase),
+    component(component),
+    directory(cacheDirectory),
+    tileSize(tileSize),
+    octopusHash(0),
+    hashedRevision(-1),
+    hashedDamageSerial(-1),
+    renderRevision(-1)
+{
+    ODE_ASSERT(tileSize > 0);
+}
+
+bool TilePyramid::contentKey(std::string &key) {
+    if (hashedRevision != component.revision() || hashedDamageSerial != component.damageSerial()) {
+        std::string json;
+        if (octopus::Serializer::serialize(json, component.getOctopus()))
+            return false;
+        octopusHash = 0xcbf29ce484222325ull;
+        hashAppend(octopusHash, json.data(), json.size());
+        hashedRevision = component.revision();
+        hashedDamageSerial = component.damageSerial();
+    }
+    // Settings of the renderer which affect the output
+    unsigned long long hash = octopusHash;
+    int quality = int(renderer.effectQuality());
+    double detailThreshold = renderer.detailThreshold();
+    hashAppend(hash, &quality, sizeof(quality));
+    hashAppend(hash, &detailThreshold, sizeof(detailThreshold));
+    char keyBuffer[17];
+    snprintf(keyBuffer, sizeof(keyBuffer), "%016llx", hash);
+    key = keyBuffer;
+    return true;
+}
+
+FilePath TilePyramid::tilePath(const std::string &key, int level, int column, int row) const {
+    char suffix[64];
+    snprintf(suffix, sizeof(suffix), "_%d_%d_%d_%d.png", tileSize, level, column, row);
+    return directory+("/"+key+suffix);
+}
+
+Bitmap TilePyramid::loadTile(const FilePath &path) const {
+    Bitmap tile = loadPng(path);
+    if (tile && tile.format() == PixelFormat::RGBA && tile.dimensions() == Vector2i(tileSize, tileSize))
+        return tile;
+    return Bitmap();
+}
+
+Bitmap TilePyramid::renderTile(int level, int column, int row) {
+    if (!renderTree || renderRevision != component.revision()) {
+        Result<Rendexptr, DesignError> assembledTree = component.assemble();
+        if (!assembledTree)
+            return Bitmap();
+        renderTree = assembledTree.value();
+        renderRevision = component.revision();
+    }
+    PixelBounds bounds(tileSize*column, tileSize*row, tileSize*(column+1), tileSize*(row+1));
+    Bitmap tile(PixelFormat::RGBA, tileSize, tileSize);
+    // Rendered as a single tile, so that only content which affects it is drawn
+    if (!renderTiled(renderer, imageBase, component, renderTree, ldexp(1., level), bounds, 0, tileSize, [&](PlacedImagePtr image) -> bool {
+        TexturePtr tex = image->asTexture();
+        if (!(tex && image.bounds() == ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b) && tex->dimensions() == bounds.dimensions()))
+            image = renderer.reframe(image, bounds);
+        return renderer.download(tile, image);
+    }))
+        return Bitmap();
+    return tile;
+}
+
+Bitmap TilePyramid::downsampleTile(const std::string &key, int level, int column, int row) const {
+    // Quadrants of the tile's area at the next level in row-major order
+    Bitmap quadrants[4];
+    for (int i = 0; i < 4; ++i) {
+        if (!(quadrants[i] = loadTile(tilePath(key, level+1, 2*column+(i&1), 2*row+(i>>1)))))
+            return Bitmap();
+    }
+    Bitmap tile(PixelFormat::RGBA, tileSize, tileSize);
+    byte *dst = (byte *) tile;
+    for (int y = 0; y < tileSize; ++y) {
+        for (int x = 0; x < tileSize; ++x, dst += 4) {
+            // Box filter of the 2x2 pixels of the quadrant mosaic, with colors weighted by alpha
+            int sums[4] = { };
+            for (int sy = 2*y; sy < 2*y+2; ++sy) {
+                for (int sx = 2*x; sx < 2*x+2; ++sx) {
+                    const Bitmap &quadrant = quadrants[2*(sy >= tileSize)+(sx >= tileSize)];
+                    const byte *src = reinterpret_cast<const byte *>(quadrant.pixels())+4*(tileSize*(sy%tileSize)+sx%tileSize);
+                    sums[0] += int(src[0])*int(src[3]);
+                    sums[1] += int(src[1])*int(src[3]);
+                    sums[2] += int(src[2])*int(src[3]);
+                    sums[3] += int(src[3]);
+                }
+            }
+            for (int c = 0; c < 3; ++c)
+                dst[c] = byte(sums[3] ? (sums[c]+sums[3]/2)/sums[3] : 0);
+            dst[3] = byte((sums[3]+2)/4);
+        }
+    }
+    return tile;
+}
+
+bool TilePyramid::storeTile(const FilePath &path, const Bitmap &tile) const {
+    // Written under a temporary name first, so that other processes never load an incomplete tile
+    FilePath tempPath = path+".tmp";
+    if (!savePng(tempPath, tile))
+        return false;
+    if (rename(((const std::string &) tempPath).c_str(), ((const std::string &) path).c_str())) {
+        remove(((const std::string &) tempPath).c_str());
+        return false;
+    }
+    return true;
+}
+
+Bitmap TilePyramid::getTile(int level, int column, int row) {
+    std::string key;
+    if (!contentKey(key))
+        return Bitmap();
+    FilePath path = tilePath(key, level, column, row);
+    Bitmap tile = loadTile(path);
+    if (tile)
+        return tile;
+    if (!((tile = downsampleTile(key, level, column, row)) || (tile = renderTile(level, column, row))))
+        return Bitmap();
+    storeTile(path, tile);
+    return tile;
+}
+
+}
+
+#endif
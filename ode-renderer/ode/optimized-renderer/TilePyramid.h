@@ -0,0 +1,51 @@
+
+#pragma once
+
+#ifndef __EMSCRIPTEN__
+
+#include <string>
+#include <ode-essentials.h>
+#include <ode-logic.h>
+#include "../image/ImageBase.h"
+#include "Renderer.h"
+
+namespace ode {
+
+/// Renders a component in square tiles of a fixed size at power-of-two scales (levels), as needed by map-style deep zoom viewers.
+/// Tiles are stored as PNG files in a cache directory under a hash of the component's content and the render settings,
+/// so they are never rendered again until the component is modified (the pixels of image assets are not part of the hash)
+class TilePyramid {
+
+public:
+    /// The cache directory must already exist
+    TilePyramid(Renderer &renderer, ImageBase &imageBase, Component &component, const FilePath &cacheDirectory, int tileSize);
+    TilePyramid(const TilePyramid &) = delete;
+    TilePyramid &operator=(const TilePyramid &) = delete;
+    /// Returns the RGBA tile at scale 2^level whose top-left corner is at tileSize*(column, row) in the component's pixel space at that scale, or an empty bitmap on failure.
+    /// A tile which is not cached yet is downsampled from the four tiles of the next level which cover its area if they are all cached, otherwise it is rendered
+    Bitmap getTile(int level, int column, int row);
+
+private:
+    Renderer &renderer;
+    ImageBase &imageBase;
+    Component &component;
+    FilePath directory;
+    int tileSize;
+    /// Hash of the component's Octopus, valid for the revision and damage serial number it was computed at
+    unsigned long long octopusHash;
+    int hashedRevision, hashedDamageSerial;
+    Rendexptr renderTree;
+    int renderRevision;
+
+    bool contentKey(std::string &key);
+    FilePath tilePath(const std::string &key, int level, int column, int row) const;
+    Bitmap loadTile(const FilePath &path) const;
+    Bitmap renderTile(int level, int column, int row);
+    Bitmap downsampleTile(const std::string &key, int level, int column, int row) const;
+    bool storeTile(const FilePath &path, const Bitmap &tile) const;
+
+};
+
+}
+
+#endif
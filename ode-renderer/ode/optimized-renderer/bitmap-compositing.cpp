@@ -0,0 +1,208 @@
+
+#include "bitmap-compositing.h"
+
+#include <cmath>
+
+namespace ode {
+
+/// Reads the pixels of a compositable image at the centers of output pixels, extending its edge pixels beyond its bounds like CLAMP_TO_EDGE
+struct CompositableBitmap {
+    BitmapPtr bitmap;
+    ScaledBounds bounds;
+    bool alphaOnly;
+
+    explicit CompositableBitmap(const PlacedImagePtr &image) : bitmap(image->asBitmap()), bounds(image.bounds()), alphaOnly(image->transparencyMode() == Image::RED_IS_ALPHA) { }
+
+    const byte *pixel(int x, int y) const {
+        int sx = int(floor((x+.5-bounds.a.x)*bitmap->width()/(bounds.b.x-bounds.a.x)));
+        int sy = int(floor((y+.5-bounds.a.y)*bitmap->height()/(bounds.b.y-bounds.a.y)));
+        sx = std::min(std::max(sx, 0), bitmap->width()-1);
+        sy = std::min(std::max(sy, 0), bitmap->height()-1);
+        return reinterpret_cast<const byte *>((*bitmap)(sx, sy));
+    }
+
+    /// Outputs the premultiplied color of the pixel - alpha only images are white
+    void color(int x, int y, float rgba[4]) const {
+        const byte *p = pixel(x, y);
+        if (alphaOnly)
+            rgba[0] = rgba[1] = rgba[2] = rgba[3] = channelByteToFloat(p[0]);
+        else {
+            for (int i = 0; i < 4; ++i)
+                rgba[i] = channelByteToFloat(p[i]);
+        }
+    }
+
+    /// Outputs the value of the pixel as sampled from the image's texture, where alpha only images occupy the red channel
+    void texel(int x, int y, float rgba[4]) const {
+        const byte *p = pixel(x, y);
+        if (alphaOnly) {
+            rgba[0] = channelByteToFloat(p[0]);
+            rgba[1] = rgba[2] = 0;
+            rgba[3] = 1;
+        } else {
+            for (int i = 0; i < 4; ++i)
+                rgba[i] = channelByteToFloat(p[i]);
+        }
+    }
+};
+
+/// Creates the output bitmap image of an operation covering bounds, alpha only if all its color operands are
+static PlacedImagePtr createOutput(const ScaledBounds &bounds, bool alphaOnly, Bitmap *&bitmap, PixelBounds &pxBounds) {
+    pxBounds = outerPixelBounds(bounds);
+    BitmapPtr outputBitmap(new Bitmap(alphaOnly ? PixelFormat::R : PixelFormat::PREMULTIPLIED_RGBA, pxBounds.dimensions()));
+    bitmap = outputBitmap.get();
+    return PlacedImagePtr(Image::fromBitmap(outputBitmap, alphaOnly ? Image::RED_IS_ALPHA : Image::PREMULTIPLIED), pxBounds);
+}
+
+static void writePixel(Bitmap &bitmap, const PixelBounds &pxBounds, int x, int y, const float rgba[4]) {
+    byte *p = reinterpret_cast<byte *>(bitmap(x-pxBounds.a.x, y-pxBounds.a.y));
+    if (bitmap.format() == PixelFormat::R)
+        p[0] = channelFloatToByte(rgba[3]);
+    else {
+        for (int i = 0; i < 4; ++i)
+            p[i] = channelFloatToByte(rgba[i]);
+    }
+}
+
+bool isBitmapCompositable(const PlacedImagePtr &image) {
+    if (!(image && image->bitmapResident() && image->borderMode() == Image::NO_BORDER && image.bounds()))
+        return false;
+    BitmapPtr bitmap = image->asBitmap();
+    if (!(bitmap && *bitmap))
+        return false;
+    switch (image->transparencyMode()) {
+        case Image::PREMULTIPLIED:
+            if (bitmap->format() != PixelFormat::PREMULTIPLIED_RGBA)
+                return false;
+            break;
+        case Image::RED_IS_ALPHA:
+            if (bitmap->format() != PixelFormat::R)
+                return false;
+            break;
+        default:
+            return false;
+    }
+    if (bitmap->dimensions() == Vector2i(1, 1))
+        return true;
+    // Otherwise pixels must map one to one, so that sampling at pixel centers matches linear filtering
+    const ScaledBounds &bounds = image.bounds();
+    return bounds.a.x == floor(bounds.a.x) && bounds.a.y == floor(bounds.a.y) && bounds.dimensions() == Vector2d(bitmap->dimensions());
+}
+
+bool bitmapBlend(PlacedImagePtr &output, const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode) {
+    if (blendMode != octopus::BlendMode::NORMAL)
+        return false;
+    if (!dst || !src) {
+        output = dst ? dst : src;
+        return true;
+    }
+    if (!(isBitmapCompositable(dst) && isBitmapCompositable(src)))
+        return false;
+    ScaledBounds bounds = dst.bounds()|src.bounds();
+    CompositableBitmap dstBitmap(dst), srcBitmap(src);
+    Bitmap *bitmap;
+    PixelBounds pxBounds;
+    output = createOutput(bounds, dstBitmap.alphaOnly && srcBitmap.alphaOnly, bitmap, pxBounds);
+    for (int y = pxBounds.a.y; y < pxBounds.b.y; ++y) {
+        for (int x = pxBounds.a.x; x < pxBounds.b.x; ++x) {
+            float d[4], s[4];
+            dstBitmap.color(x, y, d);
+            srcBitmap.color(x, y, s);
+            for (int i = 0; i < 4; ++i)
+                d[i] = s[i]+(1-s[3])*d[i];
+            writePixel(*bitmap, pxBounds, x, y, d);
+        }
+    }
+    return true;
+}
+
+bool bitmapMask(PlacedImagePtr &output, const PlacedImagePtr &image, const PlacedImagePtr &mask, const ChannelMatrix &channelMatrix) {
+    if (!image || !mask) {
+        output = nullptr;
+        return true;
+    }
+    if (!(isBitmapCompositable(image) && isBitmapCompositable(mask)))
+        return false;
+    ScaledBounds bounds = image.bounds()&mask.bounds();
+    if (!bounds) {
+        output = nullptr;
+        return true;
+    }
+    CompositableBitmap imageBitmap(image), maskBitmap(mask);
+    // Same as the channel matrix of the mask shader, which samples alpha only masks from the red channel
+    ChannelMatrix m = channelMatrix;
+    if (maskBitmap.alphaOnly) {
+        m.m[4] += m.m[0]+m.m[1]+m.m[2];
+        m.m[0] = m.m[3];
+        m.m[1] = m.m[2] = m.m[3] = 0;
+    }
+    Bitmap *bitmap;
+    PixelBounds pxBounds;
+    output = createOutput(bounds, imageBitmap.alphaOnly, bitmap, pxBounds);
+    for (int y = pxBounds.a.y; y < pxBounds.b.y; ++y) {
+        for (int x = pxBounds.a.x; x < pxBounds.b.x; ++x) {
+            float c[4], t[4];
+            imageBitmap.color(x, y, c);
+            maskBitmap.texel(x, y, t);
+            float ratio = float((m.m[0]*t[0]+m.m[1]*t[1]+m.m[2]*t[2])/std::max(t[3], .001f)+m.m[3]*t[3]+m.m[4]);
+            for (int i = 0; i < 4; ++i)
+                c[i] *= ratio;
+            writePixel(*bitmap, pxBounds, x, y, c);
+        }
+    }
+    return true;
+}
+
+bool bitmapMix(PlacedImagePtr &output, const PlacedImagePtr &a, const PlacedImagePtr &b, double ratio) {
+    if (ratio == 0 || ratio == 1) {
+        output = ratio == 0 ? a : b;
+        return true;
+    }
+    if (!a)
+        return bitmapMultiplyAlpha(output, b, ratio);
+    if (!b)
+        return bitmapMultiplyAlpha(output, a, 1-ratio);
+    if (!(isBitmapCompositable(a) && isBitmapCompositable(b)))
+        return false;
+    ScaledBounds bounds = a.bounds()|b.bounds();
+    CompositableBitmap aBitmap(a), bBitmap(b);
+    Bitmap *bitmap;
+    PixelBounds pxBounds;
+    output = createOutput(bounds, aBitmap.alphaOnly && bBitmap.alphaOnly, bitmap, pxBounds);
+    for (int y = pxBounds.a.y; y < pxBounds.b.y; ++y) {
+        for (int x = pxBounds.a.x; x < pxBounds.b.x; ++x) {
+            float ca[4], cb[4];
+            aBitmap.color(x, y, ca);
+            bBitmap.color(x, y, cb);
+            for (int i = 0; i < 4; ++i)
+                ca[i] += float(ratio)*(cb[i]-ca[i]);
+            writePixel(*bitmap, pxBounds, x, y, ca);
+        }
+    }
+    return true;
+}
+
+bool bitmapMultiplyAlpha(PlacedImagePtr &output, const PlacedImagePtr &image, double multiplier) {
+    if (multiplier == 0 || multiplier == 1 || !image) {
+        output = multiplier == 0 ? nullptr : image;
+        return true;
+    }
+    if (!isBitmapCompositable(image))
+        return false;
+    CompositableBitmap imageBitmap(image);
+    Bitmap *bitmap;
+    PixelBounds pxBounds;
+    output = createOutput(image.bounds(), imageBitmap.alphaOnly, bitmap, pxBounds);
+    for (int y = pxBounds.a.y; y < pxBounds.b.y; ++y) {
+        for (int x = pxBounds.a.x; x < pxBounds.b.x; ++x) {
+            float c[4];
+            imageBitmap.color(x, y, c);
+            for (int i = 0; i < 4; ++i)
+                c[i] *= float(multiplier);
+            writePixel(*bitmap, pxBounds, x, y, c);
+        }
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,21 @@
+
+#pragma once
+
+#include <octopus/octopus.h>
+#include <ode-logic.h>
+#include "../image/Image.h"
+
+namespace ode {
+
+/// Returns true if the image resides in physical memory in a form which can be an operand of the bitmap compositing operations below -
+/// a premultiplied or alpha only bitmap which is either aligned to the pixel grid or a single pixel (a constant color)
+bool isBitmapCompositable(const PlacedImagePtr &image);
+
+/// Equivalents of the respective Renderer operations evaluated in physical memory, which avoids the overhead of a GPU pass for small images.
+/// They return false without producing output if a non-null operand is not compositable (see isBitmapCompositable) or the operation is not supported
+bool bitmapBlend(PlacedImagePtr &output, const PlacedImagePtr &dst, const PlacedImagePtr &src, octopus::BlendMode blendMode);
+bool bitmapMask(PlacedImagePtr &output, const PlacedImagePtr &image, const PlacedImagePtr &mask, const ChannelMatrix &channelMatrix);
+bool bitmapMix(PlacedImagePtr &output, const PlacedImagePtr &a, const PlacedImagePtr &b, double ratio);
+bool bitmapMultiplyAlpha(PlacedImagePtr &output, const PlacedImagePtr &image, double multiplier);
+
+}
@@ -1,23 +1,30 @@
 
 #include "BlitShader.h"
 
+#include <cstdio>
+#include <cstring>
+
 namespace ode {
 
 BlitShader::BlitShader() = default;
 
-bool BlitShader::initialize(const SharedResource &res) {
+bool BlitShader::initialize(const SharedResource &res, char channel) {
+    char channelDef[] = " .?";
+    channelDef[2] = channel;
+    char macros[64];
+    snprintf(macros, sizeof(macros), "#define CHANNELS%s\n", channel ? channelDef : "");
     const StringLiteral fsSrc = ODE_STRLIT(
         ODE_GLSL_FVARYING "vec2 texCoord[3];"
         "uniform sampler2D src;"
         "void main() {"
-            ODE_GLSL_FRAGCOLOR "=" ODE_GLSL_TEXTURE2D "(src, texCoord[0]);"
+            ODE_GLSL_FRAGCOLOR "= vec4(" ODE_GLSL_TEXTURE2D "(src, texCoord[0]) CHANNELS);"
         "}\n"
     );
     if (!res)
         return false;
-    FragmentShader fs("compositing-blit");
-    const GLchar *src[] = { ODE_COMPOSITING_SHADER_PREAMBLE, fsSrc.string };
-    const GLint sln[] = { sizeof(ODE_COMPOSITING_SHADER_PREAMBLE)-1, fsSrc.length };
+    FragmentShader fs(channel ? "compositing-blit-channel" : "compositing-blit");
+    const GLchar *src[] = { ODE_COMPOSITING_SHADER_PREAMBLE, macros, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_COMPOSITING_SHADER_PREAMBLE)-1, (GLint) strlen(macros), fsSrc.length };
     if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
         return false;
     if (!shader.initialize(getVertexShader(res), &fs))
@@ -11,7 +11,8 @@ public:
     static constexpr int UNIT_IN = 0;
 
     BlitShader();
-    bool initialize(const SharedResource &res);
+    /// If channel is specified, its value is replicated into all output channels (expands alpha only images to premultiplied white)
+    bool initialize(const SharedResource &res, char channel = '\0');
     void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &inputBounds);
 
 private:
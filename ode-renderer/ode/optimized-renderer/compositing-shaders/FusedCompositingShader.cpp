@@ -0,0 +1,190 @@
+
+#include "FusedCompositingShader.h"
+
+#include <string>
+#include "BlendShader.h"
+
+namespace ode {
+
+FusedCompositingShader::FusedCompositingShader() = default;
+
+bool FusedCompositingShader::initialize(const SharedResource &res, const CompositingChain &chain) {
+    if (!res)
+        return false;
+    const std::vector<CompositingChain::Node> &nodes = chain.nodes();
+    int inputCount = int(chain.inputs().size());
+    int root = int(nodes.size())-1;
+    ODE_ASSERT(root > 0 && inputCount <= CompositingChain::MAX_INPUTS);
+
+    // texCoord[0] spans the output bounds, input coordinates are derived from it
+    std::string fsSrc =
+        ODE_GLSL_FVARYING "vec2 texCoord[3];"
+        "float maskRatio(vec4 m, vec4 channelFactor, float bias) {"
+            "return dot(channelFactor.rgb, m.rgb)/max(m.a, 0.001) + channelFactor.a*m.a + bias;"
+        "}"
+        "float clipFactor(vec4 bounds) {"
+            "return step(bounds.x, gl_FragCoord.x)*step(gl_FragCoord.x, bounds.z)*step(bounds.y, gl_FragCoord.y)*step(gl_FragCoord.y, bounds.w);"
+        "}";
+    if (chain.hasBlend()) {
+        // blendColor may read the output alpha from the fragment color
+        fsSrc +=
+            "vec4 blendOp(vec4 d, vec4 s) {"
+                ODE_GLSL_FRAGCOLOR ".a = d.a-d.a*s.a+s.a;"
+                "return vec4(blendColor(d, s), " ODE_GLSL_FRAGCOLOR ".a);"
+            "}"
+            "vec4 ignoreAlpha(vec4 c) {"
+                "return vec4(c.rgb/max(c.a, 0.001), 1.0);"
+            "}";
+    }
+    for (int i = 0; i < inputCount; ++i) {
+        std::string index = std::to_string(i);
+        fsSrc += "uniform sampler2D in"+index+";";
+        fsSrc += "uniform vec4 framing"+index+";";
+    }
+    std::string mainSrc = "void main() {";
+    for (int k = 0; k <= root; ++k) {
+        const CompositingChain::Node &node = nodes[k];
+        std::string index = std::to_string(k);
+        std::string v = "v"+index;
+        std::string a = "v"+std::to_string(node.operands[0]);
+        std::string b = "v"+std::to_string(node.operands[1]);
+        std::string c = "v"+std::to_string(node.operands[2]);
+        switch (node.operation) {
+            case CompositingChain::INPUT:
+                {
+                    std::string input = std::to_string(node.operands[0]);
+                    mainSrc += "vec4 "+v+" = " ODE_GLSL_TEXTURE2D "(in"+input+", framing"+input+".xy+framing"+input+".zw*texCoord[0]);";
+                    continue;
+                }
+            case CompositingChain::BLEND:
+                mainSrc += "vec4 "+v+" = blendOp("+a+", "+b+");";
+                break;
+            case CompositingChain::BLEND_IGNORE_ALPHA:
+                // The parameter is zero if either operand is empty, in which case the other one is passed through (the source with its alpha)
+                fsSrc += "uniform float parameter"+index+";";
+                mainSrc += "vec4 "+v+" = blendOp("+a+", mix("+b+", ignoreAlpha("+b+"), parameter"+index+"));";
+                break;
+            case CompositingChain::MASK:
+                fsSrc += "uniform vec4 maskChannelFactor"+index+";uniform float maskBias"+index+";";
+                mainSrc += "vec4 "+v+" = maskRatio("+b+", maskChannelFactor"+index+", maskBias"+index+")*"+a+";";
+                break;
+            case CompositingChain::MIX_MASK:
+                fsSrc += "uniform vec4 maskChannelFactor"+index+";uniform float maskBias"+index+";";
+                mainSrc += "vec4 "+v+" = mix("+a+", "+b+", maskRatio("+c+", maskChannelFactor"+index+", maskBias"+index+"));";
+                break;
+            case CompositingChain::MIX:
+                fsSrc += "uniform float parameter"+index+";";
+                mainSrc += "vec4 "+v+" = mix("+a+", "+b+", parameter"+index+");";
+                break;
+            case CompositingChain::MULTIPLY_ALPHA:
+                fsSrc += "uniform float parameter"+index+";";
+                mainSrc += "vec4 "+v+" = parameter"+index+"*"+a+";";
+                break;
+        }
+        // Intermediate results are transparent outside of their bounds
+        if (k != root) {
+            fsSrc += "uniform vec4 clip"+index+";";
+            mainSrc += v+" *= clipFactor(clip"+index+");";
+        }
+    }
+    mainSrc += ODE_GLSL_FRAGCOLOR " = v"+std::to_string(root)+";}\n";
+    fsSrc += mainSrc;
+
+    StringLiteral blendFunction;
+    if (chain.hasBlend())
+        blendFunction = BlendShader::blendFunctionSource(chain.blendMode());
+    FragmentShader fs("compositing-fused");
+    const GLchar *src[] = { ODE_COMPOSITING_SHADER_PREAMBLE, blendFunction.string, fsSrc.c_str() };
+    const GLint sln[] = { sizeof(ODE_COMPOSITING_SHADER_PREAMBLE)-1, blendFunction.length, (GLint) fsSrc.size() };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+
+    unifInputFraming.resize(inputCount);
+    unifParameter.resize(nodes.size());
+    unifMaskChannelFactor.resize(nodes.size());
+    unifMaskBias.resize(nodes.size());
+    unifClipBounds.resize(nodes.size());
+    shader.bind();
+    for (int i = 0; i < inputCount; ++i) {
+        std::string index = std::to_string(i);
+        shader.getUniform(("in"+index).c_str()).setInt(i);
+        unifInputFraming[i] = shader.getUniform(("framing"+index).c_str());
+    }
+    for (int k = 0; k <= root; ++k) {
+        std::string index = std::to_string(k);
+        switch (nodes[k].operation) {
+            case CompositingChain::MASK:
+            case CompositingChain::MIX_MASK:
+                unifMaskChannelFactor[k] = shader.getUniform(("maskChannelFactor"+index).c_str());
+                unifMaskBias[k] = shader.getUniform(("maskBias"+index).c_str());
+                break;
+            case CompositingChain::BLEND_IGNORE_ALPHA:
+            case CompositingChain::MIX:
+            case CompositingChain::MULTIPLY_ALPHA:
+                unifParameter[k] = shader.getUniform(("parameter"+index).c_str());
+                break;
+            default:
+                break;
+        }
+        if (nodes[k].operation != CompositingChain::INPUT && k != root)
+            unifClipBounds[k] = shader.getUniform(("clip"+index).c_str());
+    }
+    return CompositingShader::initialize(&shader);
+}
+
+void FusedCompositingShader::bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const std::vector<ScaledBounds> &inputBounds, const std::vector<CompositingChain::Node> &nodes, const std::vector<ScaledBounds> &nodeBounds) {
+    ODE_ASSERT(inputBounds.size() == unifInputFraming.size() && nodes.size() == unifParameter.size() && nodeBounds.size() == nodes.size());
+    shader.bind();
+    // Identity framing of texCoord[0]
+    CompositingShader::bind(viewport, outputBounds, outputBounds);
+    for (size_t i = 0; i < inputBounds.size(); ++i) {
+        const ScaledBounds &b = inputBounds[i];
+        float framing[4] = {
+            float((outputBounds.a.x-b.a.x)/(b.b.x-b.a.x)),
+            float((outputBounds.a.y-b.a.y)/(b.b.y-b.a.y)),
+            float((outputBounds.b.x-outputBounds.a.x)/(b.b.x-b.a.x)),
+            float((outputBounds.b.y-outputBounds.a.y)/(b.b.y-b.a.y)),
+        };
+        unifInputFraming[i].setVec4(framing);
+    }
+    for (size_t k = 0; k < nodes.size(); ++k) {
+        const CompositingChain::Node &node = nodes[k];
+        switch (node.operation) {
+            case CompositingChain::MASK:
+            case CompositingChain::MIX_MASK:
+                {
+                    float maskChannelFactor[4] = {
+                        float(node.channelMatrix.m[0]),
+                        float(node.channelMatrix.m[1]),
+                        float(node.channelMatrix.m[2]),
+                        float(node.channelMatrix.m[3]),
+                    };
+                    unifMaskChannelFactor[k].setVec4(maskChannelFactor);
+                    unifMaskBias[k].setFloat(float(node.channelMatrix.m[4]));
+                    break;
+                }
+            case CompositingChain::BLEND_IGNORE_ALPHA:
+            case CompositingChain::MIX:
+            case CompositingChain::MULTIPLY_ALPHA:
+                unifParameter[k].setFloat(float(node.parameter));
+                break;
+            default:
+                break;
+        }
+        if (node.operation != CompositingChain::INPUT && k+1 < nodes.size()) {
+            float clipBounds[4] = { };
+            if (nodeBounds[k]) {
+                // In window coordinates of the viewport
+                clipBounds[0] = float(nodeBounds[k].a.x-viewport.a.x);
+                clipBounds[1] = float(nodeBounds[k].a.y-viewport.a.y);
+                clipBounds[2] = float(nodeBounds[k].b.x-viewport.a.x);
+                clipBounds[3] = float(nodeBounds[k].b.y-viewport.a.y);
+            }
+            unifClipBounds[k].setVec4(clipBounds);
+        }
+    }
+}
+
+}
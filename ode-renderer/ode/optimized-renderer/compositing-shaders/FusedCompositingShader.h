@@ -0,0 +1,30 @@
+
+#pragma once
+
+#include <vector>
+#include <ode-logic.h>
+#include "../CompositingChain.h"
+#include "CompositingShader.h"
+
+namespace ode {
+
+/// Evaluates a whole CompositingChain in a single pass - the i-th input image is bound to texture unit i
+class FusedCompositingShader : public CompositingShader {
+
+public:
+    FusedCompositingShader();
+    bool initialize(const SharedResource &res, const CompositingChain &chain);
+    /// nodes must correspond to the chain's nodes (parameters and channel matrices may differ), nodeBounds are the bounds of the intermediate results, to which they are clipped
+    void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const std::vector<ScaledBounds> &inputBounds, const std::vector<CompositingChain::Node> &nodes, const std::vector<ScaledBounds> &nodeBounds);
+
+private:
+    ShaderProgram shader;
+    std::vector<Uniform> unifInputFraming;
+    std::vector<Uniform> unifParameter;
+    std::vector<Uniform> unifMaskChannelFactor;
+    std::vector<Uniform> unifMaskBias;
+    std::vector<Uniform> unifClipBounds;
+
+};
+
+}
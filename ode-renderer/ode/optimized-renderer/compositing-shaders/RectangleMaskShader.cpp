@@ -0,0 +1,63 @@
+
+#include "RectangleMaskShader.h"
+
+#include <algorithm>
+
+namespace ode {
+
+RectangleMaskShader::RectangleMaskShader() = default;
+
+bool RectangleMaskShader::initialize(const SharedResource& res) {
+    // texCoord[2] spans the rectangle, coverage is derived from the signed distance to its rounded boundary
+    const StringLiteral fsSrc = ODE_STRLIT(
+        ODE_GLSL_FVARYING "vec2 texCoord[3];"
+        "uniform sampler2D a;"
+        "uniform sampler2D b;"
+        "uniform vec2 rectangleSize;"
+        "uniform float cornerRadius;"
+        "uniform float maskFactor;"
+        "uniform float maskBias;"
+        "void main() {"
+            "vec2 q = abs((texCoord[2]-0.5)*rectangleSize)-0.5*rectangleSize+cornerRadius;"
+            "float dist = length(max(q, 0.0))+min(max(q.x, q.y), 0.0)-cornerRadius;"
+            "float ratio = maskFactor*clamp(0.5-dist, 0.0, 1.0) + maskBias;"
+            ODE_GLSL_FRAGCOLOR "= mix(" ODE_GLSL_TEXTURE2D "(a, texCoord[0]), " ODE_GLSL_TEXTURE2D "(b, texCoord[1]), ratio);"
+        "}\n"
+    );
+    if (!res)
+        return false;
+    FragmentShader fs("compositing-rectangle-mask");
+    const GLchar *src[] = { ODE_COMPOSITING_SHADER_PREAMBLE, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_COMPOSITING_SHADER_PREAMBLE)-1, fsSrc.length };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+    unifAImage = shader.getUniform("a");
+    unifBImage = shader.getUniform("b");
+    unifRectangleSize = shader.getUniform("rectangleSize");
+    unifCornerRadius = shader.getUniform("cornerRadius");
+    unifMaskFactor = shader.getUniform("maskFactor");
+    unifMaskBias = shader.getUniform("maskBias");
+    shader.bind();
+    unifAImage.setInt(UNIT_A);
+    unifBImage.setInt(UNIT_B);
+    return CompositingShader::initialize(&shader);
+}
+
+void RectangleMaskShader::bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &aBounds, const ScaledBounds &bBounds, const ScaledBounds &rectangle, double cornerRadius, double maskFactor, double maskBias) {
+    shader.bind();
+    CompositingShader::bind(viewport, outputBounds, aBounds, bBounds, rectangle);
+    Vector2d rectangleSize = rectangle.dimensions();
+    float rectangleSizeVec[2] = {
+        float(rectangleSize.x),
+        float(rectangleSize.y)
+    };
+    unifRectangleSize.setVec2(rectangleSizeVec);
+    // Radius is limited so that the corners do not overlap
+    unifCornerRadius.setFloat(float(std::min(cornerRadius, .5*std::min(rectangleSize.x, rectangleSize.y))));
+    unifMaskFactor.setFloat(float(maskFactor));
+    unifMaskBias.setFloat(float(maskBias));
+}
+
+}
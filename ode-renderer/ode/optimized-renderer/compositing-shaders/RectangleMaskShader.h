@@ -0,0 +1,32 @@
+
+#pragma once
+
+#include <ode-logic.h>
+#include "CompositingShader.h"
+
+namespace ode {
+
+/// Mixes two images by the analytically computed coverage of an axis-aligned rectangle with rounded corners (instead of a mask image)
+class RectangleMaskShader : public CompositingShader {
+
+public:
+    static constexpr int UNIT_A = 0;
+    static constexpr int UNIT_B = 1;
+
+    RectangleMaskShader();
+    bool initialize(const SharedResource &res);
+    /// The mix ratio is maskFactor times the rectangle's coverage plus maskBias
+    void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &aBounds, const ScaledBounds &bBounds, const ScaledBounds &rectangle, double cornerRadius, double maskFactor, double maskBias);
+
+private:
+    ShaderProgram shader;
+    Uniform unifAImage;
+    Uniform unifBImage;
+    Uniform unifRectangleSize;
+    Uniform unifCornerRadius;
+    Uniform unifMaskFactor;
+    Uniform unifMaskBias;
+
+};
+
+}
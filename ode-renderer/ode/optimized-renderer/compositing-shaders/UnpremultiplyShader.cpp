@@ -0,0 +1,37 @@
+
+#include "UnpremultiplyShader.h"
+
+namespace ode {
+
+UnpremultiplyShader::UnpremultiplyShader() = default;
+
+bool UnpremultiplyShader::initialize(const SharedResource &res) {
+    const StringLiteral fsSrc = ODE_STRLIT(
+        ODE_GLSL_FVARYING "vec2 texCoord[3];"
+        "uniform sampler2D src;"
+        "void main() {"
+            "vec4 color = " ODE_GLSL_TEXTURE2D "(src, texCoord[0]);"
+            ODE_GLSL_FRAGCOLOR "= color.a > 0.0 ? vec4(color.rgb/color.a, color.a) : vec4(0.0);"
+        "}\n"
+    );
+    if (!res)
+        return false;
+    FragmentShader fs("compositing-unpremultiply");
+    const GLchar *src[] = { ODE_COMPOSITING_SHADER_PREAMBLE, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_COMPOSITING_SHADER_PREAMBLE)-1, fsSrc.length };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+    unifSrcImage = shader.getUniform("src");
+    shader.bind();
+    unifSrcImage.setInt(UNIT_IN);
+    return CompositingShader::initialize(&shader);
+}
+
+void UnpremultiplyShader::bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &inputBounds) {
+    shader.bind();
+    CompositingShader::bind(viewport, outputBounds, inputBounds);
+}
+
+}
@@ -0,0 +1,24 @@
+
+#pragma once
+
+#include "CompositingShader.h"
+
+namespace ode {
+
+/// Converts an alpha-premultiplied image to normal (unpremultiplied) color representation
+class UnpremultiplyShader : public CompositingShader {
+
+public:
+    static constexpr int UNIT_IN = 0;
+
+    UnpremultiplyShader();
+    bool initialize(const SharedResource &res);
+    void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &inputBounds);
+
+private:
+    ShaderProgram shader;
+    Uniform unifSrcImage;
+
+};
+
+}
@@ -8,3 +8,6 @@
 #include "MixShader.h"
 #include "MixMaskShader.h"
 #include "AlphaMultShader.h"
+#include "UnpremultiplyShader.h"
+#include "RectangleMaskShader.h"
+#include "FusedCompositingShader.h"
@@ -0,0 +1,60 @@
+
+#include "JumpFloodSeedShader.h"
+
+#include <cstdio>
+#include <cstring>
+#include "jump-flood-codec.h"
+
+namespace ode {
+
+JumpFloodSeedShader::JumpFloodSeedShader() = default;
+
+bool JumpFloodSeedShader::initialize(const SharedResource &res, char channel) {
+    ODE_ASSERT(channel);
+    if (!res)
+        return false;
+    char macros[64];
+    snprintf(macros, sizeof(macros), "#define CHANNEL %c\n", channel);
+    // Pixels whose opacity is at least one half are inside, the basis is transparent outside of its bounds
+    const StringLiteral fsSrc = ODE_STRLIT(
+        ODE_JUMP_FLOOD_CODEC_SOURCE
+        ODE_GLSL_FVARYING "vec2 texCoord;"
+        "uniform sampler2D basis;"
+        "uniform vec2 pixelStep;"
+        "bool isInside(vec2 coord) {"
+            "return all(greaterThanEqual(coord, vec2(0.0))) && all(lessThanEqual(coord, vec2(1.0))) && " ODE_GLSL_TEXTURE2D "(basis, coord).CHANNEL >= 0.5;"
+        "}"
+        "void main() {"
+            "bool inside = isInside(texCoord);"
+            "bool edge = inside && !("
+                "isInside(texCoord-vec2(pixelStep.x, 0.0)) && isInside(texCoord+vec2(pixelStep.x, 0.0)) &&"
+                "isInside(texCoord-vec2(0.0, pixelStep.y)) && isInside(texCoord+vec2(0.0, pixelStep.y))"
+            ");"
+            ODE_GLSL_FRAGCOLOR "= encodeSeed(floor(gl_FragCoord.xy), edge, inside);"
+        "}\n"
+    );
+    FragmentShader fs("effect-jump-flood-seed");
+    const GLchar *src[] = { ODE_EFFECT_SHADER_PREAMBLE, ODE_JUMP_FLOOD_PRECISION_SOURCE, macros, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_EFFECT_SHADER_PREAMBLE)-1, sizeof(ODE_JUMP_FLOOD_PRECISION_SOURCE)-1, (GLint) strlen(macros), fsSrc.length };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+    unifBasis = shader.getUniform("basis");
+    unifPixelStep = shader.getUniform("pixelStep");
+    shader.bind();
+    unifBasis.setInt(UNIT_BASIS);
+    return EffectShader::initialize(&shader);
+}
+
+void JumpFloodSeedShader::bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &inputBounds) {
+    shader.bind();
+    EffectShader::bind(viewport, outputBounds, inputBounds);
+    float pixelStep[2] = {
+        float(1/inputBounds.dimensions().x),
+        float(1/inputBounds.dimensions().y)
+    };
+    unifPixelStep.setVec2(pixelStep);
+}
+
+}
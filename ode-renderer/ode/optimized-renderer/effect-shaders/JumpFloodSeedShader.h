@@ -0,0 +1,25 @@
+
+#pragma once
+
+#include <ode-graphics.h>
+#include "EffectShader.h"
+
+namespace ode {
+
+/// Initializes jump flooding - marks pixels on the inner edge of the basis as seeds
+class JumpFloodSeedShader : public EffectShader {
+
+public:
+    JumpFloodSeedShader();
+    bool initialize(const SharedResource &res, char channel);
+    /// The output must fill the viewport
+    void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &inputBounds);
+
+private:
+    ShaderProgram shader;
+    Uniform unifBasis;
+    Uniform unifPixelStep;
+
+};
+
+}
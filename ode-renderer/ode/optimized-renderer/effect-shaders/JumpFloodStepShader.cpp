@@ -0,0 +1,62 @@
+
+#include "JumpFloodStepShader.h"
+
+#include "jump-flood-codec.h"
+
+namespace ode {
+
+JumpFloodStepShader::JumpFloodStepShader() = default;
+
+bool JumpFloodStepShader::initialize(const SharedResource &res) {
+    if (!res)
+        return false;
+    const StringLiteral fsSrc = ODE_STRLIT(
+        ODE_JUMP_FLOOD_CODEC_SOURCE
+        ODE_GLSL_FVARYING "vec2 texCoord;"
+        "uniform sampler2D basis;"
+        "uniform vec2 jumpStep;"
+        "void main() {"
+            "vec2 position = floor(gl_FragCoord.xy);"
+            "vec4 own = decodeSeed(" ODE_GLSL_TEXTURE2D "(basis, texCoord));"
+            "vec2 nearestSeed = vec2(0.0);"
+            "float minSquaredDistance = -1.0;"
+            "for (int y = -1; y <= 1; ++y) {"
+                "for (int x = -1; x <= 1; ++x) {"
+                    "vec4 seed = decodeSeed(" ODE_GLSL_TEXTURE2D "(basis, texCoord+vec2(float(x), float(y))*jumpStep));"
+                    "vec2 delta = seed.xy-position;"
+                    "float squaredDistance = dot(delta, delta);"
+                    "if (seed.z != 0.0 && (minSquaredDistance < 0.0 || squaredDistance < minSquaredDistance)) {"
+                        "nearestSeed = seed.xy;"
+                        "minSquaredDistance = squaredDistance;"
+                    "}"
+                "}"
+            "}"
+            ODE_GLSL_FRAGCOLOR "= encodeSeed(nearestSeed, minSquaredDistance >= 0.0, own.w != 0.0);"
+        "}\n"
+    );
+    FragmentShader fs("effect-jump-flood-step");
+    const GLchar *src[] = { ODE_EFFECT_SHADER_PREAMBLE, ODE_JUMP_FLOOD_PRECISION_SOURCE, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_EFFECT_SHADER_PREAMBLE)-1, sizeof(ODE_JUMP_FLOOD_PRECISION_SOURCE)-1, fsSrc.length };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+    unifBasis = shader.getUniform("basis");
+    unifJumpStep = shader.getUniform("jumpStep");
+    shader.bind();
+    unifBasis.setInt(UNIT_BASIS);
+    return EffectShader::initialize(&shader);
+}
+
+void JumpFloodStepShader::bind(const PixelBounds &viewport, int jump) {
+    shader.bind();
+    ScaledBounds bounds(Vector2d(viewport.a), Vector2d(viewport.b)); // TODO proper conversion
+    EffectShader::bind(viewport, bounds, bounds);
+    float jumpStep[2] = {
+        float(jump)/float(viewport.dimensions().x),
+        float(jump)/float(viewport.dimensions().y)
+    };
+    unifJumpStep.setVec2(jumpStep);
+}
+
+}
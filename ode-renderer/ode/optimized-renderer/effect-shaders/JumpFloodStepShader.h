@@ -0,0 +1,25 @@
+
+#pragma once
+
+#include <ode-graphics.h>
+#include "EffectShader.h"
+
+namespace ode {
+
+/// A single jump flooding pass - each pixel adopts the nearest seed of its neighbors at the jump distance
+class JumpFloodStepShader : public EffectShader {
+
+public:
+    JumpFloodStepShader();
+    bool initialize(const SharedResource &res);
+    /// Input and output bounds must be the viewport (the previous pass), jump is in pixels
+    void bind(const PixelBounds &viewport, int jump);
+
+private:
+    ShaderProgram shader;
+    Uniform unifBasis;
+    Uniform unifJumpStep;
+
+};
+
+}
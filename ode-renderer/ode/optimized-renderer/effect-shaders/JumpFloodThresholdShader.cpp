@@ -0,0 +1,65 @@
+
+#include "JumpFloodThresholdShader.h"
+
+#include "jump-flood-codec.h"
+
+namespace ode {
+
+JumpFloodThresholdShader::JumpFloodThresholdShader() = default;
+
+bool JumpFloodThresholdShader::initialize(const SharedResource &res) {
+    if (!res)
+        return false;
+    // Seeds are the centers of the outermost inside pixels, so the edge is half a pixel beyond them
+    const StringLiteral fsSrc = ODE_STRLIT(
+        ODE_JUMP_FLOOD_CODEC_SOURCE
+        ODE_GLSL_FVARYING "vec2 texCoord;"
+        "uniform sampler2D seeds;"
+        "uniform vec2 positionOffset;"
+        "uniform vec2 threshold;"
+        "uniform vec4 color;"
+        "void main() {"
+            "vec4 seed = decodeSeed(" ODE_GLSL_TEXTURE2D "(seeds, texCoord));"
+            "float dist = seed.z != 0.0 ? length(seed.xy-floor(gl_FragCoord.xy)-positionOffset) : 65536.0;"
+            "float sd = seed.w != 0.0 ? dist+0.5 : 0.5-dist;"
+            "float opacity = clamp(sd-threshold[0]+0.5, 0.0, 1.0)*clamp(threshold[1]-sd+0.5, 0.0, 1.0);"
+            ODE_GLSL_FRAGCOLOR "= opacity*color;"
+        "}\n"
+    );
+    FragmentShader fs("effect-jump-flood-threshold");
+    const GLchar *src[] = { ODE_EFFECT_SHADER_PREAMBLE, ODE_JUMP_FLOOD_PRECISION_SOURCE, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_EFFECT_SHADER_PREAMBLE)-1, sizeof(ODE_JUMP_FLOOD_PRECISION_SOURCE)-1, fsSrc.length };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+    unifSeeds = shader.getUniform("seeds");
+    unifPositionOffset = shader.getUniform("positionOffset");
+    unifThreshold = shader.getUniform("threshold");
+    unifColor = shader.getUniform("color");
+    shader.bind();
+    unifSeeds.setInt(UNIT_BASIS);
+    return EffectShader::initialize(&shader);
+}
+
+void JumpFloodThresholdShader::bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const PixelBounds &inputBounds, float lowerThreshold, float upperThreshold, const Color &color) {
+    shader.bind();
+    EffectShader::bind(viewport, outputBounds, ScaledBounds(Vector2d(inputBounds.a), Vector2d(inputBounds.b)));
+    // Converts pixel coordinates of the viewport to those of the input
+    float positionOffset[2] = {
+        float(viewport.a.x-inputBounds.a.x),
+        float(viewport.a.y-inputBounds.a.y)
+    };
+    float threshold[2] = { lowerThreshold, upperThreshold };
+    float premultipliedColor[4] = {
+        float(color.a*color.r),
+        float(color.a*color.g),
+        float(color.a*color.b),
+        float(color.a)
+    };
+    unifPositionOffset.setVec2(positionOffset);
+    unifThreshold.setVec2(threshold);
+    unifColor.setVec4(premultipliedColor);
+}
+
+}
@@ -0,0 +1,27 @@
+
+#pragma once
+
+#include <ode-graphics.h>
+#include "EffectShader.h"
+
+namespace ode {
+
+/// Thresholds the signed distance to the basis' edge given by the nearest seeds found by jump flooding
+class JumpFloodThresholdShader : public EffectShader {
+
+public:
+    JumpFloodThresholdShader();
+    bool initialize(const SharedResource &res);
+    /// inputBounds must be the bounds of the jump flooding viewport
+    void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const PixelBounds &inputBounds, float lowerThreshold, float upperThreshold, const Color &color);
+
+private:
+    ShaderProgram shader;
+    Uniform unifSeeds;
+    Uniform unifPositionOffset;
+    Uniform unifThreshold;
+    Uniform unifColor;
+
+};
+
+}
@@ -0,0 +1,91 @@
+
+#include "RectangleShadowShader.h"
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+namespace ode {
+
+RectangleShadowShader::RectangleShadowShader() : precision(0) { }
+
+bool RectangleShadowShader::initialize(const SharedResource &res, int precision) {
+    ODE_ASSERT(precision > 0);
+    if (!res)
+        return false;
+    char stepsDefine[64];
+    snprintf(stepsDefine, sizeof(stepsDefine), "#define STEPS %d\n", 2*precision);
+    // The bounded blur kernel is a triangle (see BoundedBlurShader) - its integral is evaluated exactly in both directions for the sharp rectangle.
+    // The area cut off by the rounded corners is integrated exactly horizontally and sampled vertically like in the second phase of BoundedBlurShader
+    const StringLiteral fsSrc = ODE_STRLIT(
+        "const float STEP_WEIGHT = 1.0/float(STEPS+1);"
+        ODE_GLSL_FVARYING "vec2 texCoord;"
+        "uniform vec2 rectangleSize;"
+        "uniform float cornerRadius;"
+        "uniform float radius;"
+        "uniform float inverted;"
+        "uniform vec4 color;"
+        "float kernelIntegral(float x) {"
+            "float t = clamp(x/radius, -1.0, 1.0);"
+            "return t < 0.0 ? 0.5*(1.0+t)*(1.0+t) : 1.0-0.5*(1.0-t)*(1.0-t);"
+        "}"
+        "float cornerCoverage(vec2 position) {"
+            "if (position.y < 0.0 || position.y > rectangleSize.y)"
+                "return 0.0;"
+            "float dy = max(max(cornerRadius-position.y, position.y-rectangleSize.y+cornerRadius), 0.0);"
+            "float inset = cornerRadius-sqrt(max(cornerRadius*cornerRadius-dy*dy, 0.0));"
+            "return kernelIntegral(position.x)-kernelIntegral(position.x-inset)+kernelIntegral(position.x-rectangleSize.x+inset)-kernelIntegral(position.x-rectangleSize.x);"
+        "}"
+        "void main() {"
+            "vec2 position = texCoord*rectangleSize;"
+            "float coverage = (kernelIntegral(position.x)-kernelIntegral(position.x-rectangleSize.x))*(kernelIntegral(position.y)-kernelIntegral(position.y-rectangleSize.y));"
+            "if (cornerRadius > 0.0) {"
+                "float cutOff = cornerCoverage(position);"
+                "for (int i = STEPS-1; i > 0; i -= 2) {"
+                    "vec2 offset = vec2(0.0, (1.0-sqrt(STEP_WEIGHT*float(i)))*radius);"
+                    "cutOff += cornerCoverage(position-offset);"
+                    "cutOff += cornerCoverage(position+offset);"
+                "}"
+                "coverage -= STEP_WEIGHT*cutOff;"
+            "}"
+            "coverage = clamp(coverage, 0.0, 1.0);"
+            ODE_GLSL_FRAGCOLOR "= mix(coverage, 1.0-coverage, inverted)*color;"
+        "}\n"
+    );
+    FragmentShader fs("effect-rect-shadow");
+    const GLchar *src[] = { ODE_EFFECT_SHADER_PREAMBLE, stepsDefine, fsSrc.string };
+    const GLint sln[] = { sizeof(ODE_EFFECT_SHADER_PREAMBLE)-1, (GLint) strlen(stepsDefine), fsSrc.length };
+    if (!fs.initialize(src, sln, sizeof(src)/sizeof(*src)))
+        return false;
+    if (!shader.initialize(getVertexShader(res), &fs))
+        return false;
+    this->precision = precision;
+    unifRectangleSize = shader.getUniform("rectangleSize");
+    unifCornerRadius = shader.getUniform("cornerRadius");
+    unifRadius = shader.getUniform("radius");
+    unifInverted = shader.getUniform("inverted");
+    unifColor = shader.getUniform("color");
+    return EffectShader::initialize(&shader);
+}
+
+void RectangleShadowShader::bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &rectangle, double cornerRadius, double radius, bool inverted, const Color &color) {
+    ODE_ASSERT(radius > 0);
+    shader.bind();
+    // texCoord spans the rectangle
+    EffectShader::bind(viewport, outputBounds, rectangle);
+    Vector2d dimensions = rectangle.dimensions();
+    float rectangleSize[2] = { float(std::max(dimensions.x, 0.)), float(std::max(dimensions.y, 0.)) };
+    float premultipliedColor[4] = {
+        float(color.a*color.r),
+        float(color.a*color.g),
+        float(color.a*color.b),
+        float(color.a)
+    };
+    unifRectangleSize.setVec2(rectangleSize);
+    unifCornerRadius.setFloat(float(std::max(std::min(cornerRadius, .5*std::min(dimensions.x, dimensions.y)), 0.)));
+    unifRadius.setFloat(float(radius));
+    unifInverted.setFloat(inverted ? 1.f : 0.f);
+    unifColor.setVec4(premultipliedColor);
+}
+
+}
@@ -0,0 +1,29 @@
+
+#pragma once
+
+#include <ode-graphics.h>
+#include "EffectShader.h"
+
+namespace ode {
+
+/// Evaluates the bounded blur of a rounded rectangle analytically (without a basis image)
+class RectangleShadowShader : public EffectShader {
+
+public:
+    RectangleShadowShader();
+    bool initialize(const SharedResource &res, int precision);
+    /// If inverted, the shadow color is applied outside of the blurred rectangle (inner shadow)
+    void bind(const PixelBounds &viewport, const ScaledBounds &outputBounds, const ScaledBounds &rectangle, double cornerRadius, double radius, bool inverted, const Color &color);
+
+private:
+    ShaderProgram shader;
+    int precision;
+    Uniform unifRectangleSize;
+    Uniform unifCornerRadius;
+    Uniform unifRadius;
+    Uniform unifInverted;
+    Uniform unifColor;
+
+};
+
+}
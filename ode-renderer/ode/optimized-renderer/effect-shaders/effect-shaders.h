@@ -6,3 +6,7 @@
 #include "GaussianBlurShader.h"
 #include "DistanceTransformShader.h"
 #include "DistanceThresholdShader.h"
+#include "JumpFloodSeedShader.h"
+#include "JumpFloodStepShader.h"
+#include "JumpFloodThresholdShader.h"
+#include "RectangleShadowShader.h"
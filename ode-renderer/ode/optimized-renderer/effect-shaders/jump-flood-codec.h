@@ -0,0 +1,30 @@
+
+#pragma once
+
+/// Requests high precision in GLSL ES fragment shaders (pixel coordinates exceed the range of mediump)
+#define ODE_JUMP_FLOOD_PRECISION_SOURCE \
+    "#ifdef GL_ES\n" \
+    "#ifdef GL_FRAGMENT_PRECISION_HIGH\n" \
+    "precision highp float;\n" \
+    "#endif\n" \
+    "#endif\n"
+
+/// GLSL functions that store nearest seed records in RGBA8 texels - red and green hold the seed's pixel x + 1 (0 if there is no seed),
+/// blue and alpha hold its pixel y plus 32768 if the texel itself is inside the shape
+#define ODE_JUMP_FLOOD_CODEC_SOURCE \
+    "vec2 encodeUint16(float v) {" \
+        "float hi = floor(v/256.0);" \
+        "return vec2(hi, v-256.0*hi)/255.0;" \
+    "}" \
+    "float decodeUint16(vec2 e) {" \
+        "return 256.0*floor(255.0*e.x+0.5)+floor(255.0*e.y+0.5);" \
+    "}" \
+    "vec4 encodeSeed(vec2 seed, bool hasSeed, bool inside) {" \
+        "return vec4(encodeUint16(hasSeed ? seed.x+1.0 : 0.0), encodeUint16(seed.y+(inside ? 32768.0 : 0.0)));" \
+    "}" \
+    "vec4 decodeSeed(vec4 texel) {" \
+        "float x = decodeUint16(texel.rg);" \
+        "float y = decodeUint16(texel.ba);" \
+        "float inside = step(32768.0, y);" \
+        "return vec4(x-1.0, y-32768.0*inside, step(0.5, x), inside);" \
+    "}"
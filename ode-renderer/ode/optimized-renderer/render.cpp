@@ -6,11 +6,7 @@
 
 namespace ode {
 
-PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time) {
-    if (!root)
-        return renderer.reframe(nullptr, bounds);
-
-    RenderContext renderContext(renderer, imageBase, component, scale, bounds, time);
+static PlacedImagePtr evaluate(RenderContext &renderContext, const Rendexptr &root) {
     std::stack<std::pair<const Rendexpr *, int> > exprStack;
 
     exprStack.push(std::make_pair(root.get(), 0));
@@ -26,11 +22,21 @@ PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &compo
     return renderContext.finish();
 }
 
+PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time) {
+    if (!root)
+        return renderer.reframe(nullptr, bounds);
+    RenderContext renderContext(renderer, imageBase, component, scale, bounds, time);
+    return evaluate(renderContext, root);
+}
+
 PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, const std::function<void(const Rendexpr *, const PlacedImagePtr &)> &hook) {
     if (!root)
         return renderer.reframe(nullptr, bounds);
 
     RenderContext renderContext(renderer, imageBase, component, scale, bounds, time);
+    // The hook must observe the result of each expression
+    renderContext.setCompositingFusion(false);
+    renderContext.setSubtreeRetention(false);
     std::stack<std::pair<const Rendexpr *, int> > exprStack;
 
     exprStack.push(std::make_pair(root.get(), 0));
@@ -46,4 +52,31 @@ PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &compo
     return renderContext.finish();
 }
 
+void planExecution(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, const std::function<void(const Rendexpr *, const ExecutionPlan::Estimate &)> &output) {
+    if (!root)
+        return;
+    RenderContext renderContext(renderer, imageBase, component, scale, bounds, time);
+    for (const std::pair<const Rendexpr *const, ExecutionPlan::Estimate> &estimate : renderContext.executionPlan(root.get()).estimates())
+        output(estimate.first, estimate.second);
+}
+
+bool renderTiled(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, int tileSize, const std::function<bool(const PlacedImagePtr &tile)> &output) {
+    ODE_ASSERT(tileSize > 0);
+    for (int y = bounds.a.y; y < bounds.b.y; y += tileSize) {
+        for (int x = bounds.a.x; x < bounds.b.x; x += tileSize) {
+            PixelBounds tileBounds(x, y, std::min(x+tileSize, bounds.b.x), std::min(y+tileSize, bounds.b.y));
+            PlacedImagePtr tile;
+            if (root) {
+                RenderContext renderContext(renderer, imageBase, component, scale, tileBounds, time);
+                renderContext.restrictToBounds(root.get());
+                tile = evaluate(renderContext, root);
+            } else
+                tile = renderer.reframe(nullptr, tileBounds);
+            if (!output(tile))
+                return false;
+        }
+    }
+    return true;
+}
+
 }
@@ -6,6 +6,7 @@
 #include "../image/Image.h"
 #include "../image/ImageBase.h"
 #include "Renderer.h"
+#include "ExecutionPlan.h"
 
 namespace ode {
 
@@ -14,4 +15,11 @@ PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &compo
 
 PlacedImagePtr render(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, const std::function<void(const Rendexpr *, const PlacedImagePtr &)> &hook);
 
+/// Passes the device on which the operation of each expression of the tree would be evaluated by a render with the same parameters, and its cost estimates, to output (see ExecutionPlan)
+void planExecution(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, const std::function<void(const Rendexpr *, const ExecutionPlan::Estimate &)> &output);
+
+/// Renders the component's bounds in square tiles of at most tileSize pixels in row-major order, passing each to output, which may abort the process by returning false.
+/// Only content which can affect the tile is drawn for each tile, so memory consumption depends on the tile size rather than the size of bounds
+bool renderTiled(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &root, double scale, const PixelBounds &bounds, double time, int tileSize, const std::function<bool(const PlacedImagePtr &tile)> &output);
+
 }
@@ -1,7 +1,11 @@
 
 #include "renderer-api.h"
 
+#include <algorithm>
+#include <cmath>
+#include <map>
 #include <memory>
+#include <vector>
 #include <octopus/octopus.h>
 #include <ode-logic.h>
 
@@ -13,6 +17,8 @@
 #include "image/ImageBase.h"
 #include "optimized-renderer/Renderer.h"
 #include "optimized-renderer/render.h"
+#include "optimized-renderer/ProgressiveRenderJob.h"
+#include "optimized-renderer/TilePyramid.h"
 
 using namespace ode;
 
@@ -20,9 +26,16 @@ const int ODE_PIXEL_FORMAT_RGB = int(PixelFormat::RGB);
 const int ODE_PIXEL_FORMAT_RGBA = int(PixelFormat::RGBA);
 const int ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA = int(PixelFormat::PREMULTIPLIED_RGBA);
 
+// Maximum side of a tile when the output is rendered in tiles - a tile is extended by the reach of effects while being rendered
+static constexpr int MAX_RENDER_TILE_SIZE = 2048;
+
+// Number of idle pixel readbacks kept by the renderer context, so that the next transfer can overlap with the previous one without allocating a new buffer
+static constexpr size_t IDLE_READBACK_POOL_SIZE = 2;
+
 struct ODE_internal_RendererContext {
     GraphicsContext gc;
     std::unique_ptr<Renderer> renderer;
+    std::vector<TextureReadback> idleReadbacks;
 
     inline ODE_internal_RendererContext(const char *label, const Vector2i &dimensions) : gc(label, dimensions) { }
     inline ODE_internal_RendererContext(GraphicsContext::Offscreen offscreen, const Vector2i &dimensions) : gc(offscreen, dimensions) { }
@@ -34,6 +47,13 @@ struct ODE_internal_DesignImageBase {
     inline explicit ODE_internal_DesignImageBase(GraphicsContext &gc) : imageBase(gc) { }
 };
 
+struct ODE_internal_PendingBitmap {
+    ODE_internal_RendererContext *rendererContext;
+    TextureReadback readback;
+
+    inline ODE_internal_PendingBitmap(ODE_internal_RendererContext *rendererContext, TextureReadback &&readback) : rendererContext(rendererContext), readback((TextureReadback &&) readback) { }
+};
+
 struct ODE_internal_AnimationRenderer {
     Renderer *renderer;
     ImageBase *imageBase;
@@ -42,6 +62,56 @@ struct ODE_internal_AnimationRenderer {
     int renderRevision;
 };
 
+struct ODE_internal_RetainedRenderer {
+    Renderer *renderer;
+    ImageBase *imageBase;
+    Design::ComponentAccessor component;
+    Rendexptr renderExpression;
+    int renderRevision;
+    /// Pixel bounds and scale of the previous output, zero scale if there is none
+    PixelBounds outputBounds;
+    double outputScale;
+    /// Component's damage serial number at the time of the previous output
+    int outputDamageSerial;
+};
+
+struct ODE_internal_RenderJob {
+    Renderer *renderer;
+    Design::ComponentAccessor component;
+    /// Component revision the job's render expression was assembled from
+    int renderRevision;
+    PixelBounds bounds;
+    std::unique_ptr<ProgressiveRenderJob> job;
+};
+
+struct ODE_internal_RenderBatch {
+    struct Entry {
+        Design::ComponentAccessor component;
+        ODE_PR1_FrameView frameView;
+    };
+
+    ODE_internal_RendererContext *rendererContext;
+    ImageBase *imageBase;
+    Design *design;
+    std::vector<Entry> entries;
+};
+
+#ifndef __EMSCRIPTEN__
+struct ODE_internal_TilePyramid {
+    Design::ComponentAccessor component;
+    std::unique_ptr<TilePyramid> pyramid;
+};
+#endif
+
+// TODO !!!!!! move to common file (duplicate of logic-api)
+struct ODE_internal_Design {
+    ODE_internal_Engine *engine;
+    Design design;
+
+    inline ODE_internal_Design(ODE_internal_Engine *engine) : engine(engine), design() { }
+    inline explicit ODE_internal_Design(ODE_internal_Engine *engine, Design &&design) : engine(engine), design((Design &&) design) { }
+};
+
 // TODO !!!!!! move to common file (duplicate of logic-api)
 struct ODE_internal_Component {
     Design::ComponentAccessor accessor;
@@ -58,6 +128,13 @@ ODE_Result ODE_API ode_destroyBitmap(ODE_Bitmap bitmap) {
     return ODE_RESULT_OK;
 }
 
+ODE_Result ODE_API ode_destroyBitmapList(ODE_BitmapList bitmapList) {
+    for (int i = 0; i < bitmapList.n; ++i)
+        free(reinterpret_cast<void *>(bitmapList.entries[i].pixels));
+    free(bitmapList.entries);
+    return ODE_RESULT_OK;
+}
+
 ODE_Result ODE_API ode_createRendererContext(ODE_EngineHandle engine, ODE_RendererContextHandle *rendererContext, ODE_StringRef target) {
     ODE_ASSERT(engine.ptr && rendererContext);
     if (target.data)
@@ -78,6 +155,38 @@ ODE_Result ODE_API ode_destroyRendererContext(ODE_RendererContextHandle renderer
     return ODE_RESULT_OK;
 }
 
+ODE_Result ODE_API ode_rendererContext_setQuality(ODE_RendererContextHandle rendererContext, ODE_RenderQuality quality) {
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    switch (quality) {
+        case ODE_RENDER_QUALITY_FINAL:
+            rendererContext.ptr->renderer->setEffectQuality(EffectQuality::FINAL);
+            return ODE_RESULT_OK;
+        case ODE_RENDER_QUALITY_DRAFT:
+            rendererContext.ptr->renderer->setEffectQuality(EffectQuality::DRAFT);
+            return ODE_RESULT_OK;
+        case ODE_RENDER_QUALITY_PREVIEW:
+            rendererContext.ptr->renderer->setEffectQuality(EffectQuality::PREVIEW);
+            return ODE_RESULT_OK;
+    }
+    return ODE_RESULT_UNKNOWN_ERROR;
+}
+
+ODE_Result ODE_API ode_rendererContext_setDetailThreshold(ODE_RendererContextHandle rendererContext, ODE_Scalar threshold) {
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    rendererContext.ptr->renderer->setDetailThreshold(std::max(threshold, 0.));
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_rendererContext_warmUp(ODE_RendererContextHandle rendererContext) {
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    if (!rendererContext.ptr->renderer->warmUp())
+        return ODE_RESULT_UNKNOWN_ERROR;
+    return ODE_RESULT_OK;
+}
+
 ODE_Result ODE_API ode_createDesignImageBase(ODE_RendererContextHandle rendererContext, ODE_DesignHandle design, ODE_DesignImageBaseHandle *designImageBase) {
     ODE_ASSERT(design.ptr && designImageBase);
     if (!rendererContext.ptr)
@@ -113,33 +222,195 @@ ODE_Result ODE_API ode_design_loadImagePixels(ODE_DesignImageBaseHandle designIm
     return ODE_RESULT_OK;
 }
 
-ODE_Result ODE_API ode_pr1_drawComponent(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_Bitmap *outputBitmap, ODE_PR1_FrameView frameView) {
-    ODE_ASSERT(rendererContext.ptr && component.ptr && designImageBase.ptr && outputBitmap);
+static void exportBitmap(Bitmap &bitmap, ODE_Bitmap *outputBitmap) {
+    switch (bitmap.format()) {
+        case PixelFormat::RGBA:
+            outputBitmap->format = ODE_PIXEL_FORMAT_RGBA;
+            break;
+        case PixelFormat::PREMULTIPLIED_RGBA:
+            outputBitmap->format = ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA;
+            break;
+        default:
+            ODE_ASSERT(!"Unexpected bitmap format");
+    }
+    outputBitmap->width = bitmap.width();
+    outputBitmap->height = bitmap.height();
+    outputBitmap->pixels = reinterpret_cast<ODE_VarDataPtr>(bitmap.eject());
+}
+
+static PixelBounds frameViewBounds(const ODE_PR1_FrameView &frameView) {
+    return outerPixelBounds(ScaledBounds(0, 0, frameView.width, frameView.height)+frameView.scale*Vector2d(frameView.offset.x, frameView.offset.y));
+}
+
+static ODE_Result renderComponent(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, const ODE_PR1_FrameView &frameView, PlacedImagePtr &image) {
     if (Result<Rendexptr, DesignError> renderTree = component.ptr->accessor.assemble()) {
-        PixelBounds pixelBounds = outerPixelBounds(ScaledBounds(0, 0, frameView.width, frameView.height)+frameView.scale*Vector2d(frameView.offset.x, frameView.offset.y));
-        if (PlacedImagePtr image = render(*rendererContext.ptr->renderer, designImageBase.ptr->imageBase, *component.ptr->accessor.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), renderTree.value(), frameView.scale, pixelBounds, 0)) {
-            if (BitmapPtr bitmap = image->asBitmap()) {
-                switch (bitmap->format()) {
-                    case PixelFormat::RGBA:
-                        outputBitmap->format = ODE_PIXEL_FORMAT_RGBA;
-                        break;
-                    case PixelFormat::PREMULTIPLIED_RGBA:
-                        outputBitmap->format = ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA;
-                        break;
-                    default:
-                        ODE_ASSERT(!"Unexpected bitmap format");
-                }
-                outputBitmap->width = bitmap->width();
-                outputBitmap->height = bitmap->height();
-                outputBitmap->pixels = reinterpret_cast<ODE_VarDataPtr>(bitmap->eject());
-                return ODE_RESULT_OK;
-            }
-        }
+        PixelBounds pixelBounds = frameViewBounds(frameView);
+        if ((image = render(*rendererContext.ptr->renderer, designImageBase.ptr->imageBase, *component.ptr->accessor.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), renderTree.value(), frameView.scale, pixelBounds, 0)))
+            return ODE_RESULT_OK;
+        return ODE_RESULT_UNKNOWN_ERROR;
+    } else
+        return ode_result(renderTree.error().type());
+}
+
+/// Returns true if bounds are too large to be rendered as a single texture
+static bool requiresTiling(const PixelBounds &bounds) {
+    int maxTextureSize = GraphicsContext::getMaxTextureSize();
+    return maxTextureSize > 0 && (bounds.dimensions().x > maxTextureSize || bounds.dimensions().y > maxTextureSize);
+}
+
+static int renderTileSize() {
+    int maxTextureSize = GraphicsContext::getMaxTextureSize();
+    return maxTextureSize > 0 ? std::max(std::min(MAX_RENDER_TILE_SIZE, maxTextureSize/2), 1) : MAX_RENDER_TILE_SIZE;
+}
+
+static ODE_Result renderComponentTiled(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, double scale, const PixelBounds &bounds, int tileSize, const std::function<bool(const PlacedImagePtr &tile)> &output) {
+    if (Result<Rendexptr, DesignError> renderTree = component.ptr->accessor.assemble()) {
+        if (renderTiled(*rendererContext.ptr->renderer, designImageBase.ptr->imageBase, *component.ptr->accessor.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), renderTree.value(), scale, bounds, 0, tileSize, output))
+            return ODE_RESULT_OK;
         return ODE_RESULT_UNKNOWN_ERROR;
     } else
         return ode_result(renderTree.error().type());
 }
 
+ODE_Result ODE_API ode_pr1_drawComponent(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_Bitmap *outputBitmap, ODE_PR1_FrameView frameView) {
+    ODE_ASSERT(rendererContext.ptr && component.ptr && designImageBase.ptr && outputBitmap);
+    PlacedImagePtr image;
+    if (ODE_Result result = renderComponent(rendererContext, component, designImageBase, frameView, image))
+        return result;
+    if (BitmapPtr bitmap = image->asBitmap()) {
+        exportBitmap(*bitmap, outputBitmap);
+        return ODE_RESULT_OK;
+    }
+    return ODE_RESULT_UNKNOWN_ERROR;
+}
+
+ODE_Result ODE_API ode_pr1_drawComponentIntoBitmap(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_SparseBitmapRef outputBitmap, ODE_PR1_FrameView frameView) {
+    ODE_ASSERT(rendererContext.ptr && component.ptr && designImageBase.ptr);
+    const ptrdiff_t stride = outputBitmap.stride ? ptrdiff_t(outputBitmap.stride) : ptrdiff_t(pixelSize(PixelFormat::RGBA))*outputBitmap.width;
+    if (!(outputBitmap.format == ODE_PIXEL_FORMAT_RGBA || outputBitmap.format == ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA))
+        return ODE_RESULT_INVALID_PIXEL_FORMAT;
+    if (!(outputBitmap.width == frameView.width && outputBitmap.height == frameView.height))
+        return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    if (!outputBitmap.pixels)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    SparseBitmapRef bitmap(PixelFormat(outputBitmap.format), reinterpret_cast<void *>(outputBitmap.pixels), outputBitmap.width, outputBitmap.height, stride);
+    // The bitmap receives exactly the area of the frame view
+    PixelBounds bounds = frameViewBounds(frameView);
+    bounds.b = bounds.a+Vector2i(frameView.width, frameView.height);
+    if (requiresTiling(bounds)) {
+        Renderer &renderer = *rendererContext.ptr->renderer;
+        return renderComponentTiled(rendererContext, component, designImageBase, frameView.scale, bounds, renderTileSize(), [&](const PlacedImagePtr &tile) {
+            PixelBounds tileBounds = outerPixelBounds(tile.bounds());
+            return renderer.download(bitmap.subBitmap(Rectangle<int>(tileBounds.a-bounds.a, tileBounds.b-bounds.a)), tile);
+        });
+    }
+    PlacedImagePtr image;
+    if (ODE_Result result = renderComponent(rendererContext, component, designImageBase, frameView, image))
+        return result;
+    TexturePtr tex = image->asTexture();
+    if (!(tex && image.bounds() == ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b) && tex->dimensions() == bounds.dimensions()))
+        image = rendererContext.ptr->renderer->reframe(image, bounds);
+    if (!rendererContext.ptr->renderer->download(bitmap, image))
+        return ODE_RESULT_UNKNOWN_ERROR;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_drawComponentScales(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_BitmapList *outputBitmaps, ODE_PR1_FrameView frameView, ODE_ScalarList scales) {
+    ODE_ASSERT(outputBitmaps && (scales.entries || scales.n <= 0));
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    if (!component.ptr)
+        return ODE_RESULT_INVALID_COMPONENT;
+    if (!designImageBase.ptr)
+        return ODE_RESULT_INVALID_IMAGE_BASE;
+    outputBitmaps->entries = nullptr;
+    outputBitmaps->n = 0;
+    for (int i = 0; i < scales.n; ++i) {
+        if (!(scales.entries[i] > 0))
+            return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    }
+    // The render graph is assembled once for all scales, the component's shapes and text as well as the image base's decoded assets are retained between the renders
+    Result<Rendexptr, DesignError> renderTree = component.ptr->accessor.assemble();
+    if (!renderTree)
+        return ode_result(renderTree.error().type());
+    Renderer &renderer = *rendererContext.ptr->renderer;
+    ImageBase &imageBase = designImageBase.ptr->imageBase;
+    Component &renderedComponent = *component.ptr->accessor.TEMP_GET_COMPONENT_DELETE_ME_ASAP();
+    std::vector<Bitmap> bitmaps(std::max(scales.n, 0));
+    for (int i = 0; i < scales.n; ++i) {
+        ODE_PR1_FrameView scaledFrameView = frameView;
+        scaledFrameView.width = int(ceil(scales.entries[i]*frameView.width));
+        scaledFrameView.height = int(ceil(scales.entries[i]*frameView.height));
+        scaledFrameView.scale = scales.entries[i]*frameView.scale;
+        PixelBounds bounds = frameViewBounds(scaledFrameView);
+        bounds.b = bounds.a+Vector2i(scaledFrameView.width, scaledFrameView.height);
+        Bitmap &bitmap = bitmaps[i] = Bitmap(PixelFormat::PREMULTIPLIED_RGBA, bounds.dimensions());
+        if (requiresTiling(bounds)) {
+            if (!renderTiled(renderer, imageBase, renderedComponent, renderTree.value(), scaledFrameView.scale, bounds, 0, renderTileSize(), [&](const PlacedImagePtr &tile) {
+                PixelBounds tileBounds = outerPixelBounds(tile.bounds());
+                return renderer.download(bitmap.subBitmap(Rectangle<int>(tileBounds.a-bounds.a, tileBounds.b-bounds.a)), tile);
+            }))
+                return ODE_RESULT_UNKNOWN_ERROR;
+        } else {
+            PlacedImagePtr image = render(renderer, imageBase, renderedComponent, renderTree.value(), scaledFrameView.scale, bounds, 0);
+            if (!image)
+                return ODE_RESULT_UNKNOWN_ERROR;
+            TexturePtr tex = image->asTexture();
+            if (!(tex && image.bounds() == ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b) && tex->dimensions() == bounds.dimensions()))
+                image = renderer.reframe(image, bounds);
+            if (!renderer.download(bitmap, image))
+                return ODE_RESULT_UNKNOWN_ERROR;
+        }
+    }
+    if (!bitmaps.empty()) {
+        outputBitmaps->entries = reinterpret_cast<ODE_Bitmap *>(malloc(sizeof(ODE_Bitmap)*bitmaps.size()));
+        if (!outputBitmaps->entries)
+            return ODE_RESULT_MEMORY_ALLOCATION_ERROR;
+        for (Bitmap &bitmap : bitmaps)
+            exportBitmap(bitmap, &outputBitmaps->entries[outputBitmaps->n++]);
+    }
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_drawComponentAsync(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_PendingBitmapHandle *pendingBitmap, ODE_PR1_FrameView frameView, int format) {
+    ODE_ASSERT(rendererContext.ptr && component.ptr && designImageBase.ptr && pendingBitmap);
+    if (!(format == ODE_PIXEL_FORMAT_RGBA || format == ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA))
+        return ODE_RESULT_INVALID_PIXEL_FORMAT;
+    PlacedImagePtr image;
+    if (ODE_Result result = renderComponent(rendererContext, component, designImageBase, frameView, image))
+        return result;
+    TextureReadback readback;
+    std::vector<TextureReadback> &idleReadbacks = rendererContext.ptr->idleReadbacks;
+    if (!idleReadbacks.empty()) {
+        readback = (TextureReadback &&) idleReadbacks.back();
+        idleReadbacks.pop_back();
+    }
+    if (!rendererContext.ptr->renderer->readback(readback, image, PixelFormat(format)))
+        return ODE_RESULT_UNKNOWN_ERROR;
+    pendingBitmap->ptr = new ODE_internal_PendingBitmap(rendererContext.ptr, (TextureReadback &&) readback);
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pendingBitmap_wait(ODE_PendingBitmapHandle pendingBitmap, ODE_Bitmap *outputBitmap) {
+    ODE_ASSERT(pendingBitmap.ptr && outputBitmap);
+    Bitmap bitmap = pendingBitmap.ptr->readback.finish();
+    if (!bitmap)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    exportBitmap(bitmap, outputBitmap);
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_destroyPendingBitmap(ODE_PendingBitmapHandle pendingBitmap) {
+    if (pendingBitmap.ptr) {
+        // The readback's buffer is recycled for subsequent transfers
+        std::vector<TextureReadback> &idleReadbacks = pendingBitmap.ptr->rendererContext->idleReadbacks;
+        if (idleReadbacks.size() < IDLE_READBACK_POOL_SIZE)
+            idleReadbacks.push_back((TextureReadback &&) pendingBitmap.ptr->readback);
+        delete pendingBitmap.ptr;
+    }
+    return ODE_RESULT_OK;
+}
+
 ODE_Result ODE_API ode_pr1_createAnimationRenderer(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_PR1_AnimationRendererHandle *animationRenderer, ODE_DesignImageBaseHandle imageBase) {
     ODE_ASSERT(animationRenderer);
     if (!rendererContext.ptr)
@@ -182,8 +453,342 @@ ODE_Result ODE_API ode_pr1_animation_drawFrame(ODE_PR1_AnimationRendererHandle r
     return ODE_RESULT_OK;
 }
 
+ODE_Result ODE_API ode_pr1_createRetainedRenderer(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_PR1_RetainedRendererHandle *retainedRenderer, ODE_DesignImageBaseHandle imageBase) {
+    ODE_ASSERT(retainedRenderer);
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    if (!component.ptr)
+        return ODE_RESULT_INVALID_COMPONENT;
+    if (!imageBase.ptr)
+        return ODE_RESULT_INVALID_IMAGE_BASE;
+    retainedRenderer->ptr = new ODE_internal_RetainedRenderer;
+    retainedRenderer->ptr->renderer = rendererContext.ptr->renderer.get();
+    retainedRenderer->ptr->imageBase = &imageBase.ptr->imageBase;
+    retainedRenderer->ptr->component = component.ptr->accessor;
+    retainedRenderer->ptr->renderRevision = -1;
+    retainedRenderer->ptr->outputScale = 0;
+    retainedRenderer->ptr->outputDamageSerial = 0;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_destroyRetainedRenderer(ODE_PR1_RetainedRendererHandle retainedRenderer) {
+    delete retainedRenderer.ptr;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_retainedRenderer_draw(ODE_PR1_RetainedRendererHandle retainedRenderer, ODE_SparseBitmapRef outputBitmap, ODE_PR1_FrameView frameView, ODE_Rectangle *damage) {
+    ODE_ASSERT(retainedRenderer.ptr && retainedRenderer.ptr->renderer && retainedRenderer.ptr->imageBase && damage);
+    ODE_internal_RetainedRenderer &rr = *retainedRenderer.ptr;
+    const ptrdiff_t stride = outputBitmap.stride ? ptrdiff_t(outputBitmap.stride) : ptrdiff_t(pixelSize(PixelFormat::RGBA))*outputBitmap.width;
+    if (!(outputBitmap.format == ODE_PIXEL_FORMAT_RGBA || outputBitmap.format == ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA))
+        return ODE_RESULT_INVALID_PIXEL_FORMAT;
+    if (!(outputBitmap.width == frameView.width && outputBitmap.height == frameView.height))
+        return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    if (!outputBitmap.pixels)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    SparseBitmapRef bitmap(PixelFormat(outputBitmap.format), reinterpret_cast<void *>(outputBitmap.pixels), outputBitmap.width, outputBitmap.height, stride);
+    if (!rr.renderExpression || rr.renderRevision != rr.component.revision()) {
+        if (Result<Rendexptr, DesignError> renderExpr = rr.component.assemble())
+            rr.renderExpression = renderExpr.value();
+        else
+            return ode_result(renderExpr.error().type());
+        rr.renderRevision = rr.component.revision();
+    }
+    PixelBounds bounds = frameViewBounds(frameView);
+    bounds.b = bounds.a+Vector2i(frameView.width, frameView.height);
+    int damageSerial = rr.component.damageSerial();
+    PixelBounds damageBounds = bounds;
+    UnscaledBounds unscaledDamage;
+    if (rr.outputScale == frameView.scale && rr.outputBounds == bounds && rr.component.getDamage(rr.outputDamageSerial, unscaledDamage)) {
+        if (unscaledDamage)
+            damageBounds = outerPixelBounds(scaleBounds(unscaledDamage, frameView.scale))&bounds;
+        else
+            damageBounds = PixelBounds();
+    }
+    // Tiles rendered with culling to the damage bounds are written into the corresponding area of the bitmap
+    if (damageBounds) {
+        Renderer &renderer = *rr.renderer;
+        if (!renderTiled(renderer, *rr.imageBase, *rr.component.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), rr.renderExpression, frameView.scale, damageBounds, 0, renderTileSize(), [&](const PlacedImagePtr &tile) {
+            PixelBounds tileBounds = outerPixelBounds(tile.bounds());
+            return renderer.download(bitmap.subBitmap(Rectangle<int>(tileBounds.a-bounds.a, tileBounds.b-bounds.a)), tile);
+        })) {
+            // The bitmap may have been partially written
+            rr.outputScale = 0;
+            return ODE_RESULT_UNKNOWN_ERROR;
+        }
+    }
+    rr.outputBounds = bounds;
+    rr.outputScale = frameView.scale;
+    rr.outputDamageSerial = damageSerial;
+    if (damageBounds) {
+        damage->a.x = damageBounds.a.x-bounds.a.x;
+        damage->a.y = damageBounds.a.y-bounds.a.y;
+        damage->b.x = damageBounds.b.x-bounds.a.x;
+        damage->b.y = damageBounds.b.y-bounds.a.y;
+    } else
+        *damage = ODE_Rectangle();
+    return ODE_RESULT_OK;
+}
+
+static ODE_Result createRenderJob(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_PR1_RenderJobHandle *renderJob, const ODE_PR1_FrameView &frameView, int previewReduction) {
+    ODE_ASSERT(renderJob);
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    if (!component.ptr)
+        return ODE_RESULT_INVALID_COMPONENT;
+    if (!designImageBase.ptr)
+        return ODE_RESULT_INVALID_IMAGE_BASE;
+    PixelBounds bounds = frameViewBounds(frameView);
+    bounds.b = bounds.a+Vector2i(frameView.width, frameView.height);
+    if (requiresTiling(bounds))
+        return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    Result<Rendexptr, DesignError> renderTree = component.ptr->accessor.assemble();
+    if (!renderTree)
+        return ode_result(renderTree.error().type());
+    renderJob->ptr = new ODE_internal_RenderJob;
+    renderJob->ptr->renderer = rendererContext.ptr->renderer.get();
+    renderJob->ptr->component = component.ptr->accessor;
+    renderJob->ptr->renderRevision = component.ptr->accessor.revision();
+    renderJob->ptr->bounds = bounds;
+    renderJob->ptr->job.reset(new ProgressiveRenderJob(*rendererContext.ptr->renderer, designImageBase.ptr->imageBase, *component.ptr->accessor.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), renderTree.value(), frameView.scale, bounds, 0, previewReduction));
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_createRenderJob(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_PR1_RenderJobHandle *renderJob, ODE_PR1_FrameView frameView) {
+    return createRenderJob(rendererContext, component, designImageBase, renderJob, frameView, 1);
+}
+
+ODE_Result ODE_API ode_pr1_createProgressiveRenderJob(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_PR1_RenderJobHandle *renderJob, ODE_PR1_FrameView frameView, int previewReduction) {
+    if (previewReduction < 1)
+        return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    return createRenderJob(rendererContext, component, designImageBase, renderJob, frameView, previewReduction);
+}
+
+ODE_Result ODE_API ode_pr1_destroyRenderJob(ODE_PR1_RenderJobHandle renderJob) {
+    delete renderJob.ptr;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_renderJob_advance(ODE_PR1_RenderJobHandle renderJob, int maxOperations, ODE_Scalar maxSeconds, ODE_Scalar *progress) {
+    ODE_ASSERT(renderJob.ptr && renderJob.ptr->job);
+    ProgressiveRenderJob &job = *renderJob.ptr->job;
+    // The render expression refers to the component's layers, which may have been replaced by a modification
+    if (!job.finished() && renderJob.ptr->component.revision() != renderJob.ptr->renderRevision)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    job.advance(maxOperations, maxSeconds);
+    if (progress)
+        *progress = job.progress();
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_renderJob_getResult(ODE_PR1_RenderJobHandle renderJob, ODE_SparseBitmapRef outputBitmap) {
+    ODE_ASSERT(renderJob.ptr && renderJob.ptr->job);
+    const PixelBounds &bounds = renderJob.ptr->bounds;
+    const ptrdiff_t stride = outputBitmap.stride ? ptrdiff_t(outputBitmap.stride) : ptrdiff_t(pixelSize(PixelFormat::RGBA))*outputBitmap.width;
+    if (!(outputBitmap.format == ODE_PIXEL_FORMAT_RGBA || outputBitmap.format == ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA))
+        return ODE_RESULT_INVALID_PIXEL_FORMAT;
+    if (Vector2i(outputBitmap.width, outputBitmap.height) != bounds.dimensions())
+        return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    if (!outputBitmap.pixels)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    if (!renderJob.ptr->job->hasResult())
+        return ODE_RESULT_UNKNOWN_ERROR;
+    SparseBitmapRef bitmap(PixelFormat(outputBitmap.format), reinterpret_cast<void *>(outputBitmap.pixels), outputBitmap.width, outputBitmap.height, stride);
+    PlacedImagePtr image = renderJob.ptr->job->result();
+    if (!image)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    TexturePtr tex = image->asTexture();
+    if (!(tex && image.bounds() == ScaledBounds((Vector2d) bounds.a, (Vector2d) bounds.b) && tex->dimensions() == bounds.dimensions()))
+        image = renderJob.ptr->renderer->reframe(image, bounds);
+    if (!renderJob.ptr->renderer->download(bitmap, image))
+        return ODE_RESULT_UNKNOWN_ERROR;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_createRenderBatch(ODE_RendererContextHandle rendererContext, ODE_DesignHandle design, ODE_DesignImageBaseHandle designImageBase, ODE_PR1_RenderBatchHandle *renderBatch) {
+    ODE_ASSERT(renderBatch);
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    if (!design.ptr)
+        return ODE_RESULT_INVALID_DESIGN;
+    if (!designImageBase.ptr)
+        return ODE_RESULT_INVALID_IMAGE_BASE;
+    renderBatch->ptr = new ODE_internal_RenderBatch;
+    renderBatch->ptr->rendererContext = rendererContext.ptr;
+    renderBatch->ptr->imageBase = &designImageBase.ptr->imageBase;
+    renderBatch->ptr->design = &design.ptr->design;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_destroyRenderBatch(ODE_PR1_RenderBatchHandle renderBatch) {
+    delete renderBatch.ptr;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_renderBatch_addComponent(ODE_PR1_RenderBatchHandle renderBatch, ODE_StringRef componentId, ODE_PR1_FrameView frameView) {
+    ODE_ASSERT(renderBatch.ptr && componentId.data);
+    ODE_internal_RenderBatch::Entry entry;
+    if (!(entry.component = renderBatch.ptr->design->getComponent(ode_stringDeref(componentId))))
+        return ODE_RESULT_COMPONENT_NOT_FOUND;
+    entry.frameView = frameView;
+    renderBatch.ptr->entries.push_back((ODE_internal_RenderBatch::Entry &&) entry);
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_API ode_pr1_renderBatch_draw(ODE_PR1_RenderBatchHandle renderBatch, ODE_BitmapList *outputBitmaps, int format) {
+    ODE_ASSERT(renderBatch.ptr && outputBitmaps);
+    if (!(format == ODE_PIXEL_FORMAT_RGBA || format == ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA))
+        return ODE_RESULT_INVALID_PIXEL_FORMAT;
+    outputBitmaps->entries = nullptr;
+    outputBitmaps->n = 0;
+    std::vector<ODE_internal_RenderBatch::Entry> entries((std::vector<ODE_internal_RenderBatch::Entry> &&) renderBatch.ptr->entries);
+    renderBatch.ptr->entries.clear();
+    if (entries.empty())
+        return ODE_RESULT_OK;
+
+    // Renders of the same component are performed consecutively (in order of its first appearance) and by scale,
+    // so that its render graph is assembled once and its cached effects and subtrees, which are specific to the component and scale, are still present when reused
+    std::map<const Component *, int> componentOrder;
+    for (ODE_internal_RenderBatch::Entry &entry : entries)
+        componentOrder.insert(std::make_pair(entry.component.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), int(componentOrder.size())));
+    std::vector<int> order(entries.size());
+    for (int i = 0; i < int(order.size()); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        int componentA = componentOrder[entries[a].component.TEMP_GET_COMPONENT_DELETE_ME_ASAP()];
+        int componentB = componentOrder[entries[b].component.TEMP_GET_COMPONENT_DELETE_ME_ASAP()];
+        if (componentA != componentB)
+            return componentA < componentB;
+        return entries[a].frameView.scale < entries[b].frameView.scale;
+    });
+
+    Renderer &renderer = *renderBatch.ptr->rendererContext->renderer;
+    std::vector<TextureReadback> &idleReadbacks = renderBatch.ptr->rendererContext->idleReadbacks;
+    std::vector<Bitmap> bitmaps(entries.size());
+    // The transfer of the previous render's pixels proceeds while the next one is being rendered
+    TextureReadback pendingReadback;
+    int pendingIndex = -1;
+    auto finishPending = [&]() -> bool {
+        if (pendingIndex >= 0) {
+            if (!(bitmaps[pendingIndex] = pendingReadback.finish()))
+                return false;
+            if (idleReadbacks.size() < IDLE_READBACK_POOL_SIZE)
+                idleReadbacks.push_back((TextureReadback &&) pendingReadback);
+            pendingIndex = -1;
+        }
+        return true;
+    };
+    Rendexptr renderTree;
+    const Component *renderTreeComponent = nullptr;
+    for (int index : order) {
+        Design::ComponentAccessor &accessor = entries[index].component;
+        Component &component = *accessor.TEMP_GET_COMPONENT_DELETE_ME_ASAP();
+        if (&component != renderTreeComponent) {
+            Result<Rendexptr, DesignError> componentRenderTree = accessor.assemble();
+            if (!componentRenderTree)
+                return ode_result(componentRenderTree.error().type());
+            renderTree = componentRenderTree.value();
+            renderTreeComponent = &component;
+        }
+        const ODE_PR1_FrameView &frameView = entries[index].frameView;
+        PlacedImagePtr image = render(renderer, *renderBatch.ptr->imageBase, component, renderTree, frameView.scale, frameViewBounds(frameView), 0);
+        if (!image)
+            return ODE_RESULT_UNKNOWN_ERROR;
+        TextureReadback readback;
+        if (!idleReadbacks.empty()) {
+            readback = (TextureReadback &&) idleReadbacks.back();
+            idleReadbacks.pop_back();
+        }
+        if (!(renderer.readback(readback, image, PixelFormat(format)) && finishPending()))
+            return ODE_RESULT_UNKNOWN_ERROR;
+        pendingReadback = (TextureReadback &&) readback;
+        pendingIndex = index;
+    }
+    if (!finishPending())
+        return ODE_RESULT_UNKNOWN_ERROR;
+
+    outputBitmaps->entries = reinterpret_cast<ODE_Bitmap *>(malloc(sizeof(ODE_Bitmap)*bitmaps.size()));
+    if (!outputBitmaps->entries)
+        return ODE_RESULT_MEMORY_ALLOCATION_ERROR;
+    for (Bitmap &bitmap : bitmaps)
+        exportBitmap(bitmap, &outputBitmaps->entries[outputBitmaps->n++]);
+    return ODE_RESULT_OK;
+}
+
 #ifndef __EMSCRIPTEN__
 
+ODE_Result ODE_NATIVE_API ode_pr1_saveComponentPng(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_StringRef path, ODE_PR1_FrameView frameView) {
+    ODE_ASSERT(rendererContext.ptr && component.ptr && designImageBase.ptr);
+    PixelBounds bounds = frameViewBounds(frameView);
+    bounds.b = bounds.a+Vector2i(frameView.width, frameView.height);
+    if (!bounds)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    PngWriter pngWriter;
+    if (!pngWriter.open(FilePath(ode_stringDeref(path)), PixelFormat::RGBA, bounds.dimensions()))
+        return ODE_RESULT_FILE_WRITE_ERROR;
+    // Tiles of a row are collected in the band until its rows can be passed to the PNG writer
+    int tileSize = renderTileSize();
+    Bitmap band(PixelFormat::RGBA, bounds.dimensions().x, std::min(tileSize, bounds.dimensions().y));
+    Renderer &renderer = *rendererContext.ptr->renderer;
+    bool writeError = false;
+    if (ODE_Result result = renderComponentTiled(rendererContext, component, designImageBase, frameView.scale, bounds, tileSize, [&](const PlacedImagePtr &tile) {
+        PixelBounds tileBounds = outerPixelBounds(tile.bounds());
+        if (!renderer.download(SparseBitmapRef(band).subBitmap(Rectangle<int>(tileBounds.a.x-bounds.a.x, 0, tileBounds.b.x-bounds.a.x, tileBounds.dimensions().y)), tile))
+            return false;
+        if (tileBounds.b.x == bounds.b.x && !pngWriter.writeRows(SparseBitmapConstRef(band).subBitmap(Rectangle<int>(0, 0, band.width(), tileBounds.dimensions().y)))) {
+            writeError = true;
+            return false;
+        }
+        return true;
+    }))
+        return writeError ? ODE_RESULT_FILE_WRITE_ERROR : result;
+    if (!pngWriter.close())
+        return ODE_RESULT_FILE_WRITE_ERROR;
+    return ODE_RESULT_OK;
+}
+
+static std::unique_ptr<ProgramBinaryCache> programBinaryCache;
+
+ODE_Result ODE_NATIVE_API ode_setShaderCacheDirectory(ODE_StringRef directory) {
+    ShaderProgram::setBinaryCache(nullptr);
+    programBinaryCache.reset();
+    if (directory.data && directory.length > 0) {
+        programBinaryCache.reset(new ProgramBinaryCache(FilePath(ode_stringDeref(directory))));
+        ShaderProgram::setBinaryCache(programBinaryCache.get());
+    }
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_NATIVE_API ode_pr1_createTilePyramid(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_PR1_TilePyramidHandle *tilePyramid, ODE_StringRef cacheDirectory, int tileSize) {
+    ODE_ASSERT(tilePyramid && cacheDirectory.data);
+    if (!rendererContext.ptr)
+        return ODE_RESULT_INVALID_RENDERER_CONTEXT;
+    if (!component.ptr)
+        return ODE_RESULT_INVALID_COMPONENT;
+    if (!designImageBase.ptr)
+        return ODE_RESULT_INVALID_IMAGE_BASE;
+    if (tileSize <= 0)
+        return ODE_RESULT_INVALID_BITMAP_DIMENSIONS;
+    tilePyramid->ptr = new ODE_internal_TilePyramid;
+    tilePyramid->ptr->component = component.ptr->accessor;
+    tilePyramid->ptr->pyramid.reset(new TilePyramid(*rendererContext.ptr->renderer, designImageBase.ptr->imageBase, *tilePyramid->ptr->component.TEMP_GET_COMPONENT_DELETE_ME_ASAP(), FilePath(ode_stringDeref(cacheDirectory)), tileSize));
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_NATIVE_API ode_pr1_destroyTilePyramid(ODE_PR1_TilePyramidHandle tilePyramid) {
+    delete tilePyramid.ptr;
+    return ODE_RESULT_OK;
+}
+
+ODE_Result ODE_NATIVE_API ode_pr1_tilePyramid_getTile(ODE_PR1_TilePyramidHandle tilePyramid, int level, int column, int row, ODE_Bitmap *outputBitmap) {
+    ODE_ASSERT(tilePyramid.ptr && outputBitmap);
+    Bitmap tile = tilePyramid.ptr->pyramid->getTile(level, column, row);
+    if (!tile)
+        return ODE_RESULT_UNKNOWN_ERROR;
+    exportBitmap(tile, outputBitmap);
+    return ODE_RESULT_OK;
+}
+
 ODE_Result ODE_NATIVE_API ode_loadDesignFromFileWithImages(ODE_EngineHandle engine, ODE_OUT_RETURN ODE_DesignHandle *design, ODE_StringRef path, ODE_DesignImageBaseHandle designImageBase, ODE_OUT ODE_ParseError *parseError) {
     return loadDesignFromOctopusFile(design, ode_stringDeref(path), [&designImageBase](ODE_StringRef filePath, ODE_MemoryBuffer &imageData) {
         ODE_ASSERT(filePath.data && imageData.data);
@@ -18,6 +18,16 @@ extern ODE_API const int ODE_PIXEL_FORMAT_RGBA;
 /// Pixel format of 4 channels - red, green, blue, alpha, color channels are alpha-premultiplied, each channel represented by 8-bit unsigned integer (0 to 255 range)
 extern ODE_API const int ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA;
 
+/// Quality level of rendered effects
+typedef enum {
+    /// Full precision - intended for export
+    ODE_RENDER_QUALITY_FINAL = 0,
+    /// Fewer samples of blurs and shadows, which are computed at reduced resolution, and sub-pixel effects are skipped - for interactive editing
+    ODE_RENDER_QUALITY_DRAFT = 1,
+    /// Even lower precision and resolution of effects - for fast previews during navigation
+    ODE_RENDER_QUALITY_PREVIEW = 2,
+} ODE_RenderQuality;
+
 // Data structures
 
 /// Representation of a bitmap with its own storage. Deallocate with ode_destroyBitmap
@@ -30,6 +40,16 @@ typedef struct {
     int width, height;
 } ODE_Bitmap;
 
+/// List of bitmaps with their own storage - should be destroyed by ode_destroyBitmapList
+typedef struct {
+    /// The list's bitmaps
+    ODE_Bitmap *entries;
+    /// The number of list entries
+    int n;
+    /// Get single entry
+    ODE_BIND_ARRAY_GETTER(getEntry, entries, n);
+} ODE_BitmapList;
+
 /// Reference to an immutable bitmap - does not hold or change ownership
 typedef struct {
     /// The pixel format (see ODE_PIXEL_FORMAT_... constants)
@@ -40,6 +60,18 @@ typedef struct {
     int width, height;
 } ODE_BitmapRef;
 
+/// Reference to a mutable bitmap whose rows may be padded - does not hold or change ownership
+typedef struct {
+    /// The pixel format (see ODE_PIXEL_FORMAT_... constants)
+    int format;
+    /// Pointer to the first (top-left) pixel. Pixels are stored in row-major order
+    ODE_VarDataPtr pixels;
+    /// Dimensions of bitmap
+    int width, height;
+    /// The difference between the beginnings of consecutive rows in bytes, zero if rows are stored contiguously
+    int stride;
+} ODE_SparseBitmapRef;
+
 /// PROTOTYPE - specification of frame view
 typedef struct {
     /// Viewport dimensions
@@ -55,12 +87,25 @@ typedef struct {
 ODE_HANDLE_DECL(ODE_internal_RendererContext) ODE_RendererContextHandle;
 /// Represents a design's image base. Image base manages storage of image assets of the design
 ODE_HANDLE_DECL(ODE_internal_DesignImageBase) ODE_DesignImageBaseHandle;
+/// Represents a bitmap which is being transferred from the GPU. Its pixels become available via ode_pendingBitmap_wait
+ODE_HANDLE_DECL(ODE_internal_PendingBitmap) ODE_PendingBitmapHandle;
 /// PROTOTYPE - Represents an animation renderer. A renderer facilitates rendering of components or designs in a way specific to the renderer class
 ODE_HANDLE_DECL(ODE_internal_AnimationRenderer) ODE_PR1_AnimationRendererHandle;
+/// PROTOTYPE - Represents a renderer which updates its previous output of a component only in the area affected by subsequent modifications of the component
+ODE_HANDLE_DECL(ODE_internal_RetainedRenderer) ODE_PR1_RetainedRendererHandle;
+/// PROTOTYPE - Represents a render of a component which is performed in portions by multiple calls and may be abandoned at any point
+ODE_HANDLE_DECL(ODE_internal_RenderJob) ODE_PR1_RenderJobHandle;
+/// PROTOTYPE - Represents a list of component renders, which are performed together so that they share the renderer context's caches
+ODE_HANDLE_DECL(ODE_internal_RenderBatch) ODE_PR1_RenderBatchHandle;
+/// PROTOTYPE - Represents a renderer of fixed-size tiles of a component at power-of-two scales, which caches the tiles on disk
+ODE_HANDLE_DECL(ODE_internal_TilePyramid) ODE_PR1_TilePyramidHandle;
 
 /// Deallocates the data held by an ODE_Bitmap
 ODE_Result ODE_API ode_destroyBitmap(ODE_Bitmap bitmap);
 
+/// Deallocates an ODE_BitmapList object including the data of all of its bitmaps
+ODE_Result ODE_API ode_destroyBitmapList(ODE_BitmapList bitmapList);
+
 /**
  * Creates a new renderer context - destroy with ode_destroyRendererContext
  * @param engine - existing engine handle
@@ -70,6 +115,13 @@ ODE_Result ODE_API ode_destroyBitmap(ODE_Bitmap bitmap);
 ODE_Result ODE_API ode_createRendererContext(ODE_EngineHandle engine, ODE_OUT_RETURN ODE_RendererContextHandle *rendererContext, ODE_StringRef target);
 /// Destroys the renderer context
 ODE_Result ODE_API ode_destroyRendererContext(ODE_RendererContextHandle rendererContext);
+/// Sets the quality of effects in subsequent renders of the renderer context (ODE_RENDER_QUALITY_FINAL by default)
+ODE_Result ODE_API ode_rendererContext_setQuality(ODE_RendererContextHandle rendererContext, ODE_RenderQuality quality);
+/// Sets the size in pixels below which layers are drawn as approximations of their average color, and their effects omitted unless they extend beyond it, in subsequent renders
+/// (intended for small thumbnails) - zero (default) disables the approximation
+ODE_Result ODE_API ode_rendererContext_setDetailThreshold(ODE_RendererContextHandle rendererContext, ODE_Scalar threshold);
+/// Compiles all shader programs of the renderer context in advance, which would otherwise be compiled when first needed during rendering
+ODE_Result ODE_API ode_rendererContext_warmUp(ODE_RendererContextHandle rendererContext);
 
 /**
  * Creates a new empty image base for a design - deallocate with ode_destroyDesignImageBase
@@ -100,6 +152,52 @@ ODE_Result ODE_API ode_design_loadImagePixels(ODE_DesignImageBaseHandle designIm
  */
 ODE_Result ODE_API ode_pr1_drawComponent(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_Bitmap *outputBitmap, ODE_PR1_FrameView frameView);
 
+/**
+ * PROTOTYPE - draws a component into existing memory provided by the caller, which can be reused across renders
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param outputBitmap - the bitmap to be written into - its format (ODE_PIXEL_FORMAT_RGBA or ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA) determines
+ *                       whether the pixels are unpremultiplied (on the GPU), its dimensions must equal those of the frame view.
+ *                       Frame views larger than the maximum texture size are rendered in tiles
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render
+ */
+ODE_Result ODE_API ode_pr1_drawComponentIntoBitmap(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_SparseBitmapRef outputBitmap, ODE_PR1_FrameView frameView);
+
+/**
+ * PROTOTYPE - draws a component at multiple scales into new bitmaps in physical memory, e.g. for export at 1x, 2x and 3x.
+ * The render graph is assembled only once and the component's parsed shapes, shaped text and decoded image assets are shared by all of the renders
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param outputBitmaps - output argument for the newly created list of bitmaps (premultiplied), one for each scale in the same order - deallocate with ode_destroyBitmapList
+ * @param frameView - frame view at scale factor 1 - each bitmap covers the same area of the component with its dimensions multiplied by the scale factor (rounded up)
+ * @param scales - list of scale factors, by which the scale of the frame view is multiplied
+ */
+ODE_Result ODE_API ode_pr1_drawComponentScales(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_BitmapList *outputBitmaps, ODE_PR1_FrameView frameView, ODE_ScalarList scales);
+
+/**
+ * PROTOTYPE - draws a component and initiates the transfer of its pixels to physical memory without waiting for it to complete,
+ * so that the caller may proceed with other work (e.g. rendering the next component) in the meantime
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param pendingBitmap - output argument for the pending bitmap handle - destroy with ode_destroyPendingBitmap before destroying the renderer context
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render
+ * @param format - pixel format of the resulting bitmap, ODE_PIXEL_FORMAT_RGBA or ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA - the conversion is performed on the GPU
+ */
+ODE_Result ODE_API ode_pr1_drawComponentAsync(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_PendingBitmapHandle *pendingBitmap, ODE_PR1_FrameView frameView, int format);
+
+/**
+ * Waits until the pending bitmap's pixels have been transferred and outputs them as a new bitmap. Can only be called once per pending bitmap
+ * @param pendingBitmap - the pending bitmap
+ * @param outputBitmap - output argument for the newly created bitmap - deallocate with ode_destroyBitmap
+ */
+ODE_Result ODE_API ode_pendingBitmap_wait(ODE_PendingBitmapHandle pendingBitmap, ODE_OUT_RETURN ODE_Bitmap *outputBitmap);
+
+/// Destroys the pending bitmap, abandoning the transfer if not yet retrieved - the bitmaps output by ode_pendingBitmap_wait remain valid
+ODE_Result ODE_API ode_destroyPendingBitmap(ODE_PendingBitmapHandle pendingBitmap);
+
 /**
  * PROTOTYPE - creates a new animation renderer for a given component - destroy with ode_pr1_destroyAnimationRenderer
  * @param rendererContext - handle to parent rendererContext
@@ -120,6 +218,104 @@ ODE_Result ODE_API ode_pr1_destroyAnimationRenderer(ODE_PR1_AnimationRendererHan
  */
 ODE_Result ODE_API ode_pr1_animation_drawFrame(ODE_PR1_AnimationRendererHandle renderer, ODE_PR1_FrameView frameView, ODE_Scalar time);
 
+/**
+ * PROTOTYPE - creates a new retained renderer for a given component - destroy with ode_pr1_destroyRetainedRenderer
+ * @param rendererContext - handle to parent rendererContext
+ * @param component - component to be rendered by the renderer
+ * @param retainedRenderer - output argument for the new retained renderer handle
+ * @param imageBase - image base of the component's parent design to be used to provide image assets
+ */
+ODE_Result ODE_API ode_pr1_createRetainedRenderer(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_OUT_RETURN ODE_PR1_RetainedRendererHandle *retainedRenderer, ODE_DesignImageBaseHandle imageBase);
+
+/// Destroys the retained renderer
+ODE_Result ODE_API ode_pr1_destroyRetainedRenderer(ODE_PR1_RetainedRendererHandle retainedRenderer);
+
+/**
+ * PROTOTYPE - draws the component into existing memory, which is expected to hold the output of the previous call with the same frame view.
+ * Only the area affected by modifications of the component since then (including effect margins) is re-rendered and written,
+ * the first call and calls with a different frame view write the whole bitmap
+ * @param retainedRenderer - the retained renderer to be used for this operation
+ * @param outputBitmap - the bitmap to be updated - its format must be ODE_PIXEL_FORMAT_RGBA or ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA
+ *                       and its dimensions must equal those of the frame view
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render
+ * @param damage - output argument for the rectangle of outputBitmap's pixels which have been written (empty if none)
+ */
+ODE_Result ODE_API ode_pr1_retainedRenderer_draw(ODE_PR1_RetainedRendererHandle retainedRenderer, ODE_SparseBitmapRef outputBitmap, ODE_PR1_FrameView frameView, ODE_OUT ODE_Rectangle *damage);
+
+/**
+ * PROTOTYPE - creates a new render job, which draws a component incrementally - destroy with ode_pr1_destroyRenderJob.
+ * The component must not be modified until the job is finished
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param renderJob - output argument for the new render job handle
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render - it must not exceed the maximum texture size
+ */
+ODE_Result ODE_API ode_pr1_createRenderJob(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_PR1_RenderJobHandle *renderJob, ODE_PR1_FrameView frameView);
+
+/**
+ * PROTOTYPE - creates a new render job, which first draws a preview of the component at a reduced scale (and draft effect quality)
+ * and then the final result - destroy with ode_pr1_destroyRenderJob. The component must not be modified until the job is finished
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param renderJob - output argument for the new render job handle
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render - it must not exceed the maximum texture size
+ * @param previewReduction - the factor by which the scale of the preview is reduced (e.g. 4 or 8), 1 to skip the preview
+ */
+ODE_Result ODE_API ode_pr1_createProgressiveRenderJob(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_PR1_RenderJobHandle *renderJob, ODE_PR1_FrameView frameView, int previewReduction);
+
+/// Destroys the render job - an unfinished render is cancelled and its intermediate framebuffers are released to the renderer context
+ODE_Result ODE_API ode_pr1_destroyRenderJob(ODE_PR1_RenderJobHandle renderJob);
+
+/**
+ * PROTOTYPE - continues the render until it is finished or the budget is exhausted
+ * @param renderJob - the render job
+ * @param maxOperations - maximum number of render operations to be performed by this call, zero if unlimited
+ * @param maxSeconds - time limit of this call in seconds (only the time spent issuing the work to the GPU is measured), zero if unlimited
+ * @param progress - output argument for the estimated fraction of the work done, 1 if the render is finished
+ */
+ODE_Result ODE_API ode_pr1_renderJob_advance(ODE_PR1_RenderJobHandle renderJob, int maxOperations, ODE_Scalar maxSeconds, ODE_OUT ODE_Scalar *progress);
+
+/**
+ * PROTOTYPE - writes the result of a render job into existing memory provided by the caller. Until the job is finished (progress 1),
+ * the result is its preview scaled up to the frame view, which becomes available when ode_pr1_renderJob_advance first returns after the preview pass
+ * @param renderJob - the render job, which must be finished or have a preview
+ * @param outputBitmap - the bitmap to be written into - its format must be ODE_PIXEL_FORMAT_RGBA or ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA
+ *                       and its dimensions must equal those of the job's frame view
+ */
+ODE_Result ODE_API ode_pr1_renderJob_getResult(ODE_PR1_RenderJobHandle renderJob, ODE_SparseBitmapRef outputBitmap);
+
+/**
+ * PROTOTYPE - creates a new empty render batch for components of a design, e.g. to export all of its artboards - destroy with ode_pr1_destroyRenderBatch
+ * @param rendererContext - target renderer context
+ * @param design - the design which contains the components
+ * @param designImageBase - image base of the design to be used to provide image assets
+ * @param renderBatch - output argument for the new render batch handle
+ */
+ODE_Result ODE_API ode_pr1_createRenderBatch(ODE_RendererContextHandle rendererContext, ODE_DesignHandle design, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_PR1_RenderBatchHandle *renderBatch);
+
+/// Destroys the render batch
+ODE_Result ODE_API ode_pr1_destroyRenderBatch(ODE_PR1_RenderBatchHandle renderBatch);
+
+/**
+ * PROTOTYPE - appends a render of a component to the batch - the same component may be added multiple times with different frame views
+ * @param renderBatch - the render batch
+ * @param componentId - ID of the component to be rendered
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render
+ */
+ODE_Result ODE_API ode_pr1_renderBatch_addComponent(ODE_PR1_RenderBatchHandle renderBatch, ODE_StringRef componentId, ODE_PR1_FrameView frameView);
+
+/**
+ * PROTOTYPE - draws all renders added to the batch into new bitmaps in physical memory and empties the batch.
+ * The renders are reordered so that those of the same component follow each other and reuse its render graph and cached intermediate results,
+ * and the transfer of each bitmap to physical memory overlaps with the next render. The components must not be modified between being added and drawn
+ * @param renderBatch - the render batch
+ * @param outputBitmaps - output argument for the newly created list of bitmaps, one for each added render in the order of addition - deallocate with ode_destroyBitmapList
+ * @param format - pixel format of the resulting bitmaps, ODE_PIXEL_FORMAT_RGBA or ODE_PIXEL_FORMAT_PREMULTIPLIED_RGBA - the conversion is performed on the GPU
+ */
+ODE_Result ODE_API ode_pr1_renderBatch_draw(ODE_PR1_RenderBatchHandle renderBatch, ODE_OUT_RETURN ODE_BitmapList *outputBitmaps, int format);
+
 #ifndef __EMSCRIPTEN__
 
 /**
@@ -140,6 +336,51 @@ ODE_Result ODE_NATIVE_API ode_loadDesignFromFileWithImages(ODE_EngineHandle engi
  */
 ODE_Result ODE_NATIVE_API ode_saveDesignToFileWithImages(ODE_DesignHandle design, ODE_StringRef path, ODE_DesignImageBaseHandle designImageBase);
 
+/**
+ * PROTOTYPE - renders a component and saves it as a PNG file. The image is rendered and encoded progressively in tiles,
+ * so it may exceed the maximum texture size and only a band of rows is held in memory at a time
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param path - path to the output PNG file
+ * @param frameView - pointer to frame view object, which specifies the parameters of the render
+ */
+ODE_Result ODE_NATIVE_API ode_pr1_saveComponentPng(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_StringRef path, ODE_PR1_FrameView frameView);
+
+/**
+ * Sets the directory where linked shader programs are stored, so that subsequent runs on the same driver do not have to recompile them.
+ * Should be called before creating renderer contexts, programs compiled before the call are not cached
+ * @param directory - path to an existing directory, empty string disables the cache
+ */
+ODE_Result ODE_NATIVE_API ode_setShaderCacheDirectory(ODE_StringRef directory);
+
+/**
+ * PROTOTYPE - creates a tile pyramid renderer for deep zoom viewing of a component - destroy with ode_pr1_destroyTilePyramid.
+ * Tiles are stored as PNG files in the cache directory under a hash of the component's content and render settings,
+ * so they are reused (also by subsequent runs) until the component is modified. Changes of image asset pixels under the same key are not detected
+ * @param rendererContext - target renderer context
+ * @param component - component to be rendered
+ * @param designImageBase - image base of the component's parent design to be used to provide image assets
+ * @param tilePyramid - output argument for the new tile pyramid handle
+ * @param cacheDirectory - path to an existing directory where the tiles are stored
+ * @param tileSize - width and height of each tile in pixels
+ */
+ODE_Result ODE_NATIVE_API ode_pr1_createTilePyramid(ODE_RendererContextHandle rendererContext, ODE_ComponentHandle component, ODE_DesignImageBaseHandle designImageBase, ODE_OUT_RETURN ODE_PR1_TilePyramidHandle *tilePyramid, ODE_StringRef cacheDirectory, int tileSize);
+
+/// Destroys the tile pyramid renderer - the cached tiles remain on disk
+ODE_Result ODE_NATIVE_API ode_pr1_destroyTilePyramid(ODE_PR1_TilePyramidHandle tilePyramid);
+
+/**
+ * PROTOTYPE - retrieves a tile from the cache or renders it. A tile which is not cached yet is downsampled from the four tiles of level+1
+ * covering its area if they are all cached, so a pyramid is generated fastest from the most detailed level down
+ * @param tilePyramid - the tile pyramid renderer
+ * @param level - zoom level - the component is rendered at scale 2^level
+ * @param column - horizontal index of the tile - its left edge is at column*tileSize pixels from the component's origin at that scale
+ * @param row - vertical index of the tile - its top edge is at row*tileSize pixels from the component's origin at that scale
+ * @param outputBitmap - output argument for the newly created RGBA bitmap of the tile - deallocate with ode_destroyBitmap
+ */
+ODE_Result ODE_NATIVE_API ode_pr1_tilePyramid_getTile(ODE_PR1_TilePyramidHandle tilePyramid, int level, int column, int row, ODE_OUT_RETURN ODE_Bitmap *outputBitmap);
+
 #endif
 
 #ifdef __cplusplus
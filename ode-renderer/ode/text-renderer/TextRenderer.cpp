@@ -76,13 +76,15 @@ PlacedImagePtr TextRenderer::drawLayerText(Component &component, const LayerInst
         );
         ScaledBounds bounds = scaleBounds(transformBounds(UntransformedBounds(0, 0, dimensions.width, dimensions.height), unscaledTransform), scale)&visibleBounds;
         PixelBounds pxBounds = outerPixelBounds(bounds);
+        if (!pxBounds)
+            return nullptr;
         PixelBounds marginBounds = pxBounds+PixelMargin(1);
         TransformationMatrix transformation = TransformationMatrix::scale(scale)*unscaledTransform;
 
         TextureFrameBufferPtr outTex = tfbManager.acquire(marginBounds);
         outTex->bind();
-        glViewport(1, 1, pxBounds.dimensions().x, pxBounds.dimensions().y);
-        glClearColor(0, 0, 0, 0);
+        GLStateCache::viewport(1, 1, pxBounds.dimensions().x, pxBounds.dimensions().y);
+        GLStateCache::clearColor(0, 0, 0, 0);
         glClear(GL_COLOR_BUFFER_BIT);
         glEnable(GL_BLEND);
         glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
@@ -100,6 +102,33 @@ PlacedImagePtr TextRenderer::drawLayerText(Component &component, const LayerInst
 
 #else
 
+// Crops the bitmap to its non-transparent pixels (keeping a transparent margin of 1 pixel) and adjusts its placement bounds - returns false if it is fully transparent
+static bool cropTransparentArea(BitmapPtr &bitmap, ScaledBounds &bounds) {
+    ODE_ASSERT(bitmap && bitmap->format() == PixelFormat::PREMULTIPLIED_RGBA);
+    Rectangle<int> fullArea(0, 0, bitmap->width(), bitmap->height());
+    Rectangle<int> area(fullArea.b, fullArea.a);
+    for (int y = 0; y < bitmap->height(); ++y) {
+        const byte *row = reinterpret_cast<const byte *>((*bitmap)(0, y));
+        for (int x = 0; x < bitmap->width(); ++x) {
+            if (row[4*x+3]) {
+                area.a.x = std::min(area.a.x, x);
+                area.a.y = std::min(area.a.y, y);
+                area.b.x = std::max(area.b.x, x+1);
+                area.b.y = std::max(area.b.y, y+1);
+            }
+        }
+    }
+    if (!area)
+        return false;
+    area = (area+RectangleMargin<int>(1))&fullArea;
+    if (area == fullArea)
+        return true;
+    Vector2d pixelSize(bounds.dimensions().x/bitmap->width(), bounds.dimensions().y/bitmap->height());
+    bounds = ScaledBounds(bounds.a+pixelSize*Vector2d(area.a), bounds.a+pixelSize*Vector2d(area.b));
+    bitmap = BitmapPtr(new Bitmap(bitmap->subBitmap(area)));
+    return true;
+}
+
 PlacedImagePtr TextRenderer::drawLayerText(Component &component, const LayerInstanceSpecifier &layer, const ScaledBounds &visibleBounds, double scale, double time) {
     if (Result<TextShapeHolder *, DesignError> shape = component.getLayerTextShape(layer->id)) {
         if (!(shape.value() && *shape.value()))
@@ -126,6 +155,9 @@ PlacedImagePtr TextRenderer::drawLayerText(Component &component, const LayerInst
         padding.a.x = padding.b.x = bounds.dimensions().x/dimensions.width;
         padding.a.y = padding.b.y = bounds.dimensions().y/dimensions.height;
         bounds += padding;
+        // Text buffers are sized by the layout box, which is often much larger than the glyphs
+        if (!cropTransparentArea(bitmap, bounds))
+            return nullptr;
         PlacedImagePtr image(ImagePtr(new BitmapImage(bitmap, Image::NORMAL, Image::NO_BORDER)), bounds);
         Matrix3x3d imageTransform = Matrix3x3d(TransformationMatrix::scale(scale)*layer.parentTransform*TransformationMatrix(layer->transform)*animationTransform(component, layer, time))*fromTextRendererMatrix(result.transform);
         return transformImage(image, imageTransform);
@@ -187,8 +219,8 @@ PlacedImagePtr TextRenderer::transformImage(const PlacedImagePtr &image, const M
 
     tex->bind(0);
     outputTexture->bind();
-    glViewport(0, 0, outputBounds.dimensions().x, outputBounds.dimensions().y);
-    glClearColor(0.f, 0.f, 0.f, 0.f);
+    GLStateCache::viewport(0, 0, outputBounds.dimensions().x, outputBounds.dimensions().y);
+    GLStateCache::clearColor(0.f, 0.f, 0.f, 0.f);
     glClear(GL_COLOR_BUFFER_BIT);
     const int ss[] = { 1, 1 };
     transformShader.bind(vertexTransform, outputBounds.dimensions());
@@ -207,7 +239,7 @@ void TextRenderer::blitTexture(Texture2D &dst, const Texture2D &src) {
     FrameBuffer fb;
     fb.setOutput(&dst);
     fb.bind();
-    glViewport(0, 0, dst.dimensions().x, dst.dimensions().y);
+    GLStateCache::viewport(0, 0, dst.dimensions().x, dst.dimensions().y);
     blitShader.bind(PixelBounds(Vector2i(), dst.dimensions()), srcBounds, srcBounds);
     src.bind(BlitShader::UNIT_IN);
     billboard.draw();
@@ -1,5 +1,7 @@
 
+#include <chrono>
 #include <cstring>
+#include <string>
 #include <octopus/octopus.h>
 #include <octopus/serializer.h>
 #include <octopus/validator.h>
@@ -22,7 +24,7 @@ static Bitmap unpremultipliedCopy(const SparseBitmapConstRef &bitmap) {
 class TestRenderer {
 
 public:
-    inline explicit TestRenderer(GraphicsContext &gc) : gc(gc), renderer(gc), imageBase(gc) {
+    inline explicit TestRenderer(GraphicsContext &gc) : gc(gc), renderer(gc), imageBase(gc), report("id,final ms,draft ms,preview ms,gl state changes,skipped gl state changes,unscheduled peak memory,scheduled peak memory\n") {
         octopus::Image imgDef;
         imgDef.ref.type = octopus::ImageRef::Type::PATH;
         imgDef.ref.value = "IMAGE00";
@@ -66,9 +68,19 @@ public:
         if (!renderGraph)
             return false;
 
-        PlacedImagePtr image = render(renderer, imageBase, component, renderGraph.value(), 1, outerPixelBounds(scaleBounds(componentBounds, 1)), 0);
+        PixelBounds bounds = outerPixelBounds(scaleBounds(componentBounds, 1));
+        renderer.resetStatistics();
+        PlacedImagePtr image = render(renderer, imageBase, component, renderGraph.value(), 1, bounds, 0);
         if (!image)
             return false;
+        Renderer::Statistics statistics = renderer.statistics();
+
+        report += octopus.id;
+        for (EffectQuality quality : { EffectQuality::FINAL, EffectQuality::DRAFT, EffectQuality::PREVIEW })
+            report += ","+std::to_string(renderTime(component, renderGraph.value(), bounds, quality));
+        report += ","+std::to_string(statistics.glStateChanges)+","+std::to_string(statistics.skippedGlStateChanges);
+        report += ","+std::to_string(statistics.unscheduledPeakMemory)+","+std::to_string(statistics.scheduledPeakMemory);
+        report += "\n";
 
         BitmapPtr bitmap = image->asBitmap();
         if (!bitmap)
@@ -79,10 +91,31 @@ public:
         return savePng(octopus.id+".png", *bitmap);
     }
 
+    /// Returns the statistics of the rendered designs in CSV format
+    inline const std::string &statisticsReport() const {
+        return report;
+    }
+
 private:
     GraphicsContext &gc;
     Renderer renderer;
     ImageBase imageBase;
+    std::string report;
+
+    /// Measures the time of a render in milliseconds at the given effect quality, excluding shader compilation and results retained from previous renders
+    inline double renderTime(Component &component, const Rendexptr &renderGraph, const PixelBounds &bounds, EffectQuality quality) {
+        renderer.setEffectQuality(quality);
+        render(renderer, imageBase, component, renderGraph, 1, bounds, 0);
+        renderer.cleanUp();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        PlacedImagePtr image = render(renderer, imageBase, component, renderGraph, 1, bounds, 0);
+        // Reading back the result waits for the GPU to finish
+        if (image)
+            image->asBitmap();
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+        renderer.setEffectQuality(EffectQuality::FINAL);
+        return time;
+    }
 
 };
 
@@ -280,5 +313,6 @@ int basicRenderingOutput(GraphicsContext &gc) {
     filllessShape.shape->strokes.clear();
     renderer.renderOctopusIntoFile(buildOctopus("TEST65", MaskGroupLayer(octopus::MaskBasis::BODY, filllessShape).add(ShapeLayer(280, 200, 320, 240))));
 
+    writeFile("renderer-statistics.csv", renderer.statisticsReport());
     return 0;
 }
@@ -0,0 +1,88 @@
+
+#include <algorithm>
+#include <cstdlib>
+#include <octopus/octopus.h>
+#include <ode-essentials.h>
+#include <ode-media.h>
+#include <ode-logic.h>
+#include <ode-renderer.h>
+#include <ode-diagnostics.h>
+
+using namespace ode;
+using namespace octopus_builder;
+
+// Maximum mean absolute difference of a channel over covered pixels between the jump flooded and the exact stroke (out of 255)
+static constexpr double MAX_MEAN_ERROR = 4;
+
+static Bitmap renderStroke(Renderer &renderer, ImageBase &imageBase, Component &component, const Rendexptr &renderGraph, const PixelBounds &bounds, EffectQuality quality) {
+    renderer.setEffectQuality(quality);
+    PlacedImagePtr image = render(renderer, imageBase, component, renderGraph, 1, bounds, 0);
+    renderer.setEffectQuality(EffectQuality::FINAL);
+    if (!image)
+        return Bitmap();
+    image = renderer.reframe(image, bounds);
+    BitmapPtr bitmap = image->asBitmap();
+    return bitmap ? Bitmap(*bitmap) : Bitmap();
+}
+
+int distanceThresholdOutput(GraphicsContext &gc) {
+    Renderer renderer(gc);
+    ImageBase imageBase(gc);
+
+    // Stroke effects whose distance range lies between the shader precision of DRAFT and FINAL quality,
+    // which are therefore jump flooded in DRAFT quality and evaluated by the exact distance transform in FINAL
+    static_assert(EFFECT_SHADER_PRECISION >= 16, "Stroke thicknesses must be within the shader precision");
+    const octopus::Stroke::Position positions[] = { octopus::Stroke::Position::OUTSIDE, octopus::Stroke::Position::CENTER, octopus::Stroke::Position::INSIDE };
+    const double thicknesses[] = { 12, 20, 12 };
+    for (int i = 0; i < 3; ++i) {
+        ShapeLayer shape(40, 40, 120, 80);
+        shape.setPath("M100 40 C140 40 160 60 160 80 C160 100 140 120 100 120 L40 120 L70 80 Z");
+        shape.setColor(Color(.25, .5, 1));
+        octopus::Effect stroke;
+        stroke.type = octopus::Effect::Type::STROKE;
+        stroke.basis = octopus::EffectBasis::BODY;
+        stroke.stroke = octopus::Stroke();
+        stroke.stroke->fill.type = octopus::Fill::Type::COLOR;
+        stroke.stroke->fill.color = toOctopus(Color(1, .5, 0));
+        stroke.stroke->thickness = thicknesses[i];
+        stroke.stroke->position = positions[i];
+        shape.addEffect(stroke);
+        std::string id = "DT0"+std::to_string(i);
+        octopus::Octopus octopus = buildOctopus(id, shape, 200, 160);
+
+        Component component;
+        if (component.initialize(octopus))
+            return 1;
+        Result<Rendexptr, DesignError> renderGraph = component.assemble();
+        if (!renderGraph)
+            return 1;
+
+        PixelBounds bounds(0, 0, 200, 160);
+        Bitmap exact = renderStroke(renderer, imageBase, component, renderGraph.value(), bounds, EffectQuality::FINAL);
+        Bitmap jumpFlooded = renderStroke(renderer, imageBase, component, renderGraph.value(), bounds, EffectQuality::DRAFT);
+        if (!(exact && jumpFlooded && exact.dimensions() == jumpFlooded.dimensions() && exact.format() == jumpFlooded.format()))
+            return 1;
+
+        // Both renders are premultiplied, so they are compared before unpremultiplication
+        const byte *a = reinterpret_cast<const byte *>(exact.pixels());
+        const byte *b = reinterpret_cast<const byte *>(jumpFlooded.pixels());
+        int channels = pixelChannels(exact.format());
+        double errorSum = 0;
+        size_t coveredChannels = 0;
+        for (size_t j = 0; j+channels <= exact.size(); j += channels) {
+            if (a[j+channels-1] || b[j+channels-1]) {
+                for (int k = 0; k < channels; ++k)
+                    errorSum += abs(int(a[j+k])-int(b[j+k]));
+                coveredChannels += channels;
+            }
+        }
+
+        bitmapUnpremultiply(exact);
+        bitmapUnpremultiply(jumpFlooded);
+        savePng(id+".png", exact);
+        savePng(id+"-jump-flood.png", jumpFlooded);
+        if (!coveredChannels || errorSum/double(coveredChannels) > MAX_MEAN_ERROR)
+            return 2;
+    }
+    return 0;
+}
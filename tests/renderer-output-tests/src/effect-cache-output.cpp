@@ -0,0 +1,78 @@
+
+#include <cstring>
+#include <octopus/octopus.h>
+#include <ode-essentials.h>
+#include <ode-media.h>
+#include <ode-logic.h>
+#include <ode-renderer.h>
+#include <ode-diagnostics.h>
+
+using namespace ode;
+using namespace octopus_builder;
+
+static Bitmap renderComponent(Renderer &renderer, ImageBase &imageBase, Component &component, const PixelBounds &bounds) {
+    Result<Rendexptr, DesignError> renderGraph = component.assemble();
+    if (!renderGraph)
+        return Bitmap();
+    PlacedImagePtr image = render(renderer, imageBase, component, renderGraph.value(), 1, bounds, 0);
+    if (!image)
+        return Bitmap();
+    image = renderer.reframe(image, bounds);
+    BitmapPtr bitmap = image->asBitmap();
+    return bitmap ? Bitmap(*bitmap) : Bitmap();
+}
+
+static bool identical(const Bitmap &a, const Bitmap &b) {
+    return a.dimensions() == b.dimensions() && a.format() == b.format() && !memcmp(a.pixels(), b.pixels(), a.size());
+}
+
+int effectCacheOutput(GraphicsContext &gc) {
+    Renderer renderer(gc);
+    ImageBase imageBase(gc);
+
+    // A shape whose drop shadow is modified between renders - the renderer's cached shadow must not be reused
+    ShapeLayer shape(40, 40, 80, 60);
+    shape.setPath("M80 40 L120 100 L40 100 Z");
+    shape.setColor(Color(.25, .5, 1));
+    octopus::Effect shadow;
+    shadow.type = octopus::Effect::Type::DROP_SHADOW;
+    shadow.basis = octopus::EffectBasis::BODY;
+    shadow.shadow = octopus::Shadow();
+    shadow.shadow->offset.x = 4;
+    shadow.shadow->offset.y = 6;
+    shadow.shadow->blur = 8;
+    shadow.shadow->choke = 0;
+    shadow.shadow->color = toOctopus(Color(0, 0, 0, .5));
+    shape.addEffect(shadow);
+    octopus::Octopus octopus = buildOctopus("EC00", shape, 160, 160);
+
+    Component component;
+    if (component.initialize(octopus))
+        return 1;
+    PixelBounds bounds(0, 0, 160, 160);
+    Bitmap original = renderComponent(renderer, imageBase, component, bounds);
+
+    shadow.shadow->offset.x = -10;
+    shadow.shadow->color = toOctopus(Color(1, 0, 0, .5));
+    octopus::LayerChange change;
+    change.subject = octopus::LayerChange::Subject::EFFECT;
+    change.op = octopus::LayerChange::Op::REPLACE;
+    change.index = 0;
+    change.values.effect = shadow;
+    if (component.modifyLayer(shape.id, change))
+        return 1;
+    Bitmap modified = renderComponent(renderer, imageBase, component, bounds);
+
+    // Reference render of the modified component by a renderer without any cached results
+    Renderer referenceRenderer(gc);
+    Bitmap reference = renderComponent(referenceRenderer, imageBase, component, bounds);
+    if (!(original && modified && reference))
+        return 1;
+    bool reflectsModification = !identical(original, modified) && identical(modified, reference);
+
+    bitmapUnpremultiply(original);
+    bitmapUnpremultiply(modified);
+    savePng("EC00.png", original);
+    savePng("EC00-modified.png", modified);
+    return reflectsModification ? 0 : 2;
+}
@@ -0,0 +1,97 @@
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <octopus/octopus.h>
+#include <ode-essentials.h>
+#include <ode-media.h>
+#include <ode-logic.h>
+#include <ode-renderer.h>
+#include <ode-diagnostics.h>
+#include "image-asset-generator.h"
+
+using namespace ode;
+
+// Maximum difference of a channel between the fused and the separate evaluation (out of 255), which rounds intermediate results
+static constexpr int MAX_ERROR = 2;
+
+static PlacedImagePtr generateImage(const PixelBounds &bounds, bool transparency) {
+    Bitmap bitmap(PixelFormat::PREMULTIPLIED_RGBA, bounds.dimensions());
+    generateImageAsset(bitmap, transparency);
+    return PlacedImagePtr(Image::fromBitmap((Bitmap &&) bitmap, Image::PREMULTIPLIED), bounds);
+}
+
+static PlacedImagePtr generateAlphaImage(const PixelBounds &bounds) {
+    Bitmap bitmap(PixelFormat::R, bounds.dimensions());
+    byte *pixels = reinterpret_cast<byte *>(bitmap.pixels());
+    for (int y = 0; y < bitmap.height(); ++y) {
+        for (int x = 0; x < bitmap.width(); ++x)
+            *pixels++ = byte(255*(x+y)/(bitmap.width()+bitmap.height()-2));
+    }
+    return PlacedImagePtr(Image::fromBitmap((Bitmap &&) bitmap, Image::RED_IS_ALPHA), bounds);
+}
+
+static Bitmap framedBitmap(Renderer &renderer, const PlacedImagePtr &image, const PixelBounds &bounds) {
+    BitmapPtr bitmap = renderer.reframe(image, bounds)->asBitmap();
+    return bitmap ? Bitmap(*bitmap) : Bitmap();
+}
+
+int fusedCompositingOutput(GraphicsContext &gc) {
+    Renderer renderer(gc);
+
+    // Leaf expressions only identify the input images of the chains
+    Rendexptr a(new EmptyExpression), b(new EmptyExpression), m1(new EmptyExpression), m2(new EmptyExpression);
+    std::map<const Rendexpr *, PlacedImagePtr> images;
+    images[a.get()] = generateImage(PixelBounds(0, 0, 120, 80), true);
+    images[b.get()] = generateImage(PixelBounds(40, 20, 120, 100), false);
+    images[m1.get()] = generateAlphaImage(PixelBounds(10, 10, 90, 70));
+    images[m2.get()] = generateAlphaImage(PixelBounds(50, 30, 130, 100));
+    const PlacedImagePtr &imageA = images[a.get()], &imageB = images[b.get()], &imageM1 = images[m1.get()], &imageM2 = images[m2.get()];
+    const octopus::BlendMode normal = octopus::BlendMode::NORMAL;
+
+    struct TestCase {
+        Rendexptr expression;
+        PlacedImagePtr separate;
+    } testCases[] = {
+        // Blend ignoring the alpha of a missing source
+        { Rendexptr(new MixExpression(0, Rendexptr(new BlendIgnoreAlphaExpression(0, a, nullptr, normal)), b, .25)), renderer.mix(renderer.blendIgnoreAlpha(imageA, nullptr, normal), imageB, .25) },
+        // Blend ignoring the alpha of the source into a missing destination
+        { Rendexptr(new MultiplyAlphaExpression(0, Rendexptr(new BlendIgnoreAlphaExpression(0, nullptr, a, normal)), .5)), renderer.multiplyAlpha(renderer.blendIgnoreAlpha(nullptr, imageA, normal), .5) },
+        // Blend ignoring the alpha of a present source
+        { Rendexptr(new MultiplyAlphaExpression(0, Rendexptr(new BlendIgnoreAlphaExpression(0, b, a, normal)), .75)), renderer.multiplyAlpha(renderer.blendIgnoreAlpha(imageB, imageA, normal), .75) },
+        // Alpha only operands
+        { Rendexptr(new BlendExpression(0, m1, Rendexptr(new MultiplyAlphaExpression(0, m2, .5)), normal)), renderer.blend(imageM1, renderer.multiplyAlpha(imageM2, .5), normal) },
+    };
+
+    PixelBounds bounds(0, 0, 140, 110);
+    int index = 0;
+    for (const TestCase &testCase : testCases) {
+        CompositingChain chain;
+        if (!chain.build(testCase.expression.get()))
+            return 1;
+        std::vector<PlacedImagePtr> inputs;
+        for (const Rendexpr *input : chain.inputs())
+            inputs.push_back(input ? images[input] : nullptr);
+        PlacedImagePtr fused = renderer.composite(chain, inputs);
+        if (!(fused && testCase.separate))
+            return 1;
+        if (fused->transparencyMode() != testCase.separate->transparencyMode())
+            return 2;
+
+        Bitmap fusedBitmap = framedBitmap(renderer, fused, bounds);
+        Bitmap separateBitmap = framedBitmap(renderer, testCase.separate, bounds);
+        if (!(fusedBitmap && separateBitmap && fusedBitmap.size() == separateBitmap.size()))
+            return 1;
+        const byte *p = reinterpret_cast<const byte *>(fusedBitmap.pixels());
+        const byte *q = reinterpret_cast<const byte *>(separateBitmap.pixels());
+        int maxError = 0;
+        for (size_t i = 0; i < fusedBitmap.size(); ++i)
+            maxError = std::max(maxError, abs(int(p[i])-int(q[i])));
+
+        bitmapUnpremultiply(fusedBitmap);
+        savePng("FC0"+std::to_string(index++)+".png", fusedBitmap);
+        if (maxError > MAX_ERROR)
+            return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <octopus/octopus.h>
+#include <ode-essentials.h>
+#include <ode-media.h>
+#include <ode-logic.h>
+#include <ode-renderer.h>
+#include <ode-diagnostics.h>
+
+using namespace ode;
+using namespace octopus_builder;
+
+// Maximum mean absolute difference of a channel between the approximated and the full render (out of 255)
+static constexpr double MAX_MEAN_ERROR = 4;
+// Same for a single rectangle, whose approximation only differs in partially covered pixels
+static constexpr double MAX_RECTANGLE_MEAN_ERROR = 1;
+
+// Each variant is rendered by a separate renderer, so that neither reuses effects or subtrees retained by the other
+static Bitmap renderThumbnail(GraphicsContext &gc, ImageBase &imageBase, Component &component, const Rendexptr &renderGraph, double scale, const PixelBounds &bounds, double detailThreshold) {
+    Renderer renderer(gc);
+    renderer.setDetailThreshold(detailThreshold);
+    PlacedImagePtr image = render(renderer, imageBase, component, renderGraph, scale, bounds, 0);
+    if (!image)
+        return Bitmap();
+    image = renderer.reframe(image, bounds);
+    BitmapPtr bitmap = image->asBitmap();
+    return bitmap ? Bitmap(*bitmap) : Bitmap();
+}
+
+/// Renders the octopus in full and approximated with the detail threshold, saves both and compares them - returns 1 on failure to render and 2 if the error exceeds maxMeanError
+static int compareApproximation(GraphicsContext &gc, ImageBase &imageBase, const octopus::Octopus &octopus, double scale, double detailThreshold, double maxMeanError) {
+    Component component;
+    if (component.initialize(octopus))
+        return 1;
+    Result<Rendexptr, DesignError> renderGraph = component.assemble();
+    if (!renderGraph)
+        return 1;
+
+    PixelBounds bounds = outerPixelBounds(scaleBounds(UnscaledBounds(0, 0, octopus.dimensions->width, octopus.dimensions->height), scale));
+    Bitmap full = renderThumbnail(gc, imageBase, component, renderGraph.value(), scale, bounds, 0);
+    Bitmap approximated = renderThumbnail(gc, imageBase, component, renderGraph.value(), scale, bounds, detailThreshold);
+    if (!(full && approximated && full.dimensions() == approximated.dimensions() && full.format() == approximated.format()))
+        return 1;
+
+    // Both renders are premultiplied, so they are compared before unpremultiplication
+    const byte *a = reinterpret_cast<const byte *>(full.pixels());
+    const byte *b = reinterpret_cast<const byte *>(approximated.pixels());
+    double errorSum = 0;
+    for (size_t i = 0; i < full.size(); ++i)
+        errorSum += abs(int(a[i])-int(b[i]));
+    double meanError = errorSum/double(full.size());
+
+    bitmapUnpremultiply(full);
+    bitmapUnpremultiply(approximated);
+    savePng(octopus.id+".png", full);
+    savePng(octopus.id+"-approximated.png", approximated);
+    return meanError <= maxMeanError ? 0 : 2;
+}
+
+static octopus::Effect dropShadow(double offset, double blur, const Color &color) {
+    octopus::Effect shadow;
+    shadow.type = octopus::Effect::Type::DROP_SHADOW;
+    shadow.basis = octopus::EffectBasis::BODY;
+    shadow.shadow = octopus::Shadow();
+    shadow.shadow->offset.x = offset;
+    shadow.shadow->offset.y = offset;
+    shadow.shadow->blur = blur;
+    shadow.shadow->choke = 0;
+    shadow.shadow->color = toOctopus(color);
+    return shadow;
+}
+
+int levelOfDetailOutput(GraphicsContext &gc) {
+    ImageBase imageBase(gc);
+
+    // A grid of small rectangles and circles, some of them with shadows, rendered as a thumbnail where each is about a pixel wide
+    GroupLayer root;
+    for (int y = 0; y < 40; ++y) {
+        for (int x = 0; x < 40; ++x) {
+            ShapeLayer icon(50*x+13, 50*y+13, 24, 24);
+            icon.setColor(Color(x/40., y/40., .5));
+            if ((x+y)%2) {
+                char path[128];
+                snprintf(path, sizeof(path), "M%d %d A12 12 0 1 1 %d %d A12 12 0 1 1 %d %d Z", 50*x+25, 50*y+13, 50*x+25, 50*y+37, 50*x+25, 50*y+13);
+                icon.setPath(path);
+            }
+            if ((x+2*y)%3 == 0)
+                icon.addEffect(dropShadow(2, 4, Color(0, 0, 0, .25)));
+            root.add(icon);
+        }
+    }
+    if (int error = compareApproximation(gc, imageBase, buildOctopus("LOD00", root, 2000, 2000), .05, 2, MAX_MEAN_ERROR))
+        return error;
+
+    // A single small icon whose shadow extends far beyond the detail threshold and must not be dropped along with the icon
+    ShapeLayer icon(980, 980, 24, 24);
+    icon.setColor(Color(1, .5, 0));
+    icon.addEffect(dropShadow(100, 200, Color(1, 0, 0, .75)));
+    if (int error = compareApproximation(gc, imageBase, buildOctopus("LOD01", icon, 2000, 2000), .05, 2, MAX_RECTANGLE_MEAN_ERROR))
+        return error;
+
+    // A grid of small nested groups, each of which is collapsed into a single averaged color
+    GroupLayer groups;
+    for (int y = 0; y < 40; ++y) {
+        for (int x = 0; x < 40; ++x) {
+            ShapeLayer background(50*x+13, 50*y+13, 24, 24);
+            background.setColor(Color(x/40., .5, y/40.));
+            ShapeLayer dot(50*x+19, 50*y+19, 12, 12);
+            dot.setColor(Color(1, 1, 1, .5));
+            char path[128];
+            snprintf(path, sizeof(path), "M%d %d A6 6 0 1 1 %d %d A6 6 0 1 1 %d %d Z", 50*x+25, 50*y+19, 50*x+25, 50*y+31, 50*x+25, 50*y+19);
+            dot.setPath(path);
+            GroupLayer inner;
+            inner.add(dot);
+            GroupLayer group;
+            group.add(background).add(inner);
+            if ((x+y)%3 == 0)
+                group.setOpacity(.5);
+            groups.add(group);
+        }
+    }
+    if (int error = compareApproximation(gc, imageBase, buildOctopus("LOD02", groups, 2000, 2000), .05, 2, MAX_MEAN_ERROR))
+        return error;
+
+    return 0;
+}
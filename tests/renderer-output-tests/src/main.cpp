@@ -4,12 +4,24 @@
 using namespace ode;
 
 int basicRenderingOutput(GraphicsContext &gc);
+int levelOfDetailOutput(GraphicsContext &gc);
+int distanceThresholdOutput(GraphicsContext &gc);
+int effectCacheOutput(GraphicsContext &gc);
+int fusedCompositingOutput(GraphicsContext &gc);
 
 int main() {
     GraphicsContext gc(GraphicsContext::OFFSCREEN);
 
     if (int error = basicRenderingOutput(gc))
         return error;
+    if (int error = levelOfDetailOutput(gc))
+        return error;
+    if (int error = distanceThresholdOutput(gc))
+        return error;
+    if (int error = effectCacheOutput(gc))
+        return error;
+    if (int error = fusedCompositingOutput(gc))
+        return error;
 
     return 0;
 }
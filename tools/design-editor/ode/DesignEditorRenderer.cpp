@@ -80,4 +80,5 @@ void DesignEditorRenderer::unbind() {
     glBindBuffer(GL_ARRAY_BUFFER, prevVbo);
     glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
     glDisable(GL_BLEND);
+    GLStateCache::invalidate();
 }
@@ -388,6 +388,7 @@ int DesignEditorWindow::display() {
         glClear(GL_COLOR_BUFFER_BIT);
 
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        GLStateCache::invalidate();
 
         glfwSwapBuffers(window);
     }
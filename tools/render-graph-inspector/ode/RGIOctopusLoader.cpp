@@ -1,6 +1,8 @@
 
 #include "RGIOctopusLoader.h"
 
+#include <map>
+
 // OD includes
 #include <octopus/octopus.h>
 #include <octopus/parser.h>
@@ -125,14 +127,22 @@ bool RGIOctopusLoader::Input::isValid() const {
     ImageBase imageBase(gc);
     imageBase.setImageDirectory(input.imageDirectory.empty() ? input.octopusPath.parent() : input.imageDirectory);
 
-    const auto makeRenderHook = [](RGIRenderGraph &renderGraph, RGIRenderedNodes &renderedNodes) {
-        return [&renderGraph, &renderedNodes](const Rendexpr *node, const PlacedImagePtr &image) {
+    // The devices chosen for the operations of the render graph and their cost estimates
+    std::map<const Rendexpr *, std::string> executions;
+    planExecution(defaultRenderer, imageBase, *oOctopus.artboard, oOctopus.renderGraph.getRoot(), 1, pixelBounds, 0, [&executions](const Rendexpr *node, const ExecutionPlan::Estimate &estimate) {
+        char buffer[128];
+        snprintf(buffer, sizeof(buffer), "%s (CPU %.1f us, GPU %.1f us, %lld px)", ExecutionPlan::deviceName(estimate.device), estimate.cpuCost, estimate.gpuCost, estimate.pixels);
+        executions[node] = buffer;
+    });
+
+    const auto makeRenderHook = [&executions](RGIRenderGraph &renderGraph, RGIRenderedNodes &renderedNodes) {
+        return [&executions, &renderGraph, &renderedNodes](const Rendexpr *node, const PlacedImagePtr &image) {
             // Gather intermediate images
             if (image) {
                 const BitmapPtr bitmap = image->asBitmap();
                 if (bitmap) {
                     const int nodeIndex = renderGraph.getNodeIndex(node);
-                    renderedNodes.emplace_back(RGIRenderedNode { nodeIndex+1, node, renderExpressionTypeShortName(node->type) + NodeEnd(nodeIndex+1), bitmap, image.bounds() });
+                    renderedNodes.emplace_back(RGIRenderedNode { nodeIndex+1, node, renderExpressionTypeShortName(node->type) + NodeEnd(nodeIndex+1), bitmap, image.bounds(), executions[node] });
                 } else {
                     fprintf(stderr, "Internal error (image to bitmap conversion)\n");
                 }
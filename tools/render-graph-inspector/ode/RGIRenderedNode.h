@@ -22,5 +22,7 @@ struct RGIRenderedNode {
     BitmapPtr bitmap = nullptr;
     /// Image placement.
     ScaledBounds placement;
+    /// The device chosen for the node's operation and the estimated costs of either device (see ExecutionPlan).
+    std::string execution;
 };
 using RGIRenderedNodes = std::vector<RGIRenderedNode>;
@@ -132,4 +132,5 @@ void RGIRenderer::unbind() {
     glBindBuffer(GL_ARRAY_BUFFER, prevVbo);
     glBindFramebuffer(GL_FRAMEBUFFER, prevFbo);
     glDisable(GL_BLEND);
+    GLStateCache::invalidate();
 }
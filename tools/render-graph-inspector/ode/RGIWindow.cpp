@@ -424,6 +424,7 @@ int RGIWindow::display() {
         glUseProgram(0);
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         glUseProgram(last_program);
+        GLStateCache::invalidate();
 
         glfwSwapBuffers(window);
     }
@@ -743,6 +744,16 @@ void RGIWindow::drawRenderGraphInfoWidget() {
         ImGui::Text("  %s | %s", layer->id.c_str(), layer->name.c_str());
     }
 
+    ImGui::Separator();
+
+    ImGui::Text("Execution plan:");
+
+    for (const RGIRenderedNode &node : data->loadedOctopus.renderedNodes) {
+        if (!node.execution.empty()) {
+            ImGui::Text("  %s | %s", node.name.c_str(), node.execution.c_str());
+        }
+    }
+
     ImGui::End();
 }
 
@@ -785,6 +796,8 @@ void RGIWindow::drawSelectedImagesWidget(float &zoom) {
                 ImGui::Text("%s", selectedNodes[i].name.c_str());
                 if (selectedNodes[i].node && selectedNodes[i].node->getLayer())
                     ImGui::Text("Layer ID:         %s", selectedNodes[i].node->getLayer()->id.c_str());
+                if (!selectedNodes[i].execution.empty())
+                    ImGui::Text("Execution:        %s", selectedNodes[i].execution.c_str());
                 drawImGuiWidgetTexture(handle, bitmap->width(), bitmap->height(), zoom, selectedNodes.size());
             }
         }